@@ -0,0 +1,114 @@
+// Throughput of `hashmap_put` and `hashmap_get`, see `src/hashmap.c`.
+//
+//     hashmap_bench [-n runs] [count]
+//
+// Puts `count` generated symbol names into a fresh map, then gets each of
+// them back and gets as many names that were never put, and prints the best
+// of `runs` passes for each in nanoseconds per call.
+//
+// Built from every source but `main.c`, see `premake5.lua`.
+
+#define GB_IMPLEMENTATION
+#include "gb/gb.h"
+#include "strings.h"
+#include "hashmap.h"
+
+#define BENCH_SYMBOLS 100000
+
+// Names shaped like the ones bind keeps in its tables: types, functions,
+// macros, with shared prefixes so the hash has to look past them
+char *prefixes[] = {"", "_", "PFN_", "vk", "gl", "Win", "__imp_", "LPCWSTR_"};
+char *stems[] = {"Create", "Destroy", "Get", "Set", "Query", "Enumerate", "Bind", "Map"};
+char *suffixes[] = {"Buffer", "Image", "Device", "Window", "Handle", "INFO", "Ex", "W"};
+
+String *generate_names(int count, char *tag)
+{
+    gbAllocator a = gb_heap_allocator();
+    String *names = gb_alloc_array(a, String, count);
+    for (int i = 0; i < count; i++)
+    {
+        char buf[128];
+        isize len = gb_snprintf(buf, gb_size_of(buf), "%s%s%s%s%d",
+                                prefixes[i % gb_count_of(prefixes)],
+                                stems[(i / 8) % gb_count_of(stems)],
+                                suffixes[(i / 64) % gb_count_of(suffixes)],
+                                tag, i) - 1;
+        names[i] = make_string_allocn(a, buf, (int)len);
+    }
+    return names;
+}
+
+int main(int argc, char **argv)
+{
+    int runs = 20;
+    int count = BENCH_SYMBOLS;
+    for (int i = 1; i < argc; i++)
+    {
+        if (gb_strcmp(argv[i], "-n") == 0 && i+1 < argc)
+        {
+            runs = (int)gb_str_to_i64(argv[++i], 0, 10);
+            runs = gb_max(runs, 1);
+        }
+        else
+        {
+            count = (int)gb_str_to_i64(argv[i], 0, 10);
+            count = gb_max(count, 1);
+        }
+    }
+
+    String *names = generate_names(count, "");
+    String *missing = generate_names(count, "_missing");
+
+    f64 best_put = -1, best_hit = -1, best_miss = -1;
+    isize hits = 0, misses = 0;
+    for (int r = 0; r < runs; r++)
+    {
+        map_t map = hashmap_new(gb_heap_allocator());
+
+        f64 start = gb_time_now();
+        for (int i = 0; i < count; i++)
+            hashmap_put(map, names[i], (any_t)(isize)(i+1));
+        f64 put = gb_time_now() - start;
+
+        hits = 0;
+        start = gb_time_now();
+        for (int i = 0; i < count; i++)
+        {
+            any_t value;
+            if (hashmap_get(map, names[i], &value) == MAP_OK && value == (any_t)(isize)(i+1))
+                hits++;
+        }
+        f64 hit = gb_time_now() - start;
+
+        misses = 0;
+        start = gb_time_now();
+        for (int i = 0; i < count; i++)
+        {
+            any_t value;
+            if (hashmap_get(map, missing[i], &value) == MAP_MISSING)
+                misses++;
+        }
+        f64 miss = gb_time_now() - start;
+
+        hashmap_free(map);
+
+        if (best_put < 0 || put < best_put)
+            best_put = put;
+        if (best_hit < 0 || hit < best_hit)
+            best_hit = hit;
+        if (best_miss < 0 || miss < best_miss)
+            best_miss = miss;
+    }
+
+    if (hits != count || misses != count)
+    {
+        gb_printf_err("\x1b[31mERROR:\x1b[0m %td of %d gets hit and %td of %d missed\n", hits, count, misses, count);
+        return 1;
+    }
+
+    gb_printf("%d symbols, best of %d:\n", count, runs);
+    gb_printf("    put:  %.2fms, %.1fns/call\n", best_put*1000, best_put/count*1e9);
+    gb_printf("    hit:  %.2fms, %.1fns/call\n", best_hit*1000, best_hit/count*1e9);
+    gb_printf("    miss: %.2fms, %.1fns/call\n", best_miss*1000, best_miss/count*1e9);
+    return 0;
+}
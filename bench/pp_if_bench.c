@@ -0,0 +1,132 @@
+// Throughput of `#if` and `#elif` evaluation, see `pp_eval_directive`.
+//
+//     pp_if_bench [-n runs] [file]
+//
+// Preprocesses `file`, or a generated header of conditional blocks in the
+// style of the Windows headers, and prints the best of `runs` passes in
+// lines and conditions per second. Tokenizing isn't timed.
+//
+// Built from every source but `main.c`, see `premake5.lua`.
+
+#define GB_IMPLEMENTATION
+#include "gb/gb.h"
+#include "strings.h"
+#include "util.h"
+#include "tokenizer.h"
+#include "intern.h"
+#include "include_cache.h"
+#include "file_map.h"
+#include "preprocess.h"
+#include "writer.h"
+
+#define BENCH_LINES 100000
+// Lines in a generated block, each block has two conditions and puts one
+// declaration of 6 tokens in the output
+#define BLOCK_LINES 5
+#define BLOCK_TOKENS 6
+
+gbFileContents generate_header(int lines)
+{
+    Writer out = {0};
+    writer_init(&out, 0, gb_heap_allocator());
+    writer_printf(&out, "#define X\n#define WINVER 0x0601\n#define _WIN32_WINNT WINVER\n");
+    for (int i = 0; i < lines/BLOCK_LINES; i++)
+    {
+        // Half the #ifs fail on the version, so the #elifs are evaluated too
+        writer_printf(&out, "#if defined(X) && (WINVER >= 0x0%x00) && !defined(NO_SYMBOL_%d)\n", 4 + i%6, i);
+        writer_printf(&out, "int symbol_%d(void);\n", i);
+        writer_printf(&out, "#elif (_WIN32_WINNT | %d) > 0x0500 || (defined(Y) ? 1 : 0)\n", i);
+        writer_printf(&out, "int fallback_%d(void);\n", i);
+        writer_printf(&out, "#endif\n");
+    }
+    // The tokenizer stops at a NUL, like after mapped contents
+    writer_write(&out, "", 1);
+    return (gbFileContents){gb_heap_allocator(), out.buffer, out.len-1};
+}
+
+int main(int argc, char **argv)
+{
+    int runs = 20;
+    char *path = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (gb_strcmp(argv[i], "-n") == 0 && i+1 < argc)
+        {
+            runs = (int)gb_str_to_i64(argv[++i], 0, 10);
+            runs = gb_max(runs, 1);
+        }
+        else
+            path = argv[i];
+    }
+
+    init_include_cache();
+    init_location_table();
+    init_keyword_table();
+    init_interner();
+    init_preprocessor();
+
+    gbAllocator a = gb_heap_allocator();
+    gbFileContents fc = path ? map_file_contents(a, path) : generate_header(BENCH_LINES);
+    if (!fc.data)
+    {
+        gb_printf_err("\x1b[31mERROR:\x1b[0m Failed to open file \'%s\'\n", path);
+        return 1;
+    }
+    String filename = make_string(path ? path : "generated.h");
+
+    gbArray(Token) tokens;
+    gb_array_init(tokens, a);
+    Tokenizer tokenizer = make_tokenizer(fc, filename);
+    isize lines = 0, conditions = 0;
+    TokenKind prev = Token_Invalid;
+    for (;;)
+    {
+        Token token = get_token(&tokenizer);
+        if (token.kind != Token_Invalid)
+            gb_array_append(tokens, token);
+        if (token.kind == Token_EOF)
+            break;
+        lines = token.loc.line;
+        if (prev == Token_Hash && (cstring_cmp(token.str, "if") == 0 || cstring_cmp(token.str, "elif") == 0))
+            conditions++;
+        prev = token.kind;
+    }
+
+    System_Directories system_dirs = get_system_includes(a);
+    PreprocessorConfig conf = {0};
+    gb_array_init(conf.include_dirs, a);
+
+    f64 best = -1;
+    isize output = 0;
+    for (int r = 0; r < runs; r++)
+    {
+        // The preprocessor frees its tokens
+        gbArray(Token) run_tokens;
+        gb_array_init_reserve(run_tokens, a, gb_array_count(tokens));
+        gb_array_appendv(run_tokens, tokens, gb_array_count(tokens));
+
+        f64 start = gb_time_now();
+        Preprocessor *pp = make_preprocessor(run_tokens, dir_from_path(filename), filename, &conf, 0);
+        pp->system_includes = system_dirs.include;
+        run_pp(pp);
+        f64 t = gb_time_now() - start;
+        if (best < 0 || t < best)
+            best = t;
+
+        output = gb_array_count(pp->output);
+        destroy_preprocessor(pp);
+    }
+
+    if (!path && output != BENCH_LINES/BLOCK_LINES*BLOCK_TOKENS)
+    {
+        gb_printf_err("\x1b[31mERROR:\x1b[0m Expected %d tokens out, got %td\n", BENCH_LINES/BLOCK_LINES*BLOCK_TOKENS, output);
+        return 1;
+    }
+
+    gb_printf("%.*s: %td lines, %td conditions, %td tokens out\n", LIT(filename), lines, conditions, output);
+    gb_printf("best of %d: %.2fms, %.2fM lines/sec, %.2fM conditions/sec\n",
+              runs, best*1000, lines/best/1e6, conditions/best/1e6);
+    gb_array_free(tokens);
+    unmap_file_contents(&fc);
+    return 0;
+}
@@ -0,0 +1,90 @@
+// Identifier throughput of the tokenizer, see `keyword_kind`.
+//
+//     tokenizer_bench [-n runs] [file]
+//
+// Tokenizes `file`, or a generated header of declarations mixing keywords
+// and identifiers, and prints the best of `runs` passes in identifiers,
+// keywords included, per second.
+//
+// Built from every source but `main.c`, see `premake5.lua`.
+
+#define GB_IMPLEMENTATION
+#include "gb/gb.h"
+#include "strings.h"
+#include "tokenizer.h"
+#include "intern.h"
+#include "file_map.h"
+#include "writer.h"
+
+#define BENCH_LINES 100000
+
+gbFileContents generate_header(int lines)
+{
+    Writer out = {0};
+    writer_init(&out, 0, gb_heap_allocator());
+    for (int i = 0; i < lines; i += 4)
+    {
+        writer_printf(&out, "typedef unsigned long long handle_%d_t;\n", i);
+        writer_printf(&out, "extern const struct widget_%d *make_widget_%d(int count, char *name, volatile void *user_data);\n", i, i);
+        writer_printf(&out, "typedef struct point_%d { float x, y; signed short flags; } point_%d;\n", i, i);
+        writer_printf(&out, "static inline enum color_%d color_of_%d(unsigned value) { return (enum color_%d)value; }\n", i, i, i);
+    }
+    // The tokenizer stops at a NUL, like after mapped contents
+    writer_write(&out, "", 1);
+    return (gbFileContents){gb_heap_allocator(), out.buffer, out.len-1};
+}
+
+int main(int argc, char **argv)
+{
+    int runs = 20;
+    char *path = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (gb_strcmp(argv[i], "-n") == 0 && i+1 < argc)
+        {
+            runs = (int)gb_str_to_i64(argv[++i], 0, 10);
+            runs = gb_max(runs, 1);
+        }
+        else
+            path = argv[i];
+    }
+
+    init_location_table();
+    init_keyword_table();
+    init_interner();
+
+    gbFileContents fc = path ? map_file_contents(gb_heap_allocator(), path) : generate_header(BENCH_LINES);
+    if (!fc.data)
+    {
+        gb_printf_err("\x1b[31mERROR:\x1b[0m Failed to open file \'%s\'\n", path);
+        return 1;
+    }
+    String filename = make_string(path ? path : "generated.h");
+
+    f64 best = -1;
+    isize idents = 0, tokens = 0;
+    for (int r = 0; r < runs; r++)
+    {
+        idents = tokens = 0;
+        f64 start = gb_time_now();
+        Tokenizer tokenizer = make_tokenizer(fc, filename);
+        for (;;)
+        {
+            Token token = get_token(&tokenizer);
+            if (token.kind == Token_EOF)
+                break;
+            tokens++;
+            if (token.kind == Token_Ident || (token.kind > Token__KeywordBegin && token.kind < Token__KeywordEnd))
+                idents++;
+        }
+        f64 t = gb_time_now() - start;
+        if (best < 0 || t < best)
+            best = t;
+    }
+
+    gb_printf("%.*s: %.1fMB, %td tokens, %td identifiers\n", LIT(filename), fc.size/(1024.0*1024.0), tokens, idents);
+    gb_printf("best of %d: %.2fms, %.2fM identifiers/sec, %.2fM tokens/sec\n",
+              runs, best*1000, idents/best/1e6, tokens/best/1e6);
+    unmap_file_contents(&fc);
+    return 0;
+}
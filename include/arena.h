@@ -0,0 +1,37 @@
+#ifndef _BIND_ARENA_H_
+#define _BIND_ARENA_H_
+
+#include "gb/gb.h"
+
+#define ARENA_BLOCK_SIZE gb_megabytes(1)
+
+// A growing bump allocator, made of a chain of `gbArena` blocks.
+// Freeing a single allocation is a no-op, everything is released at once
+// with `arena_free`, or rolled back to a saved point with `arena_temp_end`.
+// Not thread-safe, use one arena per task.
+typedef struct Arena
+{
+    gbAllocator backing;
+    isize block_size;
+    gbArray(gbArena *) blocks;
+} Arena;
+
+typedef struct Arena_Temp
+{
+    Arena *arena;
+    isize block_count;
+    gbTempArenaMemory mem;
+} Arena_Temp;
+
+void arena_init(Arena *arena, gbAllocator backing, isize block_size);
+void arena_free(Arena *arena);
+Arena *make_arena(void);
+void destroy_arena(Arena *arena);
+
+gbAllocator arena_allocator(Arena *arena);
+GB_ALLOCATOR_PROC(arena_allocator_proc);
+
+Arena_Temp arena_temp_begin(Arena *arena);
+void arena_temp_end(Arena_Temp temp);
+
+#endif
@@ -259,6 +259,12 @@ typedef struct Node {
     };
 } Node;
 
+typedef struct Lib_Decls
+{
+    gbArray(Node *) functions;
+    gbArray(Node *) variables;
+} Lib_Decls;
+
 typedef struct Ast_File
 {
     char *filename;
@@ -273,8 +279,22 @@ typedef struct Ast_File
 
     gbArray(Define) raw_defines;
     gbArray(Node *) defines;
+
+    // Parallel to Package.libs, filled by the resolver
+    gbArray(Lib_Decls) lib_decls;
 } Ast_File;
 
+// What a parse declared as types and which names it looked up, see
+// `Parser.logged`. A parse is the same against any type table its lookups
+// still hold for, see `type_log_holds`.
+typedef struct Type_Log
+{
+    gbArray(Node *) new_types;        // Ident, in the order they were declared
+    gbArray(Node *) new_opaque_types; // StructType, UnionType or EnumType
+    gbArray(Node *) used;   // Ident, names found as types the parse didn't declare
+    gbArray(Node *) missed; // Ident, names that weren't types
+} Type_Log;
+
 typedef struct TypeInfo
 {
     Node *base_type;
@@ -0,0 +1,57 @@
+#ifndef _BIND_AST_CACHE_H_
+#define _BIND_AST_CACHE_H_
+
+#include "gb/gb.h"
+#include "strings.h"
+#include "arena.h"
+#include "ast.h"
+#include "hashmap.h"
+
+#define AST_CACHE_VERSION 3
+
+// The parse of one task, kept in `<cache-dir>/<hash of the output>.ast` so an
+// unchanged task can skip preprocessing and parsing. The key inside is the
+// task's closure, see `Build_Cache`. The parse holds for the tasks before it while
+// its type log does, see `type_log_holds`.
+//
+// Stored in a pointer-free, varint encoding, see `ast_cache.c`, and loaded
+// with one read and one pass over it. Only what later stages use is kept: the
+// nodes, the lists of `Ast_File` and the `raw_defines` keys and values.
+typedef struct Ast_Cache
+{
+    Arena *arena; // Nodes and lists
+    // The encoding, token spellings and names point into it
+    gbFileContents data;
+
+    Ast_File file; // `filename` and `output_filename` aren't set
+    Type_Log log; // See `add_cached_types`
+} Ast_Cache;
+
+// Encodes `file` right after parsing, before the resolver changes any node.
+// The key is set by `save_ast_cache`. Empty if a node points back to itself.
+// `node_count` is how many nodes the parse made, at most.
+gbFileContents encode_ast_file(Ast_File file, Type_Log log, u32 node_count);
+void save_ast_cache(gbFileContents encoded, u64 key, char const *path);
+// Loads the file in `path` if it was saved with `key`
+Ast_Cache *load_ast_cache(char const *path, u64 key);
+void destroy_ast_cache(Ast_Cache *cache);
+
+// Adds the names the parse added to the type tables, in the same order
+void add_cached_types(Ast_Cache *cache, map_t type_table, map_t opaque_types);
+
+// Every field of a node other than its kind and header, by type. The one
+// list of them, shared by the encoder, the decoder and the round-trip test.
+typedef struct Node_Fields
+{
+    void *data;
+    void (*node)(void *data, Node **node);
+    void (*token)(void *data, Token *token);
+    void (*string)(void *data, String *str);
+    void (*nodes)(void *data, gbArray(Node *) *list);
+    void (*tokens)(void *data, gbArray(Token) *list);
+    void (*scalar)(void *data, u32 *value);
+} Node_Fields;
+
+void visit_node_fields(Node *n, Node_Fields *f);
+
+#endif
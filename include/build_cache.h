@@ -0,0 +1,89 @@
+#ifndef _BIND_BUILD_CACHE_H_
+#define _BIND_BUILD_CACHE_H_
+
+#include "gb/gb.h"
+#include "strings.h"
+#include "hashmap.h"
+#include "arena.h"
+#include "config.h"
+#include "bind.h"
+#include "util.h"
+#include "include_cache.h"
+#include "writer.h"
+
+#define BUILD_CACHE_VERSION 2
+
+// A file read or written by a run, with `hashmap_hash` of its contents.
+// `mtime` is 0 when the file changed during the run, so it is hashed again
+// next time instead of trusting its timestamp.
+typedef struct Cache_File
+{
+    String path;
+    u64 hash;
+    gbFileTime mtime;
+
+    // Only used while checking the manifest
+    b32 missing;
+    b32 hashed;
+} Cache_File;
+
+// A task of the last run, as recorded in the manifest
+typedef struct Cache_Task
+{
+    u64 closure; // 0 unless the task is unchanged since
+    // The files it included, only `path` and `hash` are set
+    gbArray(Include_File) includes;
+    gbArray(String) missing; // See `Preprocessor.missing`
+} Cache_Task;
+
+// What a run read and wrote, kept in `<cache-dir>/<key>.cache`.
+// A task's closure hashes the key with its input, every file it included and
+// every include path it tried that didn't exist; a later run with the same
+// closures, untouched outputs and libraries would write the same bindings. Resolving and printing look at the whole package, so the
+// run is skipped as a whole or not at all.
+typedef struct Build_Cache
+{
+    Arena *arena;
+    gbAllocator allocator;
+
+    char *manifest_path;
+    u64 key; // Config, system directories and tasks
+    // When the manifest was opened for writing, files modified since are not trusted
+    gbFileTime started;
+
+    map_t checked; // {String:Cache_File *}, files looked at by this run
+    // Tasks of the last run, in the same order, filled by `build_cache_up_to_date`
+    Cache_Task *tasks;
+    int task_count;
+
+    // Manifest being written, filled by `build_cache_add_task`
+    Writer *out;
+    gbFile *out_file;
+    char *out_path;
+} Build_Cache;
+
+Build_Cache *make_build_cache(Config *conf, System_Directories system_dirs, gbArray(Bind_Task) tasks);
+void destroy_build_cache(Build_Cache *cache);
+
+// True if the last run with the same key is still up to date.
+// `fresh_tasks` is set to the number of tasks whose closure is unchanged,
+// see `Build_Cache.tasks`.
+b32 build_cache_up_to_date(Build_Cache *cache, int task_count, int *fresh_tasks);
+
+// Writing a new manifest, it only replaces the old one at `build_cache_end`.
+// Begin before reading any input, then add the libraries and each task once
+// its output has been written.
+void build_cache_begin(Build_Cache *cache);
+// `missing` are the library paths tried that didn't exist, see `get_library_info`
+void build_cache_add_libs(Build_Cache *cache, gbArray(Lib) libs, gbArray(String) missing);
+// The closure of a task, from what it read. Doesn't touch the manifest, so
+// tasks can call it while running.
+u64 build_cache_closure(Build_Cache *cache, String input_filename, gbFileContents input,
+                        gbArray(Include_File *) includes, gbArray(String) missing);
+void build_cache_add_task(Build_Cache *cache, Bind_Task task, gbFileContents input,
+                          gbArray(Include_File *) includes, gbArray(String) missing);
+// Another file written by the run, like a depfile
+void build_cache_add_output(Build_Cache *cache, String path);
+void build_cache_end(Build_Cache *cache);
+
+#endif
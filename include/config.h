@@ -77,6 +77,21 @@ typedef struct Config
      String directory;
      String out_directory;
 
+     // Number of tasks preprocessed/parsed at once
+     int jobs;
+
+     // If set, each task's preprocessed output is written there
+     String dump_pp_directory;
+
+     // If set, a run whose inputs have not changed since the last one is skipped
+     String cache_directory;
+     // If set too, the parse of each task is kept there, see `Ast_Cache`
+     b32 ast_cache;
+
+     // Makefile-style dependencies of the outputs, in one file and/or next to each output
+     String depfile;
+     b32 depfile_per_output;
+
      PreprocessorConfig pp_conf;
      BindConfig bind_conf;
 
@@ -88,5 +103,9 @@ Config *load_config(char *file, gbAllocator a);
 void update_config(Config *conf, char *file, gbAllocator a);
 
 void print_config(Config *conf);
+// Hash of every setting that affects the generated bindings
+u64 hash_config(Config *conf);
+u64 hash_pp_config(PreprocessorConfig *pp);
+u64 hash_combine(u64 seed, u64 hash);
 
 #endif
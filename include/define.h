@@ -9,6 +9,7 @@ typedef struct Define
 {
     b32 in_use;
     String key;
+    u32 ident; // `key` interned, the table is keyed on it
 
     Token_Run value;
     gbArray(Token_Run) params;
@@ -17,12 +18,48 @@ typedef struct Define
     isize line;
 } Define;
 
-GB_TABLE_DECLARE(, Define_Map, defines_, Define);
+typedef struct Define_Undo
+{
+    isize index;
+    Define prev;
+} Define_Undo;
+
+// Macros by interned name, in the order they were first defined. Entries
+// store their name and are only found through it, so two macros never share
+// one. Undefined macros keep their entry with `in_use` cleared.
+//
+// Everything set after `defines_snapshot` can be undone with
+// `defines_restore`. Entries added since are dropped, and entries that
+// were overwritten are put back from the journal. The journal is only kept
+// while a snapshot is taken.
+typedef struct Define_Map
+{
+    gbAllocator allocator;
+    gbArray(Define) entries;
+    u32 *slots; // Index into entries + 1, 0 if the slot is empty
+    u32 mask;
+
+    gbArray(Define_Undo) journal;
+    isize snapshots;
+} Define_Map;
+
+typedef struct Define_Snapshot
+{
+    isize entry_count;
+    isize journal_count;
+} Define_Snapshot;
+
+void defines_init(Define_Map *defines, gbAllocator a);
+void defines_destroy(Define_Map *defines);
+Define *defines_get(Define_Map *defines, u32 name);
+void defines_set(Define_Map *defines, Define define);
+Define_Snapshot defines_snapshot(Define_Map *defines);
+void defines_restore(Define_Map *defines, Define_Snapshot snapshot);
 
-void add_define(Define_Map **defines, String name, Token_Run value, gbArray(Token_Run) params, isize line, String file);
-void add_fake_define(Define_Map **defines, String name);
-void remove_define(Define_Map **defines, String name);
-Define *get_define(Define_Map *defines, String name);
+void add_define(Define_Map **defines, u32 name, Token_Run value, gbArray(Token_Run) params, isize line, String file);
+void add_fake_define(Define_Map **defines, u32 name);
+void remove_define(Define_Map **defines, u32 name);
+Define *get_define(Define_Map *defines, u32 name);
 void init_std_defines(Define_Map **defines);
 gbArray(Define) get_define_list(Define_Map *defines, String whitelist_dir, b32 shallow, gbAllocator alloc);
 
@@ -99,4 +99,7 @@ Expr *pp_parse_expression(Token_Run expr, gbAllocator allocator, Preprocessor *p
 u64 pp_eval_expression(Preprocessor *pp, Expr *expr);
 void free_expr(gbAllocator a, Expr *expr);
 
+// Evaluates a #if/#elif line without building the tree
+u64 pp_eval_directive(Preprocessor *pp, Token_Run expr);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,14 @@
+#ifndef _C_BIND_FILE_MAP_H_
+#define _C_BIND_FILE_MAP_H_
+
+#include "gb/gb.h"
+
+// Read-only, memory-mapped file contents, always followed by a NUL.
+// Files filling their last page exactly have no room for the NUL, so they
+// are read into `fallback` instead, as are files that fail to map.
+// Like `gb_file_read_contents`, missing and empty files give `data == 0`.
+// Mapped contents have no allocator, free either kind with `unmap_file_contents`.
+gbFileContents map_file_contents(gbAllocator fallback, char const *filepath);
+void unmap_file_contents(gbFileContents *fc);
+
+#endif
@@ -52,15 +52,23 @@ extern int hashmap_iterate(map_t in, PFany f, any_t item);
 
 extern int hashmap_iterate_entries(map_t in, PFentry f);
 
+/*
+* Hash of a key. Callers that keep it around, like the string interner, can
+* pass it to the _hashed variants below instead of hashing the key again.
+*/
+extern u64 hashmap_hash(String key);
+
 /*
 * Add an element to the hashmap. Return MAP_OK or MAP_OMEM.
 */
 extern int hashmap_put(map_t in, String key, any_t value);
+extern int hashmap_put_hashed(map_t in, String key, u64 hash, any_t value);
 
 /*
 * Get an element from the hashmap. Return MAP_OK or MAP_MISSING.
 */
 extern int hashmap_get(map_t in, String key, any_t *arg);
+extern int hashmap_get_hashed(map_t in, String key, u64 hash, any_t *arg);
 
 /*
 * Remove an element from the hashmap. Return MAP_OK or MAP_MISSING.
@@ -71,12 +79,12 @@ extern int hashmap_remove(map_t in, String key);
 * Check if an element exists in the hashmap
 */
 extern int hashmap_exists(map_t in, String key);
+extern int hashmap_exists_hashed(map_t in, String key, u64 hash);
 
 /*
-* Get any element. Return MAP_OK or MAP_MISSING.
-* remove - should the element be removed from the hashmap
+* Put every element of src into dst. Return MAP_OK or MAP_OMEM.
 */
-extern int hashmap_get_one(map_t in, any_t *arg, int remove);
+extern int hashmap_merge(map_t dst, map_t src);
 
 /*
 * Free the hashmap
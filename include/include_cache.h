@@ -0,0 +1,54 @@
+#ifndef C_PREPROCESSOR_INCLUDE_CACHE_H
+#define C_PREPROCESSOR_INCLUDE_CACHE_H 1
+
+#include "gb/gb.h"
+#include "types.h"
+#include "tokenizer.h"
+#include "hashmap.h"
+
+// A file read and tokenized once per run, shared by every Preprocessor.
+// The tokens must be treated as read-only.
+typedef struct Include_File
+{
+    String path;
+    u32 file; // see `intern_file`
+    gbFileContents contents;
+    gbArray(Token) tokens;
+    Directive_Index directives;
+
+    // Interned name of the guard, if the whole file is wrapped in
+    // `#ifndef guard ... #endif`, 0 otherwise
+    u32 guard;
+
+    // `hashmap_hash` of the contents, see `include_file_hash`
+    u64 hash;
+    b32 hashed;
+} Include_File;
+
+typedef struct Include_Cache
+{
+    gbMutex mutex;
+    map_t files;    // {String:Include_File*}
+    map_t missing;  // {String:0}, paths known not to exist
+    map_t resolved; // {String:Resolved_Include*}, see make_include_key
+    gbAllocator allocator;
+} Include_Cache;
+
+// Outcome of an include search
+typedef struct Resolved_Include
+{
+    Include_File *file;
+    gbArray(String) missing; // Paths tried before `file`, 0 if none
+} Resolved_Include;
+
+void init_include_cache(void);
+Include_File *get_include_file(char *path);
+u32 find_include_guard(gbArray(Token) tokens);
+// Hashed on first use
+u64 include_file_hash(Include_File *file);
+
+String make_include_key(gbAllocator a, String filename, String from_dir, b32 local_first, b32 next);
+Resolved_Include *get_resolved_include(String key);
+void put_resolved_include(String key, Include_File *file, gbArray(String) missing);
+
+#endif /* ifndef C_PREPROCESSOR_INCLUDE_CACHE_H */
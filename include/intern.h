@@ -0,0 +1,45 @@
+#ifndef _BIND_INTERN_H_
+#define _BIND_INTERN_H_
+
+#include "gb/gb.h"
+#include "strings.h"
+#include "arena.h"
+
+// Identifiers are interned once, by the tokenizer, into a table shared by
+// every task. The id of a spelling never changes and never is 0, so ids can
+// be compared instead of strings and used directly as keys. The table keeps
+// the `hashmap_hash` of each spelling, so string maps don't hash it again.
+//
+// The table is split in shards by hash, each with its own lock. Entries are
+// never moved once added, so looking up an id doesn't need the lock.
+#define INTERN_SHARD_BITS 6
+#define INTERN_SHARDS (1 << INTERN_SHARD_BITS)
+#define INTERN_CHUNK_SIZE 1024
+#define INTERN_MAX_CHUNKS 4096
+
+typedef struct Interned
+{
+    String str;
+    u64 hash;
+} Interned;
+
+typedef struct Intern_Shard
+{
+    gbMutex mutex;
+    Arena strings;
+
+    // Open-addressed, ids of this shard, 0 if the slot is empty
+    u32 *slots;
+    u32 mask;
+    u32 count;
+
+    Interned *entries[INTERN_MAX_CHUNKS];
+} Intern_Shard;
+
+void init_interner(void);
+u32 intern(String str);
+u32 intern_hashed(String str, u64 hash);
+String interned_string(u32 id);
+u64 interned_hash(u32 id);
+
+#endif
@@ -17,19 +17,31 @@ typedef struct Parser
     Token *start, *curr, *end;
     gbAllocator alloc;
     int node_index;
+    u32 node_count; // Made so far, sizes the tables of `encode_ast_file`
 
     b32 no_backtrack;
 
     map_t type_table;
     map_t opaque_types;
-    
+    // When set, what the parse declares and looks up in the tables above is
+    // logged in `log`, each name once. A lookup of a name the parse declared
+    // itself isn't, its answer doesn't depend on the tables.
+    map_t logged; // {String:LOGGED_*}
+    Type_Log log;
+
     Ast_File file;
 } Parser;
 
-Parser make_parser();
+Parser make_parser(gbAllocator alloc);
 void destroy_parser(Parser p);
 void parse_file(Parser *p);
 void parse_defines(Parser *p, gbArray(Define) defines);
 
+// Starts logging into `Parser.log`, allocated with `a`
+void parser_log_types(Parser *p, gbAllocator a);
+// Whether every name `log` found as a type is one in `type_table`, and none
+// it missed is
+b32 type_log_holds(Type_Log log, map_t type_table);
+
 
 #endif
@@ -0,0 +1,54 @@
+#ifndef _BIND_PP_SNAPSHOT_H_
+#define _BIND_PP_SNAPSHOT_H_
+
+#include "gb/gb.h"
+#include "strings.h"
+#include "arena.h"
+#include "define.h"
+#include "include_cache.h"
+#include "preprocess.h"
+
+#define PP_SNAPSHOT_VERSION 3
+
+// The state of a preprocessor right after the pre-includes of a file: the
+// macro table, the output, `#pragma once` files and the files included.
+// Tasks with the same pre-includes restore it instead of preprocessing them
+// again. It is shared by every task and must be treated as read-only.
+//
+// Snapshots are stored in a pointer-free binary encoding, see
+// `pp_snapshot.c`, with the hash of every file they were made from and the
+// include paths that were tried and missing. A snapshot whose files changed,
+// or one of whose missing paths now exists, is never loaded.
+struct PP_Snapshot
+{
+    u64 key;
+    Arena *arena;
+    // The encoding, token spellings and file names point into it
+    gbFileContents data;
+
+    gbArray(Define) defines; // In definition order, `file` isn't owned
+    Token *output;
+    isize output_count;
+    gbArray(String) pragma_onces;
+    // Only `path`, `file` and `hash` are set
+    gbArray(Include_File) includes;
+    gbArray(String) missing; // See `Preprocessor.missing`
+
+    i32 write_line;
+    i32 write_column;
+};
+
+// Identifies the pre-includes of a file under a preprocessor configuration
+u64 pp_snapshot_key(PreprocessorConfig *conf, gbArray(String) system_includes, String root_dir, gbArray(String) pre_includes);
+
+// Preprocesses the pre-includes of `filename` on their own, 0 if they
+// can't be snapshot (e.g. a conditional left open)
+PP_Snapshot *make_pp_snapshot(u64 key, String root_dir, String filename, PreprocessorConfig *conf, gbArray(String) system_includes);
+// Loads the snapshot in `path` if it has `key` and none of its files changed
+PP_Snapshot *load_pp_snapshot(char const *path, u64 key);
+void save_pp_snapshot(PP_Snapshot *snapshot, char const *path);
+void destroy_pp_snapshot(PP_Snapshot *snapshot);
+
+void pp_restore_snapshot(Preprocessor *pp, PP_Snapshot *snapshot);
+
+#endif
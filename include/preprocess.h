@@ -8,6 +8,8 @@
 #include "parse_common.h"
 #include "config.h"
 #include "hashmap.h"
+#include "arena.h"
+#include "include_cache.h"
 
 typedef struct Cond_Stack
 {
@@ -15,17 +17,27 @@ typedef struct Cond_Stack
     b32 skip_else;
 } Cond_Stack;
 
+typedef struct Macro_Arg
+{
+    Token_Run run;
+    b32 expanded; // Set once `run` went through `pp_expand_arg`
+} Macro_Arg;
+
 typedef struct PP_Context
 {
     struct PP_Context *next;
 
     Token_Run tokens;
 	Token *prev_token;
+    // Of the file `tokens` come from, 0 for anything else
+    Directive_Index *directives;
 
     // location relative to beginning of file
     isize line;   // starts at 1
     isize column; // starts at 0
     String filename;
+    u32 file;   // `filename` in the file table
+    u32 origin; // Added on the first write from this context, see `add_token_origin`
     
     b32 in_macro;
     Define macro;
@@ -44,11 +56,22 @@ typedef struct PP_Context
 
     b32 in_sandbox;
 
-    Define_Map *local_defines;
+    // Arguments of `macro`, one per parameter, see `pp_get_define`.
+    // `arg_storage` belongs to this node and is reused along with it.
+    Macro_Arg *args;
+    isize arg_count;
+    gbArray(Macro_Arg) arg_storage;
+    // Where the arguments are expanded before use, 0 if they are used as
+    // they are. Always below this context, so it outlives it.
+    struct PP_Context *arg_context;
+    b32 has_va_args;
+    b32 va_args_empty;
 } PP_Context;
 
 typedef struct Preprocessor
 {
+    // Everything the preprocessor allocates lives until `destroy_preprocessor`
+    Arena *arena;
     gbAllocator allocator;
     PreprocessorConfig *conf;
     
@@ -56,6 +79,11 @@ typedef struct Preprocessor
     gbArray(Token *) file_tokens;
     
     PP_Context *context;
+    Token *directive; // `#` of the directive being handled
+    Directive_Index root_directives;
+    // Popped contexts and conditionals, reused instead of growing the arena
+    PP_Context *free_contexts;
+    Cond_Stack *free_conditionals;
 
     Token *end_of_prev;
 
@@ -74,18 +102,42 @@ typedef struct Preprocessor
 
     gbArray(Token) output;
 
+    // Macro arguments being parsed, see `pp_do_macro`
+    gbArray(Token_Run) arg_stack;
+
     b32 stringify_next;
     b32 paste_next;
     
     map_t pragma_onces;
+
+    // Every file resolved by #include or a pre-include, in first-use order
+    gbArray(Include_File *) includes;
+    map_t included; // {String:0}
+    // Paths the include search tried that didn't exist. The result changes
+    // if one of them appears, so build caches check them too.
+    gbArray(String) missing;
+    map_t missed; // {String:0}
     // String whitelist;
 } Preprocessor;
 
-Preprocessor *make_preprocessor(gbArray(Token) tokens, String root_dir, String filename, PreprocessorConfig *conf);
+// Interned `defined`, set by `init_preprocessor`
+extern u32 ident_defined;
+
+typedef struct PP_Snapshot PP_Snapshot;
+
+void init_preprocessor(void);
+// Starts from `prefix` if given, instead of preprocessing the pre-includes
+// of `filename` again, see `pp_snapshot.h`
+Preprocessor *make_preprocessor(gbArray(Token) tokens, String root_dir, String filename, PreprocessorConfig *conf, PP_Snapshot *prefix);
 void destroy_preprocessor(Preprocessor *pp);
 
+gbArray(String) pp_pre_includes(PreprocessorConfig *conf, String root_dir, String filename);
+void pp_add_include(Preprocessor *pp, Include_File *file);
+// `path` isn't copied, it must outlive the preprocessor
+void pp_add_missing(Preprocessor *pp, String path);
+
 void run_pp(Preprocessor *pp);
-Define pp_get_define(Preprocessor *pp, String name);
+Define pp_get_define(Preprocessor *pp, u32 name);
 
 gbArray(Token) pp_do_sandboxed_macro(Preprocessor *pp, Token_Run *run, Define define, Token name);
 gbArray(Define) pp_dump_defines(Preprocessor *pp, String whitelist_dir);
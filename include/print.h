@@ -6,15 +6,18 @@
 #include "util.h"
 #include "resolve.h"
 #include "config.h"
+#include "arena.h"
+#include "writer.h"
 
 typedef struct Printer
 {
 
      Ast_File file;
-     gbFile *out_file;
+     Writer *out;
      Package package;
      
      map_t rename_map;
+     Rename_Cache *renames;
      BindConfig *conf;
 
      map_t wrap_rename_map;
@@ -30,11 +33,15 @@ typedef struct Printer
 
      gbArray(Node *) needs_opaque_def;
 
+     // Scratch memory is rolled back after each file is printed
+     Arena *arena;
      gbAllocator allocator;
 } Printer;
 
-Printer make_printer(Resolver resolver);
-void print_package(Printer p);
+Printer make_printer(Resolver resolver, Arena *arena);
+void destroy_printer(Printer p);
+// Returns the number of files that already had the generated contents
+int print_package(Printer p);
 void print_indent(Printer p, int indent);
 void print_ident(Printer p, Node *node, int indent);
 void print_basic_lit(Printer p, Node *node, int indent);
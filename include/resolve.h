@@ -30,7 +30,7 @@ typedef struct Resolver
     gbAllocator allocator;
 } Resolver;
 
-Resolver make_resolver(Package p, BindConfig *conf);
+Resolver make_resolver(Package p, BindConfig *conf, gbAllocator allocator);
 void resolve_package(Resolver *r);
 
 #endif
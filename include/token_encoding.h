@@ -0,0 +1,119 @@
+#ifndef _BIND_TOKEN_ENCODING_H_
+#define _BIND_TOKEN_ENCODING_H_
+
+#include "gb/gb.h"
+#include "strings.h"
+#include "hashmap.h"
+#include "tokenizer.h"
+#include "writer.h"
+
+// Shared by the binary caches, see `pp_snapshot.c` and `ast_cache.c`.
+//
+// Tokens are stored as they are, with the fields that only mean something
+// in this run replaced by positions in tables written next to them:
+//     str.start   offset in the string blob + 1, 0 for a null string
+//     loc.file    index in the file table, 0 is no file
+//     origin      index in the origin table, 0 is no origin
+//     ident       index in the identifier table, 0 is none
+// Decoding interns the tables again and puts the fields back.
+
+#define ENCODED_NULL 0xffffffffu
+
+// `gb_array_appendv` sets the count through the header it had before growing,
+// so room is made first
+#define encoded_appendv(x, items, item_count) do {                \
+    if (gb_array_capacity(x) < gb_array_count(x)+(item_count))      \
+        gb_array_grow(x, gb_array_count(x)+(item_count));           \
+    gb_array_appendv(x, items, item_count);                         \
+} while (0)
+
+typedef struct Encoded_String
+{
+    u32 offset; // ENCODED_NULL for a null string
+    u32 len;
+} Encoded_String;
+
+typedef struct Encoded_Origin
+{
+    u32 file;
+    i32 line;
+    i32 column;
+} Encoded_Origin;
+
+// Sizes of the tables, kept in the header of each format
+typedef struct Token_Tables
+{
+    u32 string_size;
+    u32 file_count;
+    u32 origin_count;
+    u32 ident_count;
+} Token_Tables;
+
+// Open addressing from a nonzero key, like a pointer or an interned id, to
+// an index. An encoding looks up every token and node, which `hashmap` with
+// its string keys is too slow for.
+typedef struct Id_Entry
+{
+    u64 key;
+    u32 value;
+} Id_Entry;
+
+typedef struct Id_Table
+{
+    gbAllocator allocator;
+    Id_Entry *entries; // Keys next to their values, a lookup reads one cache line
+    u32 count;
+    u32 mask;
+} Id_Table;
+
+void id_table_init(Id_Table *table, gbAllocator a);
+// Makes room for `count` keys, so adding them doesn't grow the table
+void id_table_reserve(Id_Table *table, u32 count);
+// The value of `key`, added as 0 if it is missing
+u32 *id_table_get(Id_Table *table, u64 key);
+
+typedef struct Token_Encoder
+{
+    gbArray(char) strings;
+    map_t string_offsets; // {String:offset+1}
+
+    gbArray(Encoded_String) files;
+    Id_Table file_indices; // {file:index}
+    u32 last_file, last_file_index;
+    gbArray(Encoded_Origin) origins;
+    u32 last_origin;
+    gbArray(Encoded_String) idents;
+    Id_Table ident_indices; // {ident:index}
+} Token_Encoder;
+
+typedef struct Token_Decoder
+{
+    char *strings;
+    u32 string_size;
+    u32 *files;
+    u32 file_count;
+    u32 *origins;
+    u32 origin_count;
+    u32 *idents;
+    u32 ident_count;
+} Token_Decoder;
+
+void token_encoder_init(Token_Encoder *e, gbAllocator a);
+Encoded_String encode_string(Token_Encoder *e, String str);
+u32 encode_ident(Token_Encoder *e, u32 ident);
+Token encode_token(Token_Encoder *e, Token tok);
+// Writes the tables and fills `tables` with their sizes
+void write_token_tables(Token_Encoder *e, Writer *out, Token_Tables *tables);
+
+// Reads the tables at `offset`, false if they don't fit in `data`
+b32 token_decoder_init(Token_Decoder *d, gbFileContents data, isize *offset, Token_Tables tables, gbAllocator a);
+String decode_string(Token_Decoder *d, Encoded_String str);
+// Decodes `tok` in place, false if one of its indices is out of range
+b32 decode_token(Token_Decoder *d, Token *tok);
+
+// Sections of the encodings start on 8 bytes
+void write_section(Writer *out, void const *data, isize size);
+// The next section of `count` records, 0 if it runs past the end of `data`
+void *read_section(gbFileContents data, isize *offset, isize count, isize record_size);
+
+#endif
@@ -3,6 +3,8 @@
 
 #include "gb/gb.h"
 #include "strings.h"
+#include "hashmap.h"
+#include "intern.h"
 
 #define TOKEN_KINDS                             \
 TOKEN_KIND(Token_Invalid, "Invalid"),       \
@@ -150,27 +152,67 @@ gb_global String const TokenKind_Strings[Token_Count] = {
 #undef TOKEN_KIND
 };
 
+#define DIRECTIVE_KINDS                               \
+DIRECTIVE_KIND(Directive_None,         ""),             \
+DIRECTIVE_KIND(Directive_define,       "define"),       \
+DIRECTIVE_KIND(Directive_undef,        "undef"),        \
+DIRECTIVE_KIND(Directive_include,      "include"),      \
+DIRECTIVE_KIND(Directive_include_next, "include_next"), \
+DIRECTIVE_KIND(Directive_if,           "if"),           \
+DIRECTIVE_KIND(Directive_ifdef,        "ifdef"),        \
+DIRECTIVE_KIND(Directive_ifndef,       "ifndef"),       \
+DIRECTIVE_KIND(Directive_elif,         "elif"),         \
+DIRECTIVE_KIND(Directive_else,         "else"),         \
+DIRECTIVE_KIND(Directive_endif,        "endif"),        \
+DIRECTIVE_KIND(Directive_error,        "error"),        \
+DIRECTIVE_KIND(Directive_warning,      "warning"),      \
+DIRECTIVE_KIND(Directive_line,         "line"),         \
+DIRECTIVE_KIND(Directive_pragma,       "pragma"),       \
+DIRECTIVE_KIND(Directive___pragma,     "__pragma"),
+
+typedef enum Directive_Kind
+{
+#define DIRECTIVE_KIND(e, s) e
+    DIRECTIVE_KINDS
+#undef DIRECTIVE_KIND
+    Directive_Count
+} Directive_Kind;
+
+gb_global String const Directive_Kind_Strings[Directive_Count] = {
+#define DIRECTIVE_KIND(e, s) {s, gb_size_of(s)-1}
+    DIRECTIVE_KINDS
+#undef DIRECTIVE_KIND
+};
+
 typedef struct Tokenizer
 {
     char *start, *curr, *end;
     char *line_start;
-    isize line;
-    String file;
+    i32 line;
+    u32 file;
 } Tokenizer;
 
+// `file` is an index into the file table, see `intern_file`/`file_name`.
+// 0 is reserved for tokens that don't come from a file.
 typedef struct File_Location
 {
-    isize line, column;
-    String file;
+    u32 file;
+    i32 line, column;
 } File_Location;
 
 typedef struct Token
 {
     TokenKind kind;
-    String str;
     File_Location loc;
-    File_Location pp_loc;
-    File_Location from_loc;
+    String str;
+    // Position in the preprocessed output, the file is always the output
+    struct { i32 line, column; } pp_loc;
+    // Index into the origin table for tokens written from a macro or an
+    // include, see `token_origin`. 0 if the token has no origin.
+    u32 origin;
+    // Interned spelling of identifiers and keywords, see `intern`. 0 for
+    // other tokens.
+    u32 ident;
 } Token;
 
 typedef struct Token_Run
@@ -178,6 +220,70 @@ typedef struct Token_Run
     Token *start, *curr, *end;
 } Token_Run;
 
+// File names and token origins are shared by every task. An index picks a
+// list of chunks from a fixed directory, a chunk from the list, then the
+// entry. Lists and chunks are added under the lock but never moved, so
+// lookups don't need it. Every u32 index fits.
+#define LOCATION_CHUNK_BITS 12
+#define LOCATION_LIST_BITS  10
+#define LOCATION_CHUNK_SIZE (1 << LOCATION_CHUNK_BITS)
+#define LOCATION_LIST_SIZE  (1 << LOCATION_LIST_BITS)
+#define LOCATION_LISTS      (1 << (32 - LOCATION_LIST_BITS - LOCATION_CHUNK_BITS))
+
+typedef struct Location_Table
+{
+    gbMutex mutex;
+    map_t file_ids; // {String:u32}
+
+    String **files[LOCATION_LISTS];
+    u32 file_count;
+
+    File_Location **origins[LOCATION_LISTS];
+    u32 origin_count;
+} Location_Table;
+
+// Open-addressed table of the keyword range of `TOKEN_KINDS`, built once by
+// `init_keyword_table`. Empty slots are 0 (Token_Invalid).
+#define KEYWORD_TABLE_SIZE 256
+
+void init_keyword_table(void);
+TokenKind keyword_kind(String str);
+
+// Keyed by the interned name, filled by `init_keyword_table`
+#define DIRECTIVE_TABLE_SIZE 64
+
+Directive_Kind directive_kind(u32 ident);
+
+// Conditional directives of a file, in order. `next` is the #elif, #else or
+// #endif that ends the block opened by the directive, -1 for #endif or if
+// the block is never closed.
+typedef struct Cond_Directive
+{
+    u32 hash; // Index of the `#` in the file's tokens
+    Directive_Kind kind;
+    i32 next;
+} Cond_Directive;
+
+typedef struct Directive_Index
+{
+    Token *tokens;
+    isize token_count;
+    gbArray(Cond_Directive) conds;
+} Directive_Index;
+
+Directive_Index index_directives(gbArray(Token) tokens, gbAllocator allocator);
+isize find_cond_directive(Directive_Index *index, Token *hash);
+
+void init_location_table(void);
+u32 intern_file(String filename);
+String file_name(u32 file);
+u32 add_token_origin(File_Location loc);
+File_Location token_origin(Token tok);
+
+// Spelling and `hashmap_hash` of an identifier token, from the interner
+String ident_string(Token tok);
+u64 ident_hash(Token tok);
+
 Tokenizer make_tokenizer(gbFileContents fc, String filename);
 b32 try_increment_line(Tokenizer *t);
 b32 skip_space(Tokenizer *t);
@@ -7,6 +7,7 @@
 #include "config.h"
 #include "strings.h"
 #include "symbol.h"
+#include "arena.h"
 
 #include "gb/gb.h"
 
@@ -14,6 +15,11 @@
 Token_Run alloc_token_run(Token *tokens, int count);
 
 void create_path_to_file(char const *filename);
+// Moves `from` over `to` in one step, replacing `to` if it exists
+b32 replace_file(char const *from, char const *to);
+// Replaces `filename` with `data` through a temporary file, unless it already
+// holds exactly that. Returns false if the file was left untouched.
+b32 write_file_if_changed(char const *filename, void const *data, isize len);
 
 /* Time helper functions */
 char *date_string(u64 time);
@@ -40,9 +46,29 @@ typedef enum Rename_Kind {
 } Rename_Kind;
 String rename_ident(String orig, Rename_Kind r, b32 do_remove_prefix, map_t rename_map, BindConfig *conf, gbAllocator allocator);
 
+// Results of `rename_ident` by interned name, kind and prefix removal. The
+// rename map must not change anymore, so it is filled as names are used.
+// Results live in the cache's own arena.
+typedef struct Rename_Cache
+{
+    map_t rename_map;
+    BindConfig *conf;
+    Arena *arena;
+
+    // Open-addressed, see `rename_key`, 0 if the slot is empty
+    u64 *keys;
+    String *values;
+    u32 mask;
+    u32 count;
+} Rename_Cache;
+
+Rename_Cache *make_rename_cache(map_t rename_map, BindConfig *conf);
+void destroy_rename_cache(Rename_Cache *cache);
+String rename_cached(Rename_Cache *cache, Token name, Rename_Kind r, b32 do_remove_prefix);
+
 String float_type_str(Node *type);
 String integer_type_str(Node *type);
-String convert_type(Node *type, map_t rename_map, BindConfig *conf, gbAllocator allocator);
+String convert_type(Node *type, Rename_Cache *renames, gbAllocator allocator);
 
 char *repeat_char(char c, int count, gbAllocator allocator);
 
@@ -55,6 +81,7 @@ typedef struct System_Directories
 } System_Directories;
 
 System_Directories get_system_includes(gbAllocator a);
-gbArray(Lib) get_library_info(System_Directories system_dirs, gbArray(String) libraries);
+// `missing` is set to the library paths tried that didn't exist
+gbArray(Lib) get_library_info(System_Directories system_dirs, gbArray(String) libraries, gbArray(String) *missing);
 
 #endif /* ifndef _C_BIND_UTIL_H */
@@ -0,0 +1,33 @@
+#ifndef _BIND_WRITER_H_
+#define _BIND_WRITER_H_
+
+#include "gb/gb.h"
+#include "strings.h"
+
+#define WRITER_BUFFER_SIZE gb_kilobytes(64)
+// Longest single `writer_printf`, the same limit as `gb_fprintf`
+#define WRITER_MAX_PRINTF 4096
+
+// Buffered output to a file. Writes are collected in memory and handed to
+// the file in large chunks, instead of one syscall per `gb_fprintf`.
+// Without a file, the buffer grows to hold everything written instead.
+// Not thread-safe, use one writer per file.
+typedef struct Writer
+{
+    gbFile *file;
+    gbAllocator allocator;
+    char *buffer;
+    isize len;
+    isize cap;
+} Writer;
+
+void writer_init(Writer *w, gbFile *file, gbAllocator allocator);
+void writer_flush(Writer *w);
+// Makes room for `len` more bytes, flushing to the file or growing the buffer
+void writer_reserve(Writer *w, isize len);
+void writer_write(Writer *w, void const *data, isize len);
+void writer_string(Writer *w, String str);
+void writer_spaces(Writer *w, isize count);
+isize writer_printf(Writer *w, char const *fmt, ...) GB_PRINTF_ARGS(2);
+
+#endif
@@ -27,6 +27,38 @@ project "bind"
     filter "system:windows"
         links { "bind_find_vs", "kernel32.lib" }
 
+-- Tools with a main of their own, built from every source but main.c
+function tool_project(name, file)
+    project(name)
+        kind "ConsoleApp"
+        language "C"
+        location "build"
+
+        targetname(name)
+        targetdir "."
+
+        includedirs { "./include", "./lib" }
+        files { "./src/*.c", file }
+        removefiles { "./src/main.c" }
+
+        filter "system:linux"
+            links { "pthread", "dl" }
+
+        filter "system:windows"
+            links { "bind_find_vs", "kernel32.lib" }
+
+        filter {}
+end
+
+-- Round-trip check and load benchmark for the AST cache
+tool_project("ast_cache_test", "./test/ast_cache_test.c")
+-- Identifiers per second through the tokenizer
+tool_project("tokenizer_bench", "./bench/tokenizer_bench.c")
+-- Puts and gets per second through the hashmap
+tool_project("hashmap_bench", "./bench/hashmap_bench.c")
+-- #if and #elif lines per second through the preprocessor
+tool_project("pp_if_bench", "./bench/pp_if_bench.c")
+
 project "bind_find_vs"
     kind "StaticLib"
     language "C++"
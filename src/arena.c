@@ -0,0 +1,114 @@
+#include "arena.h"
+
+void arena_init(Arena *arena, gbAllocator backing, isize block_size)
+{
+    arena->backing = backing;
+    arena->block_size = block_size;
+    gb_array_init(arena->blocks, backing);
+}
+
+void arena_free(Arena *arena)
+{
+    for (int i = 0; i < gb_array_count(arena->blocks); i++)
+    {
+        gb_arena_free(arena->blocks[i]);
+        gb_free(arena->backing, arena->blocks[i]);
+    }
+    gb_array_free(arena->blocks);
+    arena->blocks = 0;
+}
+
+Arena *make_arena(void)
+{
+    gbAllocator a = gb_heap_allocator();
+    Arena *arena = gb_alloc_item(a, Arena);
+    arena_init(arena, a, ARENA_BLOCK_SIZE);
+    return arena;
+}
+
+void destroy_arena(Arena *arena)
+{
+    arena_free(arena);
+    gb_free(gb_heap_allocator(), arena);
+}
+
+gbArena *arena_push_block(Arena *arena, isize min_size)
+{
+    gbArena *block = gb_alloc_item(arena->backing, gbArena);
+    gb_arena_init_from_allocator(block, arena->backing, gb_max(arena->block_size, min_size));
+    gb_array_append(arena->blocks, block);
+    return block;
+}
+
+gbAllocator arena_allocator(Arena *arena)
+{
+    gbAllocator allocator;
+    allocator.proc = arena_allocator_proc;
+    allocator.data = arena;
+    return allocator;
+}
+
+GB_ALLOCATOR_PROC(arena_allocator_proc)
+{
+    Arena *arena = (Arena *)allocator_data;
+    void *ptr = NULL;
+
+    switch (type)
+    {
+    case gbAllocation_Alloc: {
+        gbArena *block = 0;
+        if (gb_array_count(arena->blocks) > 0)
+            block = arena->blocks[gb_array_count(arena->blocks)-1];
+        // gbArena reserves `size + alignment` for every allocation
+        if (!block || block->total_allocated + size + alignment > block->total_size)
+            block = arena_push_block(arena, size + alignment);
+        ptr = gb_arena_allocator_proc(block, type, size, alignment, old_memory, old_size, flags);
+    } break;
+
+    case gbAllocation_Free:
+        // Released all at once in `arena_free`
+        break;
+
+    case gbAllocation_FreeAll:
+        for (int i = 1; i < gb_array_count(arena->blocks); i++)
+        {
+            gb_arena_free(arena->blocks[i]);
+            gb_free(arena->backing, arena->blocks[i]);
+        }
+        if (gb_array_count(arena->blocks) > 0)
+        {
+            gb_array_resize(arena->blocks, 1);
+            arena->blocks[0]->total_allocated = 0;
+        }
+        break;
+
+    case gbAllocation_Resize:
+        ptr = gb_default_resize_align(arena_allocator(arena), old_memory, old_size, size, alignment);
+        break;
+    }
+    return ptr;
+}
+
+Arena_Temp arena_temp_begin(Arena *arena)
+{
+    if (gb_array_count(arena->blocks) == 0)
+        arena_push_block(arena, 0);
+
+    Arena_Temp temp;
+    temp.arena = arena;
+    temp.block_count = gb_array_count(arena->blocks);
+    temp.mem = gb_temp_arena_memory_begin(arena->blocks[temp.block_count-1]);
+    return temp;
+}
+
+void arena_temp_end(Arena_Temp temp)
+{
+    Arena *arena = temp.arena;
+    for (int i = temp.block_count; i < gb_array_count(arena->blocks); i++)
+    {
+        gb_arena_free(arena->blocks[i]);
+        gb_free(arena->backing, arena->blocks[i]);
+    }
+    gb_array_resize(arena->blocks, temp.block_count);
+    gb_temp_arena_memory_end(temp.mem);
+}
@@ -0,0 +1,725 @@
+#include "ast_cache.h"
+#include "file_map.h"
+#include "writer.h"
+#include "define.h"
+#include "token_encoding.h"
+#include "util.h"
+
+// Encoding, in native byte order:
+//     Ast_Header
+//     stream        of varints, 7 bits a byte from the lowest
+//     token tables  see `token_encoding.h`
+// The stream holds the nodes, then the lists of the Ast_File and the parser's
+// logs, then the defines. Nodes are numbered from 1 in the order they're
+// written, each after the nodes it points to. A node is its kind and flags,
+// its `index` if it has one, then its fields in the order of
+// `visit_node_fields`:
+//     Node *           how many nodes back it is, 0 for a null node
+//     gbArray(Node *)  0 for a null list, else the count + 1, then each node
+//                      zigzagged from the one before + 1, 0 for a null node
+//     Token            see `write_token`
+//     gbArray(Token)   0 for a null list, else the count + 1, then the tokens
+//     String           0 for a null string, 1 for the spelling of the last
+//                      token, else the string offset + 2 and the length
+//     scalars          as they are
+// Signed differences are zigzagged, 0, -1, 1, -2... to 0, 1, 2, 3... The lists
+// at the end count back from past the last node. A define is its name, its
+// identifier, then the number of tokens of its value and the tokens.
+#define AST_MAGIC "bindast"
+
+typedef struct Ast_Header
+{
+    char magic[8];
+    u32 version;
+    u32 node_count;
+    u64 key; // Set when saved, see `save_ast_cache`
+    // `hashmap_hash` of everything after it. The decoder only checks that
+    // what it reads is in range, a damaged node would reach the resolver.
+    u64 check;
+    Token_Tables tables;
+    u32 stream_size;
+    u32 define_count;
+} Ast_Header;
+
+// See `Ast_Header.check`
+u64 ast_check(void const *data, isize size)
+{
+    isize start = gb_offset_of(Ast_Header, check) + gb_size_of(u64);
+    return hashmap_hash((String){(char *)data + start, size - start});
+}
+
+void visit_node_fields(Node *n, Node_Fields *f)
+{
+#define NODE(field_)   f->node(f->data, &n->field_)
+#define TOKEN(field_)  f->token(f->data, &n->field_)
+#define STRING(field_) f->string(f->data, &n->field_)
+#define NODES(field_)  f->nodes(f->data, &n->field_)
+#define TOKENS(field_) f->tokens(f->data, &n->field_)
+#define SCALAR(field_) f->scalar(f->data, (u32 *)&n->field_)
+    switch (n->kind)
+    {
+    case NodeKind_Ident:         TOKEN(Ident.token); STRING(Ident.ident); break;
+    case NodeKind_Typedef:       TOKEN(Typedef.token); NODE(Typedef.var_list); break;
+    case NodeKind_BasicLit:      TOKEN(BasicLit.token); break;
+    case NodeKind_String:        TOKENS(String.strings); break;
+    case NodeKind_CompoundLit:   NODE(CompoundLit.fields); TOKEN(CompoundLit.open); TOKEN(CompoundLit.close); break;
+    case NodeKind_Attribute:     NODE(Attribute.name); NODE(Attribute.ident); NODE(Attribute.args); break;
+    case NodeKind_AttrList:      NODES(AttrList.list); break;
+    case NodeKind_Define:        STRING(Define.name); NODE(Define.value); break;
+
+    case NodeKind_InvalidExpr:   TOKEN(InvalidExpr.start); TOKEN(InvalidExpr.end); break;
+    case NodeKind_UnaryExpr:     TOKEN(UnaryExpr.op); NODE(UnaryExpr.operand); break;
+    case NodeKind_BinaryExpr:    TOKEN(BinaryExpr.op); NODE(BinaryExpr.left); NODE(BinaryExpr.right); break;
+    case NodeKind_TernaryExpr:   NODE(TernaryExpr.cond); NODE(TernaryExpr.then); NODE(TernaryExpr.els_); break;
+    case NodeKind_ParenExpr:     NODE(ParenExpr.expr); TOKEN(ParenExpr.open); TOKEN(ParenExpr.close); break;
+    case NodeKind_SelectorExpr:  TOKEN(SelectorExpr.token); NODE(SelectorExpr.expr); NODE(SelectorExpr.selector); break;
+    case NodeKind_IndexExpr:     NODE(IndexExpr.expr); NODE(IndexExpr.index); TOKEN(IndexExpr.open); TOKEN(IndexExpr.close); break;
+    case NodeKind_CallExpr:      NODE(CallExpr.func); NODE(CallExpr.args); TOKEN(CallExpr.open); TOKEN(CallExpr.close); break;
+    case NodeKind_TypeCast:      NODE(TypeCast.type); NODE(TypeCast.expr); TOKEN(TypeCast.open); TOKEN(TypeCast.close); break;
+    case NodeKind_IncDecExpr:    NODE(IncDecExpr.expr); TOKEN(IncDecExpr.op); break;
+    case NodeKind_ExprList:      NODES(ExprList.list); break;
+
+    case NodeKind_EmptyStmt:     TOKEN(EmptyStmt.token); break;
+    case NodeKind_ExprStmt:      NODE(ExprStmt.expr); break;
+    case NodeKind_AssignStmt:    TOKEN(AssignStmt.token); NODE(AssignStmt.lhs); NODE(AssignStmt.rhs); break;
+    case NodeKind_CompoundStmt:  TOKEN(CompoundStmt.open); TOKEN(CompoundStmt.close); NODES(CompoundStmt.stmts); break;
+    case NodeKind_IfStmt:        TOKEN(IfStmt.token); NODE(IfStmt.cond); NODE(IfStmt.body); NODE(IfStmt.els_); break;
+    case NodeKind_ForStmt:       TOKEN(ForStmt.token); NODE(ForStmt.init); NODE(ForStmt.cond); NODE(ForStmt.post); NODE(ForStmt.body); break;
+    case NodeKind_WhileStmt:     TOKEN(WhileStmt.token); NODE(WhileStmt.cond); NODE(WhileStmt.body); SCALAR(WhileStmt.on_exit); break;
+    case NodeKind_ReturnStmt:    TOKEN(ReturnStmt.token); NODE(ReturnStmt.expr); break;
+    case NodeKind_SwitchStmt:    TOKEN(SwitchStmt.token); NODE(SwitchStmt.expr); NODE(SwitchStmt.body); break;
+    case NodeKind_CaseStmt:      TOKEN(CaseStmt.token); NODE(CaseStmt.value); NODES(CaseStmt.stmts); break;
+    case NodeKind_BranchStmt:    TOKEN(BranchStmt.token); break;
+
+    case NodeKind_VarDecl:       NODE(VarDecl.type); NODE(VarDecl.name); SCALAR(VarDecl.kind); break;
+    case NodeKind_VarDeclList:   NODES(VarDeclList.list); SCALAR(VarDeclList.kind); break;
+    case NodeKind_EnumField:     NODE(EnumField.name); NODE(EnumField.value); break;
+    case NodeKind_EnumFieldList: NODES(EnumFieldList.fields); break;
+    case NodeKind_FunctionDecl:  NODE(FunctionDecl.type); NODE(FunctionDecl.name); NODE(FunctionDecl.body); break;
+    case NodeKind_VaArgs:        TOKEN(VaArgs.token); break;
+
+    case NodeKind_IntegerType:   TOKENS(IntegerType.specifiers); break;
+    case NodeKind_FloatType:     TOKENS(FloatType.specifiers); break;
+    case NodeKind_PointerType:   TOKEN(PointerType.token); NODE(PointerType.type); break;
+    case NodeKind_ArrayType:     NODE(ArrayType.type); NODE(ArrayType.count); TOKEN(ArrayType.open); TOKEN(ArrayType.close); break;
+    case NodeKind_ConstType:     TOKEN(ConstType.token); NODE(ConstType.type); break;
+    case NodeKind_StructType:    TOKEN(StructType.token); NODE(StructType.name); NODE(StructType.fields);
+                                 SCALAR(StructType.has_bitfield); SCALAR(StructType.only_bitfield); break;
+    case NodeKind_UnionType:     TOKEN(UnionType.token); NODE(UnionType.name); NODE(UnionType.fields); break;
+    case NodeKind_EnumType:      TOKEN(EnumType.token); NODE(EnumType.name); NODE(EnumType.fields); break;
+    case NodeKind_FunctionType:  NODE(FunctionType.ret_type); NODE(FunctionType.params); TOKEN(FunctionType.calling_convention); break;
+    case NodeKind_BitfieldType:  NODE(BitfieldType.type); NODE(BitfieldType.size); break;
+
+    default: break;
+    }
+#undef NODE
+#undef TOKEN
+#undef STRING
+#undef NODES
+#undef TOKENS
+#undef SCALAR
+}
+
+u32 zigzag(i32 value)
+{
+    return ((u32)value << 1) ^ (u32)(value >> 31);
+}
+
+i32 unzigzag(u32 value)
+{
+    return (i32)(value >> 1) ^ -(i32)(value & 1);
+}
+
+#define MAX_VARINT_SIZE 5
+
+// Writes `value` at `p`, which has room for it, and returns the end
+u8 *put_varint(u8 *p, u32 value)
+{
+    while (value >= 0x80)
+    {
+        *p++ = (u8)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (u8)value;
+    return p;
+}
+
+void write_varint(Writer *out, u32 value)
+{
+    writer_reserve(out, MAX_VARINT_SIZE);
+    out->len = (char *)put_varint((u8 *)out->buffer + out->len, value) - out->buffer;
+}
+
+// Marks a node whose fields are being encoded, reaching it again is a cycle
+#define NODE_ENCODING U32_MAX
+
+typedef struct Ast_Encoder
+{
+    Token_Encoder table;
+    Writer out;
+
+    // A node's children are encoded before its record is written
+    Node_Fields children;
+    Node_Fields record;
+    Id_Table node_indices; // {Node *:index}
+    u32 node_count;
+    u32 base; // Index node fields are written back from
+    b32 cyclic;
+
+    // The last token, the next one is written relative to it
+    i32 line;
+    i32 pp_line;
+    u32 origin;
+    String str;
+} Ast_Encoder;
+
+// A token is its kind and identifier, its spelling, then its file, line,
+// column, line and column in the preprocessed output and origin. The lines
+// and the origin are zigzagged from the token before. The spelling is 0 for
+// a null string, 1 for the spelling of its identifier, else the string offset
+// + 2 and the length.
+void write_token(Ast_Encoder *e, Token tok)
+{
+    Token encoded = encode_token(&e->table, tok);
+    Encoded_String ident = e->table.idents[encoded.ident];
+    uintptr str = (uintptr)encoded.str.start;
+
+    // Room for every field at once
+    Writer *out = &e->out;
+    writer_reserve(out, 10*MAX_VARINT_SIZE);
+    u8 *p = (u8 *)out->buffer + out->len;
+    p = put_varint(p, encoded.kind);
+    p = put_varint(p, encoded.ident);
+    if (encoded.ident && str == (uintptr)ident.offset+1 && (u32)encoded.str.len == ident.len)
+        p = put_varint(p, 1);
+    else
+    {
+        p = put_varint(p, str ? (u32)str+1 : 0);
+        if (str)
+            p = put_varint(p, (u32)encoded.str.len);
+    }
+    p = put_varint(p, encoded.loc.file);
+    p = put_varint(p, zigzag((i32)((u32)encoded.loc.line - (u32)e->line)));
+    p = put_varint(p, (u32)encoded.loc.column);
+    p = put_varint(p, zigzag((i32)((u32)encoded.pp_loc.line - (u32)e->pp_line)));
+    p = put_varint(p, (u32)encoded.pp_loc.column);
+    p = put_varint(p, zigzag((i32)(encoded.origin - e->origin)));
+    out->len = (char *)p - out->buffer;
+
+    e->line = encoded.loc.line;
+    e->pp_line = encoded.pp_loc.line;
+    e->origin = encoded.origin;
+    e->str = tok.str;
+}
+
+void write_ast_string(Ast_Encoder *e, String str)
+{
+    if (!str.start)
+        write_varint(&e->out, 0);
+    else if (e->str.start && str.len == e->str.len && gb_memcompare(str.start, e->str.start, str.len) == 0)
+        write_varint(&e->out, 1);
+    else
+    {
+        Encoded_String encoded = encode_string(&e->table, str);
+        write_varint(&e->out, encoded.offset+2);
+        write_varint(&e->out, encoded.len);
+    }
+}
+
+void write_node_list(Ast_Encoder *e, gbArray(Node *) list)
+{
+    if (!list)
+    {
+        write_varint(&e->out, 0);
+        return;
+    }
+
+    write_varint(&e->out, gb_array_count(list)+1);
+    u32 prev = e->base;
+    for (int i = 0; i < gb_array_count(list); i++)
+    {
+        u32 index = list[i] ? *id_table_get(&e->node_indices, (uintptr)list[i]) : 0;
+        write_varint(&e->out, index ? zigzag((i32)(prev - index))+1 : 0);
+        if (index)
+            prev = index;
+    }
+}
+
+// Encodes `node` and what it points to, if they aren't yet, and returns its index
+u32 encode_node(Ast_Encoder *e, Node *node)
+{
+    if (!node)
+        return 0;
+
+    u32 *slot = id_table_get(&e->node_indices, (uintptr)node);
+    if (*slot == NODE_ENCODING)
+    {
+        e->cyclic = true;
+        return 0;
+    }
+    if (*slot)
+        return *slot;
+    *slot = NODE_ENCODING;
+
+    u32 mask = e->node_indices.mask;
+    Node encoded = *node;
+    visit_node_fields(&encoded, &e->children);
+    u32 index = ++e->node_count;
+    // The table may have grown while the children were encoded
+    if (e->node_indices.mask != mask)
+        slot = id_table_get(&e->node_indices, (uintptr)node);
+    *slot = index;
+
+    u32 flags = (encoded.no_print ? 1 : 0) | (encoded.is_opaque ? 2 : 0) | (encoded.index ? 4 : 0);
+    write_varint(&e->out, (u32)encoded.kind << 3 | flags);
+    if (encoded.index)
+        write_varint(&e->out, (u32)encoded.index);
+    e->base = index;
+    visit_node_fields(&encoded, &e->record);
+    return index;
+}
+
+void encode_child(void *data, Node **node)
+{
+    *node = (Node *)(uintptr)encode_node(data, *node);
+}
+
+void encode_children(void *data, gbArray(Node *) *list)
+{
+    for (int i = 0; *list && i < gb_array_count(*list); i++)
+        encode_node(data, (*list)[i]);
+}
+
+void skip_token_field(void *data, Token *token)          { gb_unused(data); gb_unused(token); }
+void skip_string_field(void *data, String *str)          { gb_unused(data); gb_unused(str); }
+void skip_tokens_field(void *data, gbArray(Token) *list) { gb_unused(data); gb_unused(list); }
+void skip_scalar_field(void *data, u32 *value)           { gb_unused(data); gb_unused(value); }
+
+void write_node_field(void *data, Node **node)
+{
+    Ast_Encoder *e = data;
+    u32 index = (u32)(uintptr)*node;
+    write_varint(&e->out, index ? e->base - index : 0);
+}
+
+void write_token_field(void *data, Token *token)
+{
+    write_token(data, *token);
+}
+
+void write_string_field(void *data, String *str)
+{
+    write_ast_string(data, *str);
+}
+
+void write_nodes_field(void *data, gbArray(Node *) *list)
+{
+    write_node_list(data, *list);
+}
+
+void write_tokens_field(void *data, gbArray(Token) *list)
+{
+    Ast_Encoder *e = data;
+    if (!*list)
+    {
+        write_varint(&e->out, 0);
+        return;
+    }
+
+    write_varint(&e->out, gb_array_count(*list)+1);
+    for (int i = 0; i < gb_array_count(*list); i++)
+        write_token(e, (*list)[i]);
+}
+
+void write_scalar_field(void *data, u32 *value)
+{
+    Ast_Encoder *e = data;
+    write_varint(&e->out, *value);
+}
+
+gbFileContents encode_ast_file(Ast_File file, Type_Log log, u32 node_count)
+{
+    Arena *arena = make_arena();
+    gbAllocator a = arena_allocator(arena);
+
+    Ast_Encoder e = {0};
+    token_encoder_init(&e.table, a);
+    id_table_init(&e.node_indices, a);
+    id_table_reserve(&e.node_indices, node_count);
+    writer_init(&e.out, 0, gb_heap_allocator());
+    e.children = (Node_Fields){&e, encode_child, skip_token_field, skip_string_field,
+                               encode_children, skip_tokens_field, skip_scalar_field};
+    e.record = (Node_Fields){&e, write_node_field, write_token_field, write_string_field,
+                             write_nodes_field, write_tokens_field, write_scalar_field};
+
+    gbArray(Node *) lists[] = {file.all_nodes, file.tpdefs, file.records, file.functions, file.variables,
+                               log.new_types, log.new_opaque_types, log.used, log.missed};
+    for (int i = 0; i < gb_count_of(lists); i++)
+        encode_children(&e, &lists[i]);
+    e.base = e.node_count+1;
+    for (int i = 0; i < gb_count_of(lists); i++)
+        write_node_list(&e, lists[i]);
+
+    for (int i = 0; i < gb_array_count(file.raw_defines); i++)
+    {
+        Define def = file.raw_defines[i];
+        write_ast_string(&e, def.key);
+        write_varint(&e.out, encode_ident(&e.table, def.ident));
+        write_varint(&e.out, (u32)(def.value.end+1 - def.value.start));
+        for (Token *tok = def.value.start; tok <= def.value.end; tok++)
+            write_token(&e, *tok);
+    }
+
+    gbFileContents data = {0};
+    if (!e.cyclic)
+    {
+        Ast_Header header = {0};
+        gb_memcopy(header.magic, AST_MAGIC, gb_size_of(header.magic));
+        header.version = AST_CACHE_VERSION;
+        header.node_count = e.node_count;
+        header.stream_size = e.out.len;
+        header.define_count = gb_array_count(file.raw_defines);
+
+        // The header is filled in last
+        Writer out;
+        writer_init(&out, 0, gb_heap_allocator());
+        writer_reserve(&out, gb_size_of(header) + e.out.len + 8);
+        write_section(&out, &header, gb_size_of(header));
+        write_section(&out, e.out.buffer, e.out.len);
+        write_token_tables(&e.table, &out, &header.tables);
+        gb_memcopy(out.buffer, &header, gb_size_of(header));
+        header.check = ast_check(out.buffer, out.len);
+        gb_memcopy(out.buffer, &header, gb_size_of(header));
+        data = (gbFileContents){gb_heap_allocator(), out.buffer, out.len};
+    }
+
+    gb_free(e.out.allocator, e.out.buffer);
+    destroy_arena(arena);
+    return data;
+}
+
+typedef struct Ast_Decoder
+{
+    gbAllocator allocator;
+    Token_Decoder table;
+    u8 *pos;
+    u8 *end;
+
+    Node_Fields fields;
+    Node *nodes;
+    u32 base; // Like `Ast_Encoder`, nodes from it back are decoded
+
+    // Like `Ast_Encoder`
+    i32 line;
+    i32 pp_line;
+    u32 origin;
+    String str;
+
+    b32 valid; // Cleared by anything out of range
+} Ast_Decoder;
+
+u32 read_varint(Ast_Decoder *d)
+{
+    u32 value = 0;
+    for (int shift = 0; shift < 35 && d->pos < d->end; shift += 7)
+    {
+        u8 byte = *d->pos++;
+        value |= (u32)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+    d->valid = false;
+    d->pos = d->end;
+    return 0;
+}
+
+// False if `count` records of at least a byte each can't fit in the rest of the stream
+b32 check_count(Ast_Decoder *d, u32 count)
+{
+    if (count > d->end - d->pos)
+        d->valid = false;
+    return d->valid;
+}
+
+Node *read_node(Ast_Decoder *d, u32 index)
+{
+    if (!index)
+        return 0;
+    if (index >= d->base)
+    {
+        d->valid = false;
+        return 0;
+    }
+    return &d->nodes[index-1];
+}
+
+Token read_token(Ast_Decoder *d)
+{
+    Token tok = {0};
+    tok.kind = read_varint(d);
+    tok.ident = read_varint(d);
+    u32 str = read_varint(d);
+    if (str > 1)
+    {
+        tok.str.start = (char *)(uintptr)(str-1);
+        tok.str.len = read_varint(d);
+    }
+    tok.loc.file = read_varint(d);
+    tok.loc.line = (i32)((u32)d->line + (u32)unzigzag(read_varint(d)));
+    tok.loc.column = (i32)read_varint(d);
+    tok.pp_loc.line = (i32)((u32)d->pp_line + (u32)unzigzag(read_varint(d)));
+    tok.pp_loc.column = (i32)read_varint(d);
+    tok.origin = d->origin + (u32)unzigzag(read_varint(d));
+    d->line = tok.loc.line;
+    d->pp_line = tok.pp_loc.line;
+    d->origin = tok.origin;
+
+    if (tok.kind >= Token_Count || !decode_token(&d->table, &tok) || (str == 1 && !tok.ident))
+    {
+        d->valid = false;
+        return (Token){0};
+    }
+    if (str == 1)
+        tok.str = interned_string(tok.ident);
+    d->str = tok.str;
+    return tok;
+}
+
+String read_ast_string(Ast_Decoder *d)
+{
+    u32 offset = read_varint(d);
+    if (offset < 2)
+        return offset ? d->str : (String){0};
+
+    Encoded_String encoded = {offset-2, read_varint(d)};
+    if ((u64)encoded.offset + encoded.len > d->table.string_size)
+    {
+        d->valid = false;
+        return (String){0};
+    }
+    return decode_string(&d->table, encoded);
+}
+
+gbArray(Node *) read_node_list(Ast_Decoder *d)
+{
+    u32 count = read_varint(d);
+    if (!count-- || !check_count(d, count))
+        return 0;
+
+    gbArray(Node *) nodes;
+    gb_array_init_reserve(nodes, d->allocator, count);
+    u32 prev = d->base;
+    for (u32 i = 0; i < count; i++)
+    {
+        u32 delta = read_varint(d);
+        u32 index = delta ? prev - (u32)unzigzag(delta-1) : 0;
+        gb_array_append(nodes, read_node(d, index));
+        if (index)
+            prev = index;
+    }
+    return nodes;
+}
+
+void read_node_field(void *data, Node **node)
+{
+    Ast_Decoder *d = data;
+    u32 back = read_varint(d);
+    *node = back ? read_node(d, back < d->base ? d->base - back : d->base) : 0;
+}
+
+void read_token_field(void *data, Token *token)
+{
+    *token = read_token(data);
+}
+
+void read_string_field(void *data, String *str)
+{
+    *str = read_ast_string(data);
+}
+
+void read_nodes_field(void *data, gbArray(Node *) *list)
+{
+    *list = read_node_list(data);
+}
+
+void read_tokens_field(void *data, gbArray(Token) *list)
+{
+    Ast_Decoder *d = data;
+    u32 count = read_varint(d);
+    if (!count-- || !check_count(d, count))
+    {
+        *list = 0;
+        return;
+    }
+
+    gb_array_init_reserve(*list, d->allocator, count);
+    for (u32 i = 0; i < count; i++)
+        gb_array_append(*list, read_token(d));
+}
+
+void read_scalar_field(void *data, u32 *value)
+{
+    *value = read_varint(data);
+}
+
+void save_ast_cache(gbFileContents encoded, u64 key, char const *path)
+{
+    Ast_Header *header = encoded.data;
+    header->key = key;
+    create_path_to_file(path);
+    write_file_if_changed(path, encoded.data, encoded.size);
+}
+
+b32 valid_names(gbArray(Node *) names)
+{
+    for (int i = 0; names && i < gb_array_count(names); i++)
+    {
+        if (!names[i] || names[i]->kind != NodeKind_Ident)
+            return false;
+    }
+    return true;
+}
+
+// The logs are read by `add_cached_types` and `type_log_holds`
+b32 valid_type_log(Type_Log log)
+{
+    if (!valid_names(log.new_types) || !valid_names(log.used) || !valid_names(log.missed))
+        return false;
+    for (int i = 0; log.new_opaque_types && i < gb_array_count(log.new_opaque_types); i++)
+    {
+        Node *type = log.new_opaque_types[i];
+        if (!type || !gb_is_between(type->kind, NodeKind_StructType, NodeKind_EnumType)
+            || !type->StructType.name || type->StructType.name->kind != NodeKind_Ident)
+            return false;
+    }
+    return true;
+}
+
+Ast_Cache *load_ast_cache(char const *path, u64 key)
+{
+    gbFileContents data = map_file_contents(gb_heap_allocator(), path);
+    if (!data.data)
+        return 0;
+
+    Ast_Header header = {0};
+    if (data.size >= gb_size_of(header))
+        gb_memcopy(&header, data.data, gb_size_of(header));
+    // Every node takes at least a byte of the stream
+    if (gb_memcompare(header.magic, AST_MAGIC, gb_size_of(header.magic)) != 0
+        || header.version != AST_CACHE_VERSION
+        || header.key != key
+        || header.node_count > header.stream_size
+        || header.check != ast_check(data.data, data.size))
+    {
+        unmap_file_contents(&data);
+        return 0;
+    }
+
+    Arena *arena = make_arena();
+    Ast_Decoder d = {0};
+    d.valid = true;
+    d.allocator = arena_allocator(arena);
+    isize offset = 0;
+    read_section(data, &offset, 1, gb_size_of(Ast_Header));
+    d.pos = read_section(data, &offset, header.stream_size, 1);
+    d.end = d.pos + header.stream_size;
+    if (!d.pos || !token_decoder_init(&d.table, data, &offset, header.tables, d.allocator))
+    {
+        destroy_arena(arena);
+        unmap_file_contents(&data);
+        return 0;
+    }
+
+    d.fields = (Node_Fields){&d, read_node_field, read_token_field, read_string_field,
+                             read_nodes_field, read_tokens_field, read_scalar_field};
+    d.nodes = gb_alloc_array(d.allocator, Node, header.node_count);
+    gb_zero_array(d.nodes, header.node_count);
+    for (u32 i = 0; d.valid && i < header.node_count; i++)
+    {
+        u32 head = read_varint(&d);
+        Node *node = &d.nodes[i];
+        node->kind = head >> 3;
+        // Invalid nodes are kept, they stand for what's left out like the count of `a[]`
+        if (node->kind >= NodeKind_Count)
+            d.valid = false;
+        node->no_print = (head & 1) != 0;
+        node->is_opaque = (head & 2) != 0;
+        node->index = head & 4 ? (i32)read_varint(&d) : 0;
+        d.base = i+1;
+        visit_node_fields(node, &d.fields);
+    }
+
+    Ast_Cache *cache = gb_alloc_item(d.allocator, Ast_Cache);
+    gb_zero_item(cache);
+    cache->arena = arena;
+    cache->data = data;
+
+    d.base = header.node_count+1;
+    Ast_File *file = &cache->file;
+    file->all_nodes = read_node_list(&d);
+    file->tpdefs = read_node_list(&d);
+    file->records = read_node_list(&d);
+    file->functions = read_node_list(&d);
+    file->variables = read_node_list(&d);
+    gb_array_init(file->defines, d.allocator);
+    cache->log.new_types = read_node_list(&d);
+    cache->log.new_opaque_types = read_node_list(&d);
+    cache->log.used = read_node_list(&d);
+    cache->log.missed = read_node_list(&d);
+
+    // Values have an EOF token on each side, since the parser may look one
+    // token past the end of a run
+    gb_array_init_reserve(file->raw_defines, d.allocator, gb_min(header.define_count, header.stream_size));
+    for (u32 i = 0; d.valid && i < header.define_count; i++)
+    {
+        Define def = {0};
+        def.in_use = true;
+        def.key = read_ast_string(&d);
+        u32 ident = read_varint(&d);
+        def.ident = ident < d.table.ident_count ? d.table.idents[ident] : 0;
+        u32 count = read_varint(&d);
+        if (ident >= d.table.ident_count || !check_count(&d, count))
+        {
+            d.valid = false;
+            break;
+        }
+
+        Token *values = gb_alloc_array(d.allocator, Token, count+2);
+        values[0] = (Token){.kind=Token_EOF};
+        for (u32 j = 1; j <= count; j++)
+            values[j] = read_token(&d);
+        values[count+1] = (Token){.kind=Token_EOF};
+        def.value = (Token_Run){values+1, values+1, values+count};
+        gb_array_append(file->raw_defines, def);
+    }
+
+    if (!d.valid || d.pos != d.end || !valid_type_log(cache->log))
+    {
+        destroy_arena(arena);
+        unmap_file_contents(&data);
+        return 0;
+    }
+    return cache;
+}
+
+void destroy_ast_cache(Ast_Cache *cache)
+{
+    gbFileContents data = cache->data;
+    destroy_arena(cache->arena);
+    unmap_file_contents(&data);
+}
+
+void add_cached_types(Ast_Cache *cache, map_t type_table, map_t opaque_types)
+{
+    for (int i = 0; cache->log.new_types && i < gb_array_count(cache->log.new_types); i++)
+    {
+        Token name = cache->log.new_types[i]->Ident.token;
+        hashmap_put_hashed(type_table, ident_string(name), ident_hash(name), 0);
+    }
+    for (int i = 0; cache->log.new_opaque_types && i < gb_array_count(cache->log.new_opaque_types); i++)
+    {
+        Node *type = cache->log.new_opaque_types[i];
+        Token name = type->StructType.name->Ident.token;
+        hashmap_put_hashed(opaque_types, ident_string(name), ident_hash(name), type);
+    }
+}
@@ -9,6 +9,11 @@
 #include "print.h"
 #include "types.h"
 #include "hashmap.h"
+#include "include_cache.h"
+#include "file_map.h"
+#include "build_cache.h"
+#include "pp_snapshot.h"
+#include "ast_cache.h"
 
 map_t init_type_table(gbAllocator a)
 {
@@ -17,14 +22,445 @@ map_t init_type_table(gbAllocator a)
     return type_table;
 }
 
-void bind_generate(Config *conf, gbArray(Bind_Task) tasks)
+typedef struct Bind_Result
+{
+    Ast_File file;
+    gbFileContents contents;
+
+    // The AST references tokens and strings owned by the preprocessor,
+    // so both are kept alive until the package has been printed
+    Preprocessor *pp;
+    Arena *ast_arena;
+    // Instead of both, when the parse was loaded from the cache directory
+    Ast_Cache *ast_cache;
+
+    gbArray(Include_File *) includes;
+    gbArray(String) missing; // See `Preprocessor.missing`
+
+    // Per-task tables, only used when running with multiple jobs
+    map_t type_table;
+    map_t opaque_types;
+    // Of the parse or the cached one, when logged, see `bind_merge_tasks`
+    Type_Log log;
+    b32 reparsed; // Its parallel parse didn't hold, so it isn't loaded again
+} Bind_Result;
+
+typedef struct Bind_Pool
+{
+    Config *conf;
+    gbArray(Bind_Task) tasks;
+    gbArray(String) system_includes;
+    // Per task, the state after its pre-includes if it has been preprocessed
+    // already, see `make_pp_snapshots`
+    PP_Snapshot **snapshots;
+    // Set with --cache-dir. With --ast-cache, parses of unchanged tasks are
+    // loaded from it too.
+    Build_Cache *cache;
+
+    // Shared tables, used directly by tasks run in order
+    map_t type_table;
+    map_t opaque_types;
+
+    Bind_Result *results;
+    gbAtomic32 next_task;
+    b32 parallel;
+} Bind_Pool;
+
+String task_root_dir(Bind_Task task)
+{
+    if (task.root_dir.start)
+        return task.root_dir;
+    return dir_from_path(task.input_filename);
+}
+
+// One file per set of pre-includes, so a snapshot made under another
+// configuration replaces the last one instead of piling up. The key is
+// inside, see `load_pp_snapshot`.
+void pp_snapshot_path(Config *conf, String root_dir, gbArray(String) pre_includes, char *path, isize size)
+{
+    u64 name = hashmap_hash(root_dir);
+    for (int i = 0; i < gb_array_count(pre_includes); i++)
+        name = hash_combine(name, hashmap_hash(pre_includes[i]));
+    gb_snprintf(path, size, "%.*s%c%llx.snapshot",
+                LIT(conf->cache_directory), GB_PATH_SEPARATOR, (unsigned long long)name);
+}
+
+// Preprocesses the pre-includes of every task once per distinct set.
+// A set only used by one task is left to that task, unless it can be kept
+// in the cache directory for the next run.
+PP_Snapshot **make_pp_snapshots(Config *conf, gbArray(Bind_Task) tasks, gbArray(String) system_includes,
+                                gbArray(PP_Snapshot *) *unique)
+{
+    gbAllocator a = gb_heap_allocator();
+    isize count = gb_array_count(tasks);
+    u64 *keys = gb_alloc_array(a, u64, count);
+    char **paths = gb_alloc_array(a, char *, count);
+    gb_zero_array(paths, count);
+    map_t uses = hashmap_new(a); // {key:use count}
+    b32 any = false;
+    for (isize t = 0; t < count; t++)
+    {
+        String root_dir = task_root_dir(tasks[t]);
+        gbArray(String) pre_includes = pp_pre_includes(&conf->pp_conf, root_dir, tasks[t].input_filename);
+        keys[t] = 0;
+        if (!pre_includes || gb_array_count(pre_includes) == 0)
+            continue;
+        keys[t] = pp_snapshot_key(&conf->pp_conf, system_includes, root_dir, pre_includes);
+        if (conf->cache_directory.len)
+        {
+            char path[1024];
+            pp_snapshot_path(conf, root_dir, pre_includes, path, gb_size_of(path));
+            paths[t] = gb_alloc_str(a, path);
+        }
+
+        String key = {(char *)&keys[t], gb_size_of(u64)};
+        uintptr used = 0;
+        hashmap_get(uses, key, (void **)&used);
+        hashmap_put(uses, key, (void *)(used+1));
+        if (used+1 > 1 || conf->cache_directory.len)
+            any = true;
+    }
+
+    PP_Snapshot **snapshots = 0;
+    if (any)
+    {
+        snapshots = gb_alloc_array(a, PP_Snapshot *, count);
+        gb_zero_array(snapshots, count);
+    }
+    map_t made = hashmap_new(a); // {key:PP_Snapshot *}, 0 if it couldn't be made
+    for (isize t = 0; any && t < count; t++)
+    {
+        if (!keys[t])
+            continue;
+        String key = {(char *)&keys[t], gb_size_of(u64)};
+        uintptr used = 0;
+        hashmap_get(uses, key, (void **)&used);
+        if (used < 2 && !conf->cache_directory.len)
+            continue;
+        if (hashmap_get(made, key, (void **)&snapshots[t]) == MAP_OK)
+            continue;
+
+        if (paths[t])
+            snapshots[t] = load_pp_snapshot(paths[t], keys[t]);
+        if (!snapshots[t])
+        {
+            snapshots[t] = make_pp_snapshot(keys[t], task_root_dir(tasks[t]), tasks[t].input_filename,
+                                            &conf->pp_conf, system_includes);
+            if (snapshots[t] && paths[t])
+            {
+                create_path_to_file(paths[t]);
+                save_pp_snapshot(snapshots[t], paths[t]);
+            }
+        }
+        if (snapshots[t])
+            gb_array_append(*unique, snapshots[t]);
+        hashmap_put(made, key, snapshots[t]);
+    }
+
+    hashmap_free(made);
+    hashmap_free(uses);
+    for (isize t = 0; t < count; t++)
+    {
+        if (paths[t])
+            gb_free(a, paths[t]);
+    }
+    gb_free(a, paths);
+    gb_free(a, keys);
+    return snapshots;
+}
+
+// One file per task, named after its output, so a new parse replaces the last
+// one instead of piling up. The closure is the key inside, see `load_ast_cache`.
+void ast_cache_path(Config *conf, Bind_Task task, char *path, isize size)
+{
+    gb_snprintf(path, size, "%.*s%c%llx.ast", LIT(conf->cache_directory), GB_PATH_SEPARATOR,
+                (unsigned long long)hashmap_hash(task.output_filename));
+}
+
+// Takes the parse of an unchanged task from the cache directory, with the
+// includes and missing paths the manifest recorded for it. Parsing only looks
+// up which names are types, so in order, the parse has to hold for the types
+// of the tasks before. Out of order, that is checked by `bind_merge_tasks`.
+b32 bind_load_task(Bind_Pool *pool, int t, b32 in_order)
+{
+    Bind_Result *result = &pool->results[t];
+    u64 closure = pool->cache && pool->cache->tasks ? pool->cache->tasks[t].closure : 0;
+    if (!closure || !pool->conf->ast_cache || pool->conf->dump_pp_directory.len || result->reparsed)
+        return false;
+
+    char path[1024];
+    ast_cache_path(pool->conf, pool->tasks[t], path, gb_size_of(path));
+    Ast_Cache *cache = load_ast_cache(path, closure);
+    if (!cache)
+        return false;
+    if (in_order && !type_log_holds(cache->log, result->type_table))
+    {
+        destroy_ast_cache(cache);
+        return false;
+    }
+
+    add_cached_types(cache, result->type_table, result->opaque_types);
+    result->ast_cache = cache;
+    result->file = cache->file;
+    result->log = cache->log;
+
+    gbArray(Include_File) includes = pool->cache->tasks[t].includes;
+    gb_array_init_reserve(result->includes, gb_heap_allocator(), gb_array_count(includes));
+    for (int i = 0; i < gb_array_count(includes); i++)
+        gb_array_append(result->includes, &includes[i]);
+    result->missing = pool->cache->tasks[t].missing;
+    return true;
+}
+
+// In order, against the shared tables, else against tables of its own
+void bind_run_task(Bind_Pool *pool, int t, b32 in_order)
 {
     gbAllocator a = gb_heap_allocator();
+    Bind_Task task = pool->tasks[t];
+    Bind_Result *result = &pool->results[t];
+
+    char *filename = make_cstring(a, task.input_filename);
+    gbFileContents fc = map_file_contents(a, filename);
+    if (!fc.data)
+    {
+        if (gb_file_exists(filename))
+            gb_printf_err("\x1b[31mERROR:\x1b[0m File '%.*s' is empty\n", LIT(task.input_filename));
+        else
+            gb_printf_err("\x1b[31mERROR:\x1b[0m Failed to open file \'%.*s\'\n", LIT(task.input_filename));
+        gb_free(a, filename);
+        gb_exit(1);
+    }
+    // gb_free(a, filename);
+    // The input is hashed for the build cache even when its parse is loaded
+    result->contents = fc;
+
+    if (in_order)
+    {
+        result->type_table = pool->type_table;
+        result->opaque_types = pool->opaque_types;
+    }
+    else
+    {
+        result->type_table = init_type_table(a);
+        result->opaque_types = hashmap_new(a);
+    }
+
+    if (bind_load_task(pool, t, in_order))
+    {
+        result->file.filename = filename;
+        result->file.output_filename = make_cstring(a, task.output_filename);
+        return;
+    }
+
+    Tokenizer tokenizer = make_tokenizer(fc, task.input_filename);
+    gbArray(Token) tokens;
+    gb_array_init(tokens, a);
+    Token token;
+    for (;;)
+    {
+        token = get_token(&tokenizer);
+        if (token.kind != Token_Invalid)
+            gb_array_append(tokens, token);
+        if (token.kind == Token_EOF)
+            break;
+    }
+
+    String root_dir = task_root_dir(task);
+    PP_Snapshot *prefix = pool->snapshots ? pool->snapshots[t] : 0;
+    Preprocessor *pp = make_preprocessor(tokens, root_dir, task.input_filename, &pool->conf->pp_conf, prefix);
+    pp->system_includes = pool->system_includes;
+    run_pp(pp);
+
+    gbArray(Define) defines = pp_dump_defines(pp, task.input_filename);
+
+    gb_array_append(pp->output, (Token){.kind=Token_EOF});
+    if (pool->conf->dump_pp_directory.len)
+    {
+        // Named after the input, relative to the input directory if there is one
+        String name = string_slice(task.input_filename, str_last_occurence(task.input_filename, GB_PATH_SEPARATOR)+1, -1);
+        if (task.root_dir.len && has_prefix(task.input_filename, task.root_dir))
+            name = string_slice(task.input_filename, task.root_dir.len+1, -1);
+        char pp_filename[1024];
+        gb_snprintf(pp_filename, gb_size_of(pp_filename), "%.*s%c%.*s.pp",
+                    LIT(pool->conf->dump_pp_directory), GB_PATH_SEPARATOR, LIT(name));
+        pp_print(pp, pp_filename);
+    }
+
+    result->pp = pp;
+    result->includes = pp->includes;
+    result->missing = pp->missing;
+    result->ast_arena = make_arena();
+
+    Parser parser = make_parser(arena_allocator(result->ast_arena));
+    parser.type_table = result->type_table;
+    parser.opaque_types = result->opaque_types;
+    b32 save_ast = pool->cache && pool->conf->ast_cache;
+    if (save_ast || !in_order)
+        parser_log_types(&parser, arena_allocator(result->ast_arena));
+    parser.start = parser.curr = pp->output;
+    parser.end = parser.start + gb_array_count(pp->output)-1;
+    parse_file(&parser);
+    parser.file.raw_defines = defines;
+    result->log = parser.log;
+    if (save_ast)
+    {
+        // Saved right away, so the encodings of every task aren't kept until the end
+        gbFileContents encoded = encode_ast_file(parser.file, parser.log, parser.node_count);
+        if (encoded.data)
+        {
+            u64 closure = build_cache_closure(pool->cache, task.input_filename, fc, pp->includes, pp->missing);
+            char path[1024];
+            ast_cache_path(pool->conf, task, path, gb_size_of(path));
+            save_ast_cache(encoded, closure, path);
+            gb_file_free_contents(&encoded);
+        }
+    }
+
+    parser.file.filename = filename;
+    parser.file.output_filename = make_cstring(a, task.output_filename);
+    result->file = parser.file;
+}
+
+// A path in a Makefile rule, with the characters make treats specially escaped
+void write_make_path(Writer *out, String path)
+{
+    for (int i = 0; i < path.len; i++)
+    {
+        char c = path.start[i];
+        if (c == ' ' || c == '#')
+            writer_write(out, "\\", 1);
+        else if (c == '$')
+            writer_write(out, "$", 1);
+        writer_write(out, &c, 1);
+    }
+}
 
-    gbFileContents fc = {0};
+// `output: input includes... libraries...`, followed by an empty rule for every
+// header and library, so make doesn't fail once one of them is removed
+void write_dependencies(Writer *out, Bind_Task task, gbArray(Include_File *) includes, gbArray(Lib) libs)
+{
+    write_make_path(out, task.output_filename);
+    writer_printf(out, ": ");
+    write_make_path(out, task.input_filename);
+    for (int i = 0; i < gb_array_count(includes); i++)
+    {
+        writer_printf(out, " \\\n  ");
+        write_make_path(out, includes[i]->path);
+    }
+    for (int i = 0; libs && i < gb_array_count(libs); i++)
+    {
+        writer_printf(out, " \\\n  ");
+        write_make_path(out, libs[i].path);
+    }
+    writer_printf(out, "\n\n");
+
+    for (int i = 0; i < gb_array_count(includes); i++)
+    {
+        write_make_path(out, includes[i]->path);
+        writer_printf(out, ":\n\n");
+    }
+    for (int i = 0; libs && i < gb_array_count(libs); i++)
+    {
+        write_make_path(out, libs[i].path);
+        writer_printf(out, ":\n\n");
+    }
+}
+
+void depfile_path(Bind_Task task, char *path, isize size)
+{
+    gb_snprintf(path, size, "%.*s.d", LIT(task.output_filename));
+}
+
+void write_depfiles(Config *conf, gbArray(Bind_Task) tasks, Bind_Result *results, gbArray(Lib) libs)
+{
+    Arena *arena = make_arena();
+    gbAllocator a = arena_allocator(arena);
+
+    Writer all = {0};
+    writer_init(&all, 0, a);
+    for (int t = 0; t < gb_array_count(tasks); t++)
+    {
+        gbArray(Include_File *) includes = results[t].includes;
+        if (conf->depfile.len)
+            write_dependencies(&all, tasks[t], includes, libs);
+        if (conf->depfile_per_output)
+        {
+            Writer out = {0};
+            writer_init(&out, 0, a);
+            write_dependencies(&out, tasks[t], includes, libs);
+
+            char path[1024];
+            depfile_path(tasks[t], path, gb_size_of(path));
+            write_file_if_changed(path, out.buffer, out.len);
+        }
+    }
+    if (conf->depfile.len)
+        write_file_if_changed(make_cstring(a, conf->depfile), all.buffer, all.len);
+
+    destroy_arena(arena);
+}
+
+GB_THREAD_PROC(bind_worker_proc)
+{
+    Bind_Pool *pool = (Bind_Pool *)thread->user_data;
+    for (;;)
+    {
+        i32 t = gb_atomic32_fetch_add(&pool->next_task, 1);
+        if (t >= gb_array_count(pool->tasks))
+            break;
+        bind_run_task(pool, t, false);
+    }
+    return 0;
+}
+
+void bind_release_task(Bind_Result *result)
+{
+    if (result->ast_cache)
+    {
+        destroy_ast_cache(result->ast_cache);
+        gb_array_free(result->includes);
+    }
+    else
+    {
+        destroy_arena(result->ast_arena);
+        destroy_preprocessor(result->pp);
+    }
+    unmap_file_contents(&result->contents);
+}
+
+// Tasks run in parallel are parsed against only the types they declare.
+// Their tables are merged in task order, and a task whose parse doesn't hold
+// for the types of the tasks before it is parsed again against them, so the
+// parses are the ones running in order gives. Returns how many were.
+int bind_merge_tasks(Bind_Pool *pool)
+{
+    int reparsed = 0;
+    for (int t = 0; t < gb_array_count(pool->tasks); t++)
+    {
+        Bind_Result *result = &pool->results[t];
+        b32 holds = type_log_holds(result->log, pool->type_table);
+        if (holds)
+        {
+            // Later tasks win like they would in order
+            hashmap_merge(pool->type_table, result->type_table);
+            hashmap_merge(pool->opaque_types, result->opaque_types);
+        }
+        hashmap_free(result->type_table);
+        hashmap_free(result->opaque_types);
+        if (holds)
+            continue;
+
+        bind_release_task(result);
+        *result = (Bind_Result){.reparsed = true};
+        bind_run_task(pool, t, true);
+        reparsed++;
+    }
+    return reparsed;
+}
 
-    gbArray(gbFileContents) files_to_free = 0;
-    gb_array_init(files_to_free, a);
+void bind_generate(Config *conf, gbArray(Bind_Task) tasks)
+{
+    gbAllocator a = gb_heap_allocator();
 
     Package package = {0};
     gb_array_init(package.files, a);
@@ -35,74 +471,88 @@ void bind_generate(Config *conf, gbArray(Bind_Task) tasks)
     map_t opaque_types = hashmap_new(a);
     gb_printf("GETTING SYSTEM INCLUDES\n");
     System_Directories system_dirs = get_system_includes(a);
-    package.libs = get_library_info(system_dirs, conf->bind_conf.libraries);
-    gb_printf("STARTING PREPROCESS/PARSE...\n");
-    for (int t = 0; t < gb_array_count(tasks); t++)
-    {
-        Bind_Task task = tasks[t];
 
-        char *filename = make_cstring(a, task.input_filename);
-        gbFile f = {0};
-        fc = gb_file_read_contents(a, true, filename);
-        if (!fc.data)
-        {
-            if (gb_file_exists(filename))
-                gb_printf_err("\x1b[31mERROR:\x1b[0m File '%.*s' is empty\n", LIT(task.input_filename));
-            else
-                gb_printf_err("\x1b[31mERROR:\x1b[0m Failed to open file \'%.*s\'\n", LIT(task.input_filename));
-            gb_free(a, filename);
-            gb_exit(1);
-        }
-        // gb_free(a, filename);
-
-        Tokenizer tokenizer = make_tokenizer(fc, task.input_filename);
-        gbArray(Token) tokens;
-        gb_array_init(tokens, a);
-        Token token;
-        for (;;)
+    Build_Cache *cache = 0;
+    if (conf->cache_directory.len)
+    {
+        cache = make_build_cache(conf, system_dirs, tasks);
+        int fresh_tasks;
+        if (build_cache_up_to_date(cache, gb_array_count(tasks), &fresh_tasks))
         {
-            token = get_token(&tokenizer);
-            if (token.kind != Token_Invalid)
-                gb_array_append(tokens, token);
-            if (token.kind == Token_EOF)
-                break;
+            gb_printf("ALL %d FILES UP TO DATE, SKIPPING\n", fresh_tasks);
+            destroy_build_cache(cache);
+            return;
         }
+        gb_printf("%d OF %d FILES UP TO DATE\n", fresh_tasks, (int)gb_array_count(tasks));
+        build_cache_begin(cache);
+    }
 
-        String root_dir;
-        if (task.root_dir.start)
-            root_dir = task.root_dir;
-        else
-            root_dir = dir_from_path(task.input_filename);
-
-        Preprocessor *pp = make_preprocessor(tokens, root_dir, task.input_filename, &conf->pp_conf);
-        pp->system_includes = system_dirs.include;
-        run_pp(pp);
-
-        gbArray(Define) defines = pp_dump_defines(pp, task.input_filename);
+    gbArray(String) missing_libs;
+    package.libs = get_library_info(system_dirs, conf->bind_conf.libraries, &missing_libs);
+    gb_printf("STARTING PREPROCESS/PARSE...\n");
+    init_include_cache();
+    init_location_table();
+    init_keyword_table();
+    init_interner();
+    init_preprocessor();
 
-        gb_array_append(pp->output, (Token){.kind=Token_EOF});
-        pp_print(pp, "temp.pp");
+    Bind_Pool pool = {0};
+    pool.conf = conf;
+    pool.tasks = tasks;
+    pool.system_includes = system_dirs.include;
+    gbArray(PP_Snapshot *) snapshots;
+    gb_array_init(snapshots, a);
+    pool.snapshots = make_pp_snapshots(conf, tasks, system_dirs.include, &snapshots);
+    if (gb_array_count(snapshots))
+        gb_printf("REUSING %d PRE-INCLUDE SNAPSHOTS\n", (int)gb_array_count(snapshots));
+    pool.type_table = type_table;
+    pool.opaque_types = opaque_types;
+    pool.results = gb_alloc_array(a, Bind_Result, gb_array_count(tasks));
+    gb_zero_array(pool.results, gb_array_count(tasks));
 
-        Parser parser = make_parser();
-        parser.type_table = type_table;
-        parser.opaque_types = opaque_types;
-        parser.start = parser.curr = pp->output;
-        parser.end = parser.start + gb_array_count(pp->output)-1;
-        parse_file(&parser);
-        parser.file.raw_defines = defines;
+    int jobs = gb_min(conf->jobs, gb_array_count(tasks));
+    pool.parallel = jobs > 1;
+    pool.cache = cache;
 
-        parser.file.filename = filename;
-        parser.file.output_filename = make_cstring(a, task.output_filename);
-        gb_array_append(package.files, parser.file);
+    if (pool.parallel)
+    {
+        gbThread *threads = gb_alloc_array(a, gbThread, jobs);
+        for (int i = 0; i < jobs; i++)
+        {
+            gb_thread_init(&threads[i]);
+            gb_thread_start(&threads[i], bind_worker_proc, &pool);
+        }
+        for (int i = 0; i < jobs; i++)
+        {
+            gb_thread_join(&threads[i]);
+            gb_thread_destroy(&threads[i]);
+        }
+        gb_free(a, threads);
 
-        // destroy_preprocessor(pp);
-        // destroy_parser(parser);
+        int reparsed = bind_merge_tasks(&pool);
+        if (reparsed)
+            gb_printf("REPARSED %d FILES THAT USE TYPES OF THE FILES BEFORE THEM\n", reparsed);
+    }
+    else
+    {
+        for (int t = 0; t < gb_array_count(tasks); t++)
+            bind_run_task(&pool, t, true);
+    }
 
-        // gb_file_free_contents(&fc);
-        gb_array_append(files_to_free, fc);
+    int loaded = 0;
+    for (int t = 0; t < gb_array_count(tasks); t++)
+    {
+        gb_array_append(package.files, pool.results[t].file);
+        if (pool.results[t].ast_cache)
+            loaded++;
     }
+    if (loaded)
+        gb_printf("LOADED %d CACHED PARSES\n", loaded);
 
-    Parser parser = make_parser();
+    Arena *package_arena = make_arena();
+    gbAllocator package_alloc = arena_allocator(package_arena);
+
+    Parser parser = make_parser(package_alloc);
     parser.type_table = type_table;
     parser.opaque_types = opaque_types;
     for (int i = 0; i < gb_array_count(package.files); i++)
@@ -114,12 +564,50 @@ void bind_generate(Config *conf, gbArray(Bind_Task) tasks)
 
     gb_printf("----PREPROCESS/PARSE FINISHED.\n");
     gb_printf("STARTING RESOLVE\n");
-    Resolver resolver = make_resolver(package, &conf->bind_conf);
+    Resolver resolver = make_resolver(package, &conf->bind_conf, package_alloc);
     resolver.opaque_types = opaque_types;
     resolve_package(&resolver);
     gb_printf("----RESOLVE FINISHED\n");
     gb_printf("STARTING PRINT\n");
-    Printer printer = make_printer(resolver);
-    print_package(printer);
-    gb_printf("----PRINT FINISHED.\n");
+    Printer printer = make_printer(resolver, package_arena);
+    int unchanged = print_package(printer);
+    destroy_printer(printer);
+    gb_printf("----PRINT FINISHED. %d OF %d FILES UNCHANGED\n", unchanged, (int)gb_array_count(package.files));
+
+    if (conf->depfile.len || conf->depfile_per_output)
+        write_depfiles(conf, tasks, pool.results, package.libs);
+
+    if (cache)
+    {
+        build_cache_add_libs(cache, package.libs, missing_libs);
+        // Depfiles are outputs too, so a removed one is written again
+        if (conf->depfile.len)
+            build_cache_add_output(cache, conf->depfile);
+        for (int t = 0; t < gb_array_count(tasks); t++)
+        {
+            Bind_Result *result = &pool.results[t];
+            build_cache_add_task(cache, tasks[t], result->contents, result->includes, result->missing);
+            if (conf->depfile_per_output)
+            {
+                char path[1024];
+                depfile_path(tasks[t], path, gb_size_of(path));
+                build_cache_add_output(cache, make_string(path));
+            }
+        }
+        build_cache_end(cache);
+        destroy_build_cache(cache);
+    }
+
+    destroy_arena(package_arena);
+    for (int t = 0; t < gb_array_count(tasks); t++)
+        bind_release_task(&pool.results[t]);
+    gb_free(a, pool.results);
+    gb_array_free(missing_libs);
+
+    // Output tokens of every task may point into them
+    for (int i = 0; i < gb_array_count(snapshots); i++)
+        destroy_pp_snapshot(snapshots[i]);
+    gb_array_free(snapshots);
+    if (pool.snapshots)
+        gb_free(a, pool.snapshots);
 }
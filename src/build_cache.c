@@ -0,0 +1,315 @@
+#include "build_cache.h"
+#include "file_map.h"
+
+Build_Cache *make_build_cache(Config *conf, System_Directories system_dirs, gbArray(Bind_Task) tasks)
+{
+    Arena *arena = make_arena();
+    gbAllocator a = arena_allocator(arena);
+    Build_Cache *cache = gb_alloc_item(a, Build_Cache);
+    gb_zero_item(cache);
+    cache->arena = arena;
+    cache->allocator = a;
+    cache->checked = hashmap_new(a);
+
+    u64 key = hash_combine(hash_config(conf), BUILD_CACHE_VERSION);
+    for (int i = 0; i < gb_array_count(system_dirs.include); i++)
+        key = hash_combine(key, hashmap_hash(system_dirs.include[i]));
+    for (int i = 0; i < gb_array_count(system_dirs.lib); i++)
+        key = hash_combine(key, hashmap_hash(system_dirs.lib[i]));
+    for (int i = 0; i < gb_array_count(tasks); i++)
+    {
+        key = hash_combine(key, hashmap_hash(tasks[i].root_dir));
+        key = hash_combine(key, hashmap_hash(tasks[i].input_filename));
+        key = hash_combine(key, hashmap_hash(tasks[i].output_filename));
+    }
+    cache->key = key;
+
+    char path[1024];
+    gb_snprintf(path, gb_size_of(path), "%.*s%c%llx.cache",
+                LIT(conf->cache_directory), GB_PATH_SEPARATOR, (unsigned long long)key);
+    cache->manifest_path = gb_alloc_str(a, path);
+    return cache;
+}
+
+void destroy_build_cache(Build_Cache *cache)
+{
+    destroy_arena(cache->arena);
+}
+
+Cache_File cache_file(Build_Cache *cache, String path, u64 hash)
+{
+    Cache_File file = {0};
+    file.path = path;
+    file.hash = hash;
+
+    char *filename = make_cstring(cache->allocator, path);
+    file.mtime = gb_file_last_write_time(filename);
+    if (!cache->started || file.mtime >= cache->started)
+        file.mtime = 0;
+    return file;
+}
+
+// The file at `path` as this run first saw it
+Cache_File *checked_file(Build_Cache *cache, String path, char *filename)
+{
+    Cache_File *file;
+    if (hashmap_get(cache->checked, path, (void **)&file) != MAP_OK)
+    {
+        file = gb_alloc_item(cache->allocator, Cache_File);
+        gb_zero_item(file);
+        file->path = path;
+        file->missing = !gb_file_exists(filename);
+        if (!file->missing)
+            file->mtime = gb_file_last_write_time(filename);
+        hashmap_put(cache->checked, path, file);
+    }
+    return file;
+}
+
+// Whether a file still has the recorded contents, trusting an unchanged
+// timestamp and hashing it otherwise
+b32 file_unchanged(Build_Cache *cache, String path, u64 hash, gbFileTime mtime)
+{
+    char *filename = make_cstring(cache->allocator, path);
+    Cache_File *file = checked_file(cache, path, filename);
+    if (file->missing)
+        return false;
+    if (mtime && file->mtime == mtime)
+        return true;
+    if (!file->hashed)
+    {
+        gbFileContents fc = map_file_contents(gb_heap_allocator(), filename);
+        file->hash = hashmap_hash((String){(char *)fc.data, fc.size});
+        file->hashed = true;
+        unmap_file_contents(&fc);
+    }
+    return file->hash == hash;
+}
+
+String next_field(String *line)
+{
+    String field = *line;
+    for (field.len = 0; field.len < line->len && field.start[field.len] != ' '; field.len++);
+    *line = string_slice(*line, gb_min(field.len+1, line->len), -1);
+    return field;
+}
+
+u64 field_to_u64(String *line, i32 base)
+{
+    String field = next_field(line);
+    char buf[32] = {0};
+    gb_memcopy(buf, field.start, gb_min(field.len, gb_size_of(buf)-1));
+    return gb_str_to_u64(buf, 0, base);
+}
+
+// Lines of the manifest, the path always comes last:
+//     bind-odin-cache <version> <key>
+//     lib <hash> <mtime> <path>
+//     missing <path>                 a library path tried that didn't exist
+//     output <hash> <mtime> <path>   the --depfile
+//     task <closure> <input>
+//     file <hash> <mtime> <path>     the input, then its includes
+//     missing <path>                 an include path tried that didn't exist
+//     output <hash> <mtime> <path>   the output, then its .d with --depfiles
+b32 build_cache_up_to_date(Build_Cache *cache, int task_count, int *fresh_tasks)
+{
+    *fresh_tasks = 0;
+    gbFileContents fc = gb_file_read_contents(cache->allocator, false, cache->manifest_path);
+    if (!fc.data)
+        return false;
+
+    cache->tasks = gb_alloc_array(cache->allocator, Cache_Task, task_count);
+    gb_zero_array(cache->tasks, task_count);
+    cache->task_count = task_count;
+
+    String contents = {(char *)fc.data, fc.size};
+    b32 up_to_date = true;
+    b32 header = false;
+    int tasks = 0;
+    u64 closure = 0;
+    u64 expected_closure = 0;
+    Cache_Task *task = 0;
+    int task_files = 0;
+    while (contents.len > 0)
+    {
+        String line = contents;
+        for (line.len = 0; line.len < contents.len && line.start[line.len] != '\n'; line.len++);
+        contents = string_slice(contents, gb_min(line.len+1, contents.len), -1);
+        if (line.len && line.start[line.len-1] == '\r')
+            line.len--;
+
+        String kind = next_field(&line);
+        if (!header)
+        {
+            header = true;
+            if (cstring_cmp(kind, "bind-odin-cache") != 0
+                || field_to_u64(&line, 10) != BUILD_CACHE_VERSION
+                || field_to_u64(&line, 16) != cache->key)
+                return false;
+            continue;
+        }
+
+        if (cstring_cmp(kind, "task") == 0)
+        {
+            if (task && closure == expected_closure)
+            {
+                task->closure = closure;
+                (*fresh_tasks)++;
+            }
+            task = tasks < task_count ? &cache->tasks[tasks] : 0;
+            if (!task)
+                return false;
+            gb_array_init(task->includes, cache->allocator);
+            gb_array_init(task->missing, cache->allocator);
+            tasks++;
+            task_files = 0;
+            expected_closure = field_to_u64(&line, 16);
+            closure = cache->key;
+            continue;
+        }
+
+        if (cstring_cmp(kind, "missing") == 0)
+        {
+            b32 appeared = !checked_file(cache, line, make_cstring(cache->allocator, line))->missing;
+            if (!task)
+            {
+                if (appeared) up_to_date = false;
+                continue;
+            }
+            // A path that appeared since breaks the closure
+            closure = hash_combine(closure, hashmap_hash(line));
+            if (appeared)
+                closure = ~closure;
+            gb_array_append(task->missing, line);
+            continue;
+        }
+
+        u64 hash = field_to_u64(&line, 16);
+        gbFileTime mtime = field_to_u64(&line, 10);
+        b32 same = file_unchanged(cache, line, hash, mtime);
+
+        if (cstring_cmp(kind, "file") == 0)
+        {
+            // Only unchanged files have a known hash, any other breaks the closure
+            closure = hash_combine(closure, hashmap_hash(line));
+            closure = hash_combine(closure, same ? hash : ~hash);
+
+            // The first file of a task is its input
+            if (task && task_files++ > 0)
+            {
+                Include_File include = {0};
+                include.path = line;
+                include.hash = hash;
+                include.hashed = true;
+                gb_array_append(task->includes, include);
+            }
+        }
+        else if (cstring_cmp(kind, "lib") == 0 || cstring_cmp(kind, "output") == 0)
+        {
+            if (!same) up_to_date = false;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    if (task && closure == expected_closure)
+    {
+        task->closure = closure;
+        (*fresh_tasks)++;
+    }
+
+    return header && up_to_date && tasks == task_count && *fresh_tasks == task_count;
+}
+
+void build_cache_begin(Build_Cache *cache)
+{
+    char path[1024];
+    gb_snprintf(path, gb_size_of(path), "%s.tmp", cache->manifest_path);
+    cache->out_path = gb_alloc_str(cache->allocator, path);
+
+    create_path_to_file(cache->out_path);
+    cache->out_file = gb_alloc_item(cache->allocator, gbFile);
+    if (gb_file_create(cache->out_file, cache->out_path) != gbFileError_None)
+    {
+        gb_printf_err("\x1b[33mWarning:\x1b[0m Could not write cache manifest '%s'\n", cache->out_path);
+        cache->out_file = 0;
+        return;
+    }
+    cache->started = gb_file_last_write_time(cache->out_path);
+
+    cache->out = gb_alloc_item(cache->allocator, Writer);
+    writer_init(cache->out, cache->out_file, cache->allocator);
+    writer_printf(cache->out, "bind-odin-cache %d %llx\n", BUILD_CACHE_VERSION, (unsigned long long)cache->key);
+}
+
+void write_cache_file(Build_Cache *cache, char const *kind, Cache_File file)
+{
+    writer_printf(cache->out, "%s %llx %llu %.*s\n", kind,
+                  (unsigned long long)file.hash, (unsigned long long)file.mtime, LIT(file.path));
+}
+
+Cache_File hash_file_at(Build_Cache *cache, String path)
+{
+    char *filename = make_cstring(cache->allocator, path);
+    gbFileContents fc = map_file_contents(gb_heap_allocator(), filename);
+    Cache_File file = cache_file(cache, path, hashmap_hash((String){(char *)fc.data, fc.size}));
+    unmap_file_contents(&fc);
+    return file;
+}
+
+void build_cache_add_libs(Build_Cache *cache, gbArray(Lib) libs, gbArray(String) missing)
+{
+    if (!cache->out) return;
+    for (int i = 0; libs && i < gb_array_count(libs); i++)
+        write_cache_file(cache, "lib", hash_file_at(cache, libs[i].path));
+    for (int i = 0; missing && i < gb_array_count(missing); i++)
+        writer_printf(cache->out, "missing %.*s\n", LIT(missing[i]));
+}
+
+u64 build_cache_closure(Build_Cache *cache, String input_filename, gbFileContents input,
+                        gbArray(Include_File *) includes, gbArray(String) missing)
+{
+    u64 closure = cache->key;
+    closure = hash_combine(closure, hashmap_hash(input_filename));
+    closure = hash_combine(closure, hashmap_hash((String){(char *)input.data, input.size}));
+    for (isize i = 0; includes && i < gb_array_count(includes); i++)
+    {
+        closure = hash_combine(closure, hashmap_hash(includes[i]->path));
+        closure = hash_combine(closure, include_file_hash(includes[i]));
+    }
+    for (isize i = 0; missing && i < gb_array_count(missing); i++)
+        closure = hash_combine(closure, hashmap_hash(missing[i]));
+    return closure;
+}
+
+void build_cache_add_task(Build_Cache *cache, Bind_Task task, gbFileContents input,
+                          gbArray(Include_File *) includes, gbArray(String) missing)
+{
+    if (!cache->out) return;
+
+    u64 closure = build_cache_closure(cache, task.input_filename, input, includes, missing);
+    writer_printf(cache->out, "task %llx %.*s\n", (unsigned long long)closure, LIT(task.input_filename));
+    write_cache_file(cache, "file", cache_file(cache, task.input_filename, hashmap_hash((String){(char *)input.data, input.size})));
+    for (isize i = 0; i < gb_array_count(includes); i++)
+        write_cache_file(cache, "file", cache_file(cache, includes[i]->path, include_file_hash(includes[i])));
+    for (isize i = 0; missing && i < gb_array_count(missing); i++)
+        writer_printf(cache->out, "missing %.*s\n", LIT(missing[i]));
+    write_cache_file(cache, "output", hash_file_at(cache, task.output_filename));
+}
+
+void build_cache_add_output(Build_Cache *cache, String path)
+{
+    if (!cache->out) return;
+    write_cache_file(cache, "output", hash_file_at(cache, path));
+}
+
+void build_cache_end(Build_Cache *cache)
+{
+    if (!cache->out) return;
+    writer_flush(cache->out);
+    gb_file_close(cache->out_file);
+    if (!replace_file(cache->out_path, cache->manifest_path))
+        gb_printf_err("\x1b[33mWarning:\x1b[0m Could not write cache manifest '%s'\n", cache->manifest_path);
+    cache->out = 0;
+}
@@ -550,6 +550,12 @@ void print_config(Config *conf)
     if (conf->out_file.len)      gb_printf("output-file = \"%.*s\"\n", LIT(conf->out_file));
     if (conf->directory.len)     gb_printf("directory = \"%.*s\"\n", LIT(conf->directory));
     if (conf->out_directory.len) gb_printf("output-directory = \"%.*s\"\n", LIT(conf->out_directory));
+    if (conf->jobs > 1)          gb_printf("jobs = %d\n", conf->jobs);
+    if (conf->dump_pp_directory.len) gb_printf("dump-pp = \"%.*s\"\n", LIT(conf->dump_pp_directory));
+    if (conf->cache_directory.len)   gb_printf("cache-dir = \"%.*s\"\n", LIT(conf->cache_directory));
+    if (conf->ast_cache)             gb_printf("ast-cache = true\n");
+    if (conf->depfile.len)           gb_printf("depfile = \"%.*s\"\n", LIT(conf->depfile));
+    if (conf->depfile_per_output)    gb_printf("depfiles = true\n");
 
     PreprocessorConfig pp = conf->pp_conf;
     gb_printf("\n::/preprocess\n");
@@ -610,3 +616,86 @@ void print_config(Config *conf)
     }
     gb_printf("\n==================\n");
 }
+
+u64 hash_combine(u64 seed, u64 hash)
+{
+    return seed ^ (hash + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+// Entries are hashed in insertion order, which follows the config file
+gb_global u64 map_hash;
+
+int hash_string_entry(String key, any_t data)
+{
+    map_hash = hash_combine(map_hash, hashmap_hash(key));
+    map_hash = hash_combine(map_hash, hashmap_hash(*(String *)data));
+    return MAP_OK;
+}
+
+int hash_list_entry(String key, any_t data)
+{
+    gbArray(String) entry = (gbArray(String))data;
+    map_hash = hash_combine(map_hash, hashmap_hash(key));
+    for (int i = 0; i < gb_array_count(entry); i++)
+        map_hash = hash_combine(map_hash, hashmap_hash(entry[i]));
+    return MAP_OK;
+}
+
+u64 hash_list(u64 seed, gbArray(String) list)
+{
+    if (!list) return hash_combine(seed, 0);
+    seed = hash_combine(seed, gb_array_count(list));
+    for (int i = 0; i < gb_array_count(list); i++)
+        seed = hash_combine(seed, hashmap_hash(list[i]));
+    return seed;
+}
+
+u64 hash_map(u64 seed, map_t map, PFentry func)
+{
+    map_hash = 0;
+    if (map) hashmap_iterate_entries(map, func);
+    return hash_combine(seed, map_hash);
+}
+
+u64 hash_pp_config(PreprocessorConfig *pp)
+{
+    u64 h = 0;
+    h = hash_list(h, pp->include_dirs);
+    h = hash_map(h, pp->custom_symbols, hash_string_entry);
+    h = hash_combine(h, hashmap_hash(pp->whitelist));
+    h = hash_map(h, pp->pre_includes, hash_list_entry);
+    h = hash_combine(h, pp->shallow_include);
+    return h;
+}
+
+u64 hash_config(Config *conf)
+{
+    // Inputs and outputs are part of the tasks, the number of jobs changes nothing
+    u64 h = 0;
+    h = hash_combine(h, hashmap_hash(conf->dump_pp_directory));
+    h = hash_combine(h, hashmap_hash(conf->depfile));
+    h = hash_combine(h, conf->depfile_per_output);
+
+    h = hash_combine(h, hash_pp_config(&conf->pp_conf));
+
+    BindConfig bind = conf->bind_conf;
+    h = hash_combine(h, hashmap_hash(bind.package_name));
+    h = hash_list(h, bind.libraries);
+    h = hash_combine(h, hashmap_hash(bind.type_prefix));
+    h = hash_combine(h, hashmap_hash(bind.var_prefix));
+    h = hash_combine(h, hashmap_hash(bind.proc_prefix));
+    h = hash_combine(h, hashmap_hash(bind.const_prefix));
+    h = hash_combine(h, bind.type_case);
+    h = hash_combine(h, bind.var_case);
+    h = hash_combine(h, bind.proc_case);
+    h = hash_combine(h, bind.const_case);
+    h = hash_combine(h, bind.use_cstring);
+    h = hash_combine(h, bind.shallow_bind);
+    h = hash_combine(h, hashmap_hash(bind.whitelist));
+    h = hash_combine(h, bind.ordering);
+    h = hash_list(h, bind.custom_ordering);
+    h = hash_map(h, bind.custom_types, hash_string_entry);
+
+    h = hash_combine(h, conf->do_wrap);
+    return h;
+}
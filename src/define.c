@@ -3,39 +3,159 @@
 
 #include "signal.h"
 
-GB_TABLE_DEFINE(Define_Map, defines_, Define);
+#define DEFINES_INITIAL_SLOTS 64
 
-void add_define(Define_Map **defines, String name, Token_Run value, gbArray(Token_Run) params, isize line, String file)
+// Interned ids are mostly sequential, spread them over the slots
+gb_inline u32 define_slot(Define_Map *defines, u32 name)
 {
+    u32 h = name * 0x9e3779b9u;
+    return (h ^ (h >> 16)) & defines->mask;
+}
+
+void defines_init(Define_Map *defines, gbAllocator a)
+{
+    // Arrays and slots are allocated on first use, most macro expansions
+    // never add anything
+    gb_zero_item(defines);
+    defines->allocator = a;
+}
+
+void defines_destroy(Define_Map *defines)
+{
+    if (defines->entries)
+        gb_array_free(defines->entries);
+    if (defines->journal)
+        gb_array_free(defines->journal);
+    if (defines->slots)
+        gb_free(defines->allocator, defines->slots);
+    gb_zero_item(defines);
+}
+
+Define *defines_get(Define_Map *defines, u32 name)
+{
+    if (!defines->slots)
+        return 0;
+    for (u32 pos = define_slot(defines, name);; pos = (pos+1) & defines->mask)
+    {
+        u32 index = defines->slots[pos];
+        if (!index)
+            return 0;
+        if (defines->entries[index-1].ident == name)
+            return &defines->entries[index-1];
+    }
+}
+
+void defines_insert_slot(Define_Map *defines, u32 name, u32 index)
+{
+    u32 pos = define_slot(defines, name);
+    while (defines->slots[pos])
+        pos = (pos+1) & defines->mask;
+    defines->slots[pos] = index;
+}
+
+void defines_rehash(Define_Map *defines, u32 size)
+{
+    if (defines->slots)
+        gb_free(defines->allocator, defines->slots);
+    defines->slots = gb_alloc_array(defines->allocator, u32, size);
+    gb_zero_size(defines->slots, size*gb_size_of(u32));
+    defines->mask = size-1;
+    for (int i = 0; i < gb_array_count(defines->entries); i++)
+        defines_insert_slot(defines, defines->entries[i].ident, i+1);
+}
+
+void defines_set(Define_Map *defines, Define define)
+{
+    GB_ASSERT(define.ident);
+    Define *old = defines_get(defines, define.ident);
+    if (old)
+    {
+        if (defines->snapshots)
+        {
+            Define_Undo undo = {old - defines->entries, *old};
+            gb_array_append(defines->journal, undo);
+        }
+        *old = define;
+        return;
+    }
+
+    if (!defines->entries)
+        gb_array_init(defines->entries, defines->allocator);
+    isize count = gb_array_count(defines->entries);
+    if (!defines->slots)
+        defines_rehash(defines, DEFINES_INITIAL_SLOTS);
+    else if ((count+1)*2 > defines->mask+1)
+        defines_rehash(defines, (defines->mask+1)*2);
+
+    gb_array_append(defines->entries, define);
+    defines_insert_slot(defines, define.ident, (u32)count+1);
+}
+
+Define_Snapshot defines_snapshot(Define_Map *defines)
+{
+    if (!defines->journal)
+        gb_array_init(defines->journal, defines->allocator);
+    defines->snapshots++;
+
+    Define_Snapshot snapshot;
+    snapshot.entry_count = defines->entries ? gb_array_count(defines->entries) : 0;
+    snapshot.journal_count = gb_array_count(defines->journal);
+    return snapshot;
+}
+
+void defines_restore(Define_Map *defines, Define_Snapshot snapshot)
+{
+    GB_ASSERT(defines->snapshots > 0);
+
+    // Newest first, so an entry set twice gets its oldest value back
+    for (isize i = gb_array_count(defines->journal)-1; i >= snapshot.journal_count; i--)
+    {
+        Define_Undo undo = defines->journal[i];
+        defines->entries[undo.index] = undo.prev;
+    }
+    gb_array_resize(defines->journal, snapshot.journal_count);
+
+    if (defines->entries && gb_array_count(defines->entries) > snapshot.entry_count)
+    {
+        gb_array_resize(defines->entries, snapshot.entry_count);
+        defines_rehash(defines, defines->mask+1);
+    }
+    defines->snapshots--;
+}
+
+void add_define(Define_Map **defines, u32 name, Token_Run value, gbArray(Token_Run) params, isize line, String file)
+{
+    // The old value may still be restored from the journal, see `defines_restore`
     Define *old = get_define(*defines, name);
-    if (old && old->in_use)
+    if (old && old->in_use && !(*defines)->snapshots)
     {
         gb_free(gb_heap_allocator(), old->file.start);
         if (old->params)
             gb_array_free(old->params);
     }
-    Define define = {1, alloc_string(name), value, params, alloc_string(file), line};
-    defines_set(*defines, gb_crc64(name.start, name.len), define);
+    Define define = {1, interned_string(name), name, value, params, alloc_string(file), line};
+    defines_set(*defines, define);
 }
 
-void add_fake_define(Define_Map **defines, String name)
+void add_fake_define(Define_Map **defines, u32 name)
 {
     Define define = {0};
-    defines_set(*defines, gb_crc64(name.start, name.len), define);
+    define.key = interned_string(name);
+    define.ident = name;
+    defines_set(*defines, define);
 }
 
-void remove_define(Define_Map **defines, String name)
+void remove_define(Define_Map **defines, u32 name)
 {
     Define *old = get_define(*defines, name);
-    if (old && old->in_use)
+    if (old && old->in_use && !(*defines)->snapshots)
         gb_free(gb_heap_allocator(), old->file.start);
-    Define define = {0};
-    defines_set(*defines, gb_crc64(name.start, name.len), define);
+    add_fake_define(defines, name);
 }
 
-Define *get_define(Define_Map *defines, String name)
+Define *get_define(Define_Map *defines, u32 name)
 {
-    return defines_get(defines, gb_crc64(name.start, name.len));
+    return defines_get(defines, name);
 }
 
 #define _STRING(x) #x
@@ -47,168 +167,168 @@ void init_std_defines(Define_Map **defines)
     String global = make_string("GLOBAL");
     char *date = date_string(time_now);
     char *time = time_string(time_now);
-    add_define(defines, make_string("__DATE__"), make_token_run(date, Token_String), 0, 0, global);
-    add_define(defines, make_string("__TIME__"), make_token_run(time, Token_String), 0, 0, global);
+    add_define(defines, intern(make_string("__DATE__")), make_token_run(date, Token_String), 0, 0, global);
+    add_define(defines, intern(make_string("__TIME__")), make_token_run(time, Token_String), 0, 0, global);
     gb_free(gb_heap_allocator(), date);
     gb_free(gb_heap_allocator(), time);
 
-    add_define(defines, make_string("__STDC__"), make_token_run("1", Token_Integer), 0, 0, global);
-    add_define(defines, make_string("__STDC_HOSTED__"), make_token_run("1", Token_Integer), 0, 0, global);
-    add_define(defines, make_string("__STDC_VERSION__"), make_token_run(STRING(__STDC_VERSION__), Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__STDC__")), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__STDC_HOSTED__")), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__STDC_VERSION__")), make_token_run(STRING(__STDC_VERSION__), Token_Integer), 0, 0, global);
 
-    add_define(defines, make_string("__GNUC__"), make_token_run(STRING(__GNUC__), Token_Integer), 0, 0, global);
-    add_define(defines, make_string("__GNUC_MINOR__"), make_token_run(STRING(__GNUC_MINOR__), Token_Integer), 0, 0, global);
-    add_define(defines, make_string("__GNUC_PATCHLEVEL__"), make_token_run(STRING(GNUC_PATCHLEVEL__), Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__GNUC__")), make_token_run(STRING(__GNUC__), Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__GNUC_MINOR__")), make_token_run(STRING(__GNUC_MINOR__), Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__GNUC_PATCHLEVEL__")), make_token_run(STRING(GNUC_PATCHLEVEL__), Token_Integer), 0, 0, global);
 
 #if defined(__unix__)
-    add_define(defines, make_string("__unix__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__unix__")), make_token_run("1", Token_Integer), 0, 0, global);
 # if defined(__linux__)
-    add_define(defines, make_string("__linux__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__linux__")), make_token_run("1", Token_Integer), 0, 0, global);
 # elif defined(__FreeBSD__)
-    add_define(defines, make_string("__FreeBSD__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__FreeBSD__")), make_token_run("1", Token_Integer), 0, 0, global);
 # elif defined(__FreeBSD_Kernel__)
-    add_define(defines, make_string("__FreeBSD_Kernel__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__FreeBSD_Kernel__")), make_token_run("1", Token_Integer), 0, 0, global);
 # endif
 #endif
 
 #if defined(__APPLE__)
-    add_define(defines, make_string("__APPLE__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__APPLE__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__MACH__)
-    add_define(defines, make_string("__MACH__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__MACH__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 
 #if defined(_WIN32)
-    add_define(defines, make_string("_WIN32"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_WIN32")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(_WIN64)
-    add_define(defines, make_string("_WIN64"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_WIN64")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(_MSC_VER)
-    add_define(defines, make_string("_MSC_VER"), make_token_run(STRING(_MSC_VER), Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_MSC_VER")), make_token_run(STRING(_MSC_VER), Token_Integer), 0, 0, global);
 #endif
     /*
 #if defined(_MSC_EXTENSIONS)
-    add_define(defines, make_string("_MSC_EXTENSIONS"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_MSC_EXTENSIONS")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
     */
 #if defined(_MSVC_LANG)
-    add_define(defines, make_string("_MSVC_LANG"), make_token_run(STRING(_MSVC_LANG), Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_MSVC_LANG")), make_token_run(STRING(_MSVC_LANG), Token_Integer), 0, 0, global);
 #endif
 
     /*
      *  AMD64
      */
 #if defined(__x86_64__)
-    add_define(defines, make_string("__x86_64__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__x86_64__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__x86_64)
-    add_define(defines, make_string("__x86_64"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__x86_64")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(_AMD64_)
-    add_define(defines, make_string("_AMD64_"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_AMD64_")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__amd64__)
-    add_define(defines, make_string("__amd64__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__amd64__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(amd64)
-    add_define(defines, make_string("amd64"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("amd64")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__amd64)
-    add_define(defines, make_string("__amd64"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__amd64")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(_M_X64)
-    add_define(defines, make_string("_M_X64"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_M_X64")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(_M_AMD64)
-    add_define(defines, make_string("_M_AMD64"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_M_AMD64")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 
     /*
      *  ARM
      */
 #if defined(__arm__)
-    add_define(defines, make_string("__arm__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__arm__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__arm)
-    add_define(defines, make_string("__arm"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__arm")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__thumb__)
-    add_define(defines, make_string("__thumb__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__thumb__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__TARGET_ARCH_ARM)
-    add_define(defines, make_string("__TARGET_ARCH_ARM"), make_token_run(STRING(__TARGET_ARCH_ARM), Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__TARGET_ARCH_ARM")), make_token_run(STRING(__TARGET_ARCH_ARM), Token_Integer), 0, 0, global);
 #endif
 #if defined(__TARGET_ARCH_THUMB)
-    add_define(defines, make_string("__TARGET_ARCH_THUMB"), make_token_run(STRING(__TARGET_ARCH_THUMB), Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__TARGET_ARCH_THUMB")), make_token_run(STRING(__TARGET_ARCH_THUMB), Token_Integer), 0, 0, global);
 #endif
 #if defined(_ARM)
-    add_define(defines, make_string("_ARM"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_ARM")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(_M_ARM)
-    add_define(defines, make_string("_M_ARM"), make_token_run(STRING(_M_ARM), Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_M_ARM")), make_token_run(STRING(_M_ARM), Token_Integer), 0, 0, global);
 #endif
 #if defined(_M_ARMT)
-    add_define(defines, make_string("_M_ARMT"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_M_ARMT")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(_ARM_)
-    add_define(defines, make_string("_ARM_"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_ARM_")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
     // ARM64
 #if defined(_ARM64_)
-    add_define(defines, make_string("_ARM64_"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_ARM64_")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__aarch64__)
-    add_define(defines, make_string("__aarch64__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__aarch64__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(_M_ARM64)
-    add_define(defines, make_string("_X86_"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_X86_")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 
     /*
      *  Intel x86
      */
 #if defined(i386)
-    add_define(defines, make_string("i386"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("i386")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__i386)
-    add_define(defines, make_string("__i386"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__i386")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__i386__)
-    add_define(defines, make_string("__i386__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__i386__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__i486__)
-    add_define(defines, make_string("__i486__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__i486__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__i586__)
-    add_define(defines, make_string("__i586__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__i586__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__i686__)
-    add_define(defines, make_string("__i686__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__i686__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__IA32__)
-    add_define(defines, make_string("__IA32__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__IA32__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(_M_IX86)
-    add_define(defines, make_string("_M_IX86"), make_token_run(STRING(_M_IX86), Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_M_IX86")), make_token_run(STRING(_M_IX86), Token_Integer), 0, 0, global);
 #endif
 #if defined(__X86__)
-    add_define(defines, make_string("__X86__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__X86__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(_X86_)
-    add_define(defines, make_string("_X86_"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_X86_")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__THW_INTEL__)
-    add_define(defines, make_string("__THW_INTEL__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__THW_INTEL__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__I86__)
-    add_define(defines, make_string("__I86__"), make_token_run(STRING(__I86__), Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__I86__")), make_token_run(STRING(__I86__), Token_Integer), 0, 0, global);
 #endif
 #if defined(__INTEL__)
-    add_define(defines, make_string("__INTEL__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__INTEL__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__386)
-    add_define(defines, make_string("__386"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__386")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 
 
@@ -216,25 +336,25 @@ void init_std_defines(Define_Map **defines)
      *  Intel Itanium (IA-64)
      */
 #if defined(__ia64__)
-    add_define(defines, make_string("__ia64__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__ia64__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(_IA64)
-    add_define(defines, make_string("_IA64"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_IA64")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__IA64__)
-    add_define(defines, make_string("__IA64__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__IA64__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(_IA64_)
-    add_define(defines, make_string("_IA64_"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_IA64_")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__ia64)
-    add_define(defines, make_string("__ia64"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__ia64")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(_M_IA64)
-    add_define(defines, make_string("_M_IA64"), make_token_run(STRING(_M_IA64), Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_M_IA64")), make_token_run(STRING(_M_IA64), Token_Integer), 0, 0, global);
 #endif
 #if defined(__itanium__)
-    add_define(defines, make_string("__itanium__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__itanium__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 
     /*
@@ -242,29 +362,29 @@ void init_std_defines(Define_Map **defines)
      */
 
 #if defined(__64BIT__)
-    add_define(defines, make_string("__64BIT__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__64BIT__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__powerpc__)
-    add_define(defines, make_string("__powerpc__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__powerpc__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(_M_PPC)
-    add_define(defines, make_string("_M_PPC"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("_M_PPC")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__powerpc64__)
-    add_define(defines, make_string("__powerpc64__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__powerpc64__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__ppc64__)
-    add_define(defines, make_string("__ppc64__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__ppc64__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 
 #if defined(__MIPSEL__)
-    add_define(defines, make_string("__MIPSEL__"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__MIPSEL__")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__mips_isa_rev)
-    add_define(defines, make_string("__mips_isa_rev"), make_token_run("1", Token_Integer), 0, 0, global);
+    add_define(defines, intern(make_string("__mips_isa_rev")), make_token_run("1", Token_Integer), 0, 0, global);
 #endif
 #if defined(__USER_LABEL_PREFIX__)
-    add_define(defines, make_string("__USER_LABEL_PREFIX__"), make_token_run(STRING(__USER_LABEL_PREFIX__), Token_String), 0, 0, global);
+    add_define(defines, intern(make_string("__USER_LABEL_PREFIX__")), make_token_run(STRING(__USER_LABEL_PREFIX__), Token_String), 0, 0, global);
 #endif
 }
 #undef STRING
@@ -273,15 +393,15 @@ gbArray(Define) get_define_list(Define_Map *defines, String whitelist_dir, b32 s
 {
     gbArray(Define) list;
     gb_array_init(list, alloc);
-    for (int i = 0; i < gb_array_count(defines->entries); i++)
-        if (defines->entries[i].value.in_use &&                                   // Is in use
-            !defines->entries[i].value.params &&                                  // Is NOT function style
-            cstring_cmp(defines->entries[i].value.file, "GLOBAL") != 0 &&         // Is NOT a globally defined macro
-            !is_valid_ident(token_run_string(defines->entries[i].value.value)) && // Is NOT a valid ident
-            (!shallow || has_substring(defines->entries[i].value.file, whitelist_dir)) &&       // Is defined in a whitelisted directory
-            defines->entries[i].value.value.start)                                // Is NOT zero-length
+    for (int i = 0; defines->entries && i < gb_array_count(defines->entries); i++)
+        if (defines->entries[i].in_use &&                                           // Is in use
+            !defines->entries[i].params &&                                          // Is NOT function style
+            cstring_cmp(defines->entries[i].file, "GLOBAL") != 0 &&                 // Is NOT a globally defined macro
+            !is_valid_ident(token_run_string(defines->entries[i].value)) &&         // Is NOT a valid ident
+            (!shallow || has_substring(defines->entries[i].file, whitelist_dir)) && // Is defined in a whitelisted directory
+            defines->entries[i].value.start)                                        // Is NOT zero-length
     {
-        gb_array_append(list, defines->entries[i].value);
+        gb_array_append(list, defines->entries[i]);
     }
     return list;
 }
@@ -458,14 +458,14 @@ u64 _pp_expr_defined(Preprocessor *pp, Expr *expr)
 	if (expr->kind != ExprKind_Macro)
 		gb_printf_err("ERROR: Operand of 'defined' is not an identifer\n");
 
-	Define def = pp_get_define(pp, expr->Macro.name.str);
+	Define def = pp_get_define(pp, expr->Macro.name.ident);
 	return def.in_use;
 }
 
 Expr *_pp_eval_expression(Preprocessor *pp, Expr *expr);
 Expr *_pp_expand_macro_expr(Preprocessor *pp, Expr *expr)
 {
-	Define def = pp_get_define(pp, expr->Macro.name.str);
+	Define def = pp_get_define(pp, expr->Macro.name.ident);
 	if (!def.in_use)
 		return constant_expr(pp, 0, DEFAULT_TYPE, DEFAULT_FORMAT);
     //error(expr->Macro.name, "Macro '%.*s' is not defined", LIT(expr->Macro.name.str));
@@ -584,3 +584,284 @@ void free_expr(gbAllocator a, Expr *expr)
 {
 
 }
+
+// Directives evaluate their expression straight from the tokens, the same
+// way `_pp_eval_expression` would evaluate the tree, without building it.
+// The tree is kept for diagnostics.
+b32 pp_eval_unary(Token_Run *expr, Preprocessor *pp, Expr_Constant *res);
+Expr_Constant pp_eval_run(Token_Run *expr, Preprocessor *pp);
+
+Expr_Constant make_constant(u64 val, Constant_Type type, Constant_Format fmt)
+{
+    Expr_Constant res = {val, type, fmt};
+    return res;
+}
+
+Expr_Constant pp_eval_macro(Preprocessor *pp, Token name, Token_Run args)
+{
+    Define def = pp_get_define(pp, name.ident);
+    if (!def.in_use)
+        return make_constant(0, DEFAULT_TYPE, DEFAULT_FORMAT);
+
+    if (def.params)
+    {
+        if (!args.start)
+            gb_printf_err("ERROR: Macro '%.*s' requires arguments\n", LIT(name.str));
+        gbArray(Token) res = pp_do_sandboxed_macro(pp, &args, def, name);
+        Token_Run res_run = {res, res, res+gb_array_count(res)-1};
+        return pp_eval_run(&res_run, pp);
+    }
+    else if (def.value.start)
+    {
+        Token_Run value = def.value;
+        return pp_eval_run(&value, pp);
+    }
+    return make_constant(0, DEFAULT_TYPE, DEFAULT_FORMAT);
+}
+
+Token_Run pp_skip_macro_args(Token_Run *expr)
+{
+    Token_Run args = {0};
+    if (expr->curr <= expr->end && expr->curr->kind == Token_OpenParen)
+    {
+        args.start = args.curr = expr->curr;
+        int skip_parens = 0;
+        do
+        {
+            if      (expr->curr->kind == Token_OpenParen)  skip_parens++;
+            else if (expr->curr->kind == Token_CloseParen) skip_parens--;
+            advance_expr(expr);
+        } while (skip_parens > 0 && expr->curr <= expr->end);
+        args.end = expr->curr-1;
+    }
+    return args;
+}
+
+// Operand of `defined`, an identifier with any number of parentheses
+u64 pp_eval_defined(Token_Run *expr, Preprocessor *pp)
+{
+    int parens = 0;
+    while (expr->curr <= expr->end && expr->curr->kind == Token_OpenParen)
+    {
+        advance_expr(expr);
+        parens++;
+    }
+
+    u64 res = 0;
+    if (expr->curr <= expr->end
+        && (expr->curr->kind == Token_Ident
+            || gb_is_between(expr->curr->kind, Token__KeywordBegin, Token__KeywordEnd)))
+    {
+        Token name = advance_expr(expr);
+        pp_skip_macro_args(expr);
+        res = pp_get_define(pp, name.ident).in_use;
+    }
+    else
+        gb_printf_err("ERROR: Operand of 'defined' is not an identifer\n");
+
+    for (; parens > 0; parens--)
+    {
+        Token close = advance_expr(expr);
+        if (close.kind != Token_CloseParen)
+            syntax_error(close, "Expected ')', got '%.*s'", LIT(TokenKind_Strings[close.kind]));
+    }
+    return res;
+}
+
+b32 pp_eval_operand(Token_Run *expr, Preprocessor *pp, Expr_Constant *res)
+{
+    Constant_Type type = DEFAULT_TYPE;
+    Constant_Format fmt = DEFAULT_FORMAT;
+
+    if (expr->curr > expr->end)
+        return false;
+
+    switch (expr->curr->kind)
+    {
+        case Token_Integer: {
+            u64 val = str_to_int(int_string(expr->curr->str, &type, &fmt));
+            advance_expr(expr);
+            *res = make_constant(val, type, fmt);
+            return true;
+        }
+
+        case Token_Char: {
+            type.is_signed = false;
+            type.size = sizeof(char);
+            fmt.is_char = true;
+            u64 val = char_lit_val(expr->curr[0]);
+            advance_expr(expr);
+            *res = make_constant(val, type, fmt);
+            return true;
+        }
+
+        case Token_Wchar: {
+            type.is_signed = false;
+            type.size = sizeof(wchar_t);
+            fmt.is_char = true;
+            u64 val = char_lit_val(expr->curr[0]);
+            advance_expr(expr);
+            *res = make_constant(val, type, fmt);
+            return true;
+        }
+
+        case Token_String: {
+            advance_expr(expr);
+            gb_printf_err("ERROR: Invalid Expression type in pp_eval_expression\n");
+            *res = make_constant(0, DEFAULT_TYPE, DEFAULT_FORMAT);
+            return true;
+        }
+
+        case Token_OpenParen: {
+            advance_expr(expr);
+            *res = pp_eval_run(expr, pp);
+            Token close = advance_expr(expr);
+            if (close.kind != Token_CloseParen)
+                syntax_error(close, "Expected ')', got '%.*s'", LIT(TokenKind_Strings[close.kind]));
+            return true;
+        }
+
+        default: break;
+    }
+
+    // Keywords are evaluated like any other identifier
+    if (expr->curr->kind == Token_Ident ||
+        gb_is_between(expr->curr->kind, Token__KeywordBegin, Token__KeywordEnd))
+    {
+        Token name = advance_expr(expr);
+        Token_Run args = pp_skip_macro_args(expr);
+        *res = pp_eval_macro(pp, name, args);
+        return true;
+    }
+    return false;
+}
+
+b32 pp_eval_unary(Token_Run *expr, Preprocessor *pp, Expr_Constant *res)
+{
+    if (expr->curr > expr->end)
+        return false;
+
+    switch (expr->curr->kind)
+    {
+        case Token_Ident: {
+            if (expr->curr->ident != ident_defined)
+                break;
+            advance_expr(expr);
+            *res = make_constant(pp_eval_defined(expr, pp), DEFAULT_TYPE, DEFAULT_FORMAT);
+            return true;
+        }
+
+        case Token_And:
+        case Token_Add:
+        case Token_Sub:
+        case Token_Mul:
+        case Token_Not:
+        case Token_BitNot: {
+            Token op = advance_expr(expr);
+            Expr_Constant operand = {0};
+            pp_eval_unary(expr, pp, &operand);
+            u64 val;
+            switch (op.kind)
+            {
+                case Token_Not: val = !operand.val; break;
+                case Token_Sub: val = -(i64)operand.val; break;
+                default: val = 0; break;
+            }
+            *res = make_constant(val, DEFAULT_TYPE, DEFAULT_FORMAT);
+            return true;
+        }
+
+        default: break;
+    }
+
+    return pp_eval_operand(expr, pp, res);
+}
+
+Expr_Constant pp_eval_binary_op(TokenKind op, Expr_Constant lhs, Expr_Constant rhs)
+{
+    u64 res;
+    Constant_Type result_type = convert_int_types(&lhs.type, &rhs.type);
+
+    switch (op)
+    {
+        case Token_Add   : res = lhs.val +  rhs.val; break;
+        case Token_Sub   : res = lhs.val -  rhs.val; break;
+        case Token_Mul   : res = lhs.val *  rhs.val; break;
+        case Token_Quo   : res = lhs.val /  rhs.val; break;
+        case Token_Or    : res = lhs.val |  rhs.val; break;
+        case Token_And   : res = lhs.val &  rhs.val; break;
+        case Token_Shl   : res = lhs.val << rhs.val; break;
+        case Token_Shr   : res = lhs.val >> rhs.val; break;
+        case Token_Xor   : res = lhs.val ^  rhs.val; break;
+        case Token_CmpEq : res = lhs.val == rhs.val; break;
+        case Token_NotEq : res = lhs.val != rhs.val; break;
+        case Token_Lt    : res = !num_greater_eq(lhs, rhs); break;
+        case Token_Gt    : res =  num_greater_eq(lhs, rhs) && lhs.val != rhs.val; break;
+        case Token_LtEq  : res = !num_greater_eq(lhs, rhs) || lhs.val == rhs.val; break;
+        case Token_GtEq  : res =  num_greater_eq(lhs, rhs); break;
+        case Token_CmpAnd: res = lhs.val && rhs.val; break;
+        case Token_CmpOr : res = lhs.val || rhs.val; break;
+        default: res = 0;
+    }
+    return make_constant(res, result_type, DEFAULT_FORMAT);
+}
+
+Expr_Constant pp_eval_ternary(Token_Run *expr, Preprocessor *pp, Expr_Constant cond)
+{
+    Expr_Constant then = pp_eval_run(expr, pp);
+    Token colon = advance_expr(expr);
+    Expr_Constant els_ = pp_eval_run(expr, pp);
+
+    if (colon.kind != Token_Colon)
+        syntax_error(colon, "Expected ':', got '%.*s'", LIT(TokenKind_Strings[colon.kind]));
+
+    return cond.val ? then : els_;
+}
+
+// Precedence climbing, in the same order as `pp_parse_binary_expr`
+b32 pp_eval_binary(Token_Run *expr, Preprocessor *pp, int max_prec, Expr_Constant *res)
+{
+    if (!pp_eval_unary(expr, pp, res))
+        return false;
+    if (expr->curr > expr->end) return true;
+    for (int prec = pp_op_precedence(expr->curr->kind); prec >= max_prec; prec--)
+    {
+        while (expr->curr <= expr->end)
+        {
+            Token op = *expr->curr;
+            int op_prec = pp_op_precedence(op.kind);
+            if (op_prec != prec) break;
+            if (op_prec == 0) error(op, "Expected operator, got '%.*s'", LIT(TokenKind_Strings[expr->curr->kind]));
+            advance_expr(expr);
+
+            if (op.kind == Token_Question)
+            {
+                *res = pp_eval_ternary(expr, pp, *res);
+            }
+            else
+            {
+                Expr_Constant rhs;
+                if (!pp_eval_binary(expr, pp, prec +1, &rhs))
+                    syntax_error(op, "Expected expression after binary operator");
+                *res = pp_eval_binary_op(op.kind, *res, rhs);
+            }
+        }
+    }
+
+    return true;
+}
+
+Expr_Constant pp_eval_run(Token_Run *expr, Preprocessor *pp)
+{
+    if (expr->curr <= expr->end &&
+        (expr->curr->kind == Token_BackSlash || expr->curr->kind == Token_Comment))
+        advance_expr(expr);
+    Expr_Constant res = make_constant(0, DEFAULT_TYPE, DEFAULT_FORMAT);
+    pp_eval_binary(expr, pp, 0+1, &res);
+    return res;
+}
+
+u64 pp_eval_directive(Preprocessor *pp, Token_Run expr)
+{
+    return pp_eval_run(&expr, pp).val;
+}
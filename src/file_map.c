@@ -0,0 +1,95 @@
+#include "file_map.h"
+
+#if defined(GB_SYSTEM_WINDOWS)
+
+gbFileContents map_file_contents(gbAllocator fallback, char const *filepath)
+{
+    gbFileContents result = {0};
+
+    HANDLE file = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return result;
+
+    LARGE_INTEGER size;
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return result;
+    }
+    if (size.QuadPart % info.dwPageSize == 0)
+    {
+        CloseHandle(file);
+        return gb_file_read_contents(fallback, true, filepath);
+    }
+
+    // The view keeps the mapping alive, so both handles can go right away
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping)
+        return gb_file_read_contents(fallback, true, filepath);
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data)
+        return gb_file_read_contents(fallback, true, filepath);
+
+    result.data = data;
+    result.size = (isize)size.QuadPart;
+    return result;
+}
+
+void unmap_file_contents(gbFileContents *fc)
+{
+    if (fc->allocator.proc)
+        gb_file_free_contents(fc);
+    else if (fc->data)
+        UnmapViewOfFile(fc->data);
+    fc->data = NULL;
+    fc->size = 0;
+}
+
+#else
+
+gbFileContents map_file_contents(gbAllocator fallback, char const *filepath)
+{
+    gbFileContents result = {0};
+
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0)
+        return result;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return result;
+    }
+    // The kernel zero-fills the rest of the last page, which is the NUL
+    if (st.st_size % sysconf(_SC_PAGESIZE) == 0)
+    {
+        close(fd);
+        return gb_file_read_contents(fallback, true, filepath);
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return gb_file_read_contents(fallback, true, filepath);
+
+    result.data = data;
+    result.size = st.st_size;
+    return result;
+}
+
+void unmap_file_contents(gbFileContents *fc)
+{
+    if (fc->allocator.proc)
+        gb_file_free_contents(fc);
+    else if (fc->data)
+        munmap(fc->data, fc->size);
+    fc->data = NULL;
+    fc->size = 0;
+}
+
+#endif
@@ -0,0 +1,246 @@
+#include "include_cache.h"
+#include "file_map.h"
+
+Include_Cache include_cache = {0};
+
+void init_include_cache(void)
+{
+    if (include_cache.files)
+        return;
+    include_cache.allocator = gb_heap_allocator();
+    gb_mutex_init(&include_cache.mutex);
+    include_cache.files = hashmap_new(include_cache.allocator);
+    include_cache.missing = hashmap_new(include_cache.allocator);
+    include_cache.resolved = hashmap_new(include_cache.allocator);
+}
+
+isize skip_comments(gbArray(Token) tokens, isize i)
+{
+    while (i < gb_array_count(tokens) && tokens[i].kind == Token_Comment)
+        i++;
+    return i;
+}
+
+// Index of the directive name if tokens[i] is a '#' starting a line, otherwise -1
+isize directive_at(gbArray(Token) tokens, isize i)
+{
+    if (tokens[i].kind != Token_Hash || i+1 >= gb_array_count(tokens))
+        return -1;
+    if (i > 0 && tokens[i-1].loc.line == tokens[i].loc.line)
+        return -1;
+    return i+1;
+}
+
+// Detects the multiple-include idiom:
+//     #ifndef GUARD           or   #if !defined(GUARD)
+//     ...
+//     #endif
+// with nothing but comments outside of it, and without an #else/#elif for the
+// outer conditional. Once GUARD is defined, including the file again is a no-op.
+u32 find_include_guard(gbArray(Token) tokens)
+{
+    u32 none = 0;
+    isize count = gb_array_count(tokens);
+
+    isize i = skip_comments(tokens, 0);
+    if (i >= count) return none;
+    isize d = directive_at(tokens, i);
+    if (d < 0 || d+1 >= count) return none;
+
+    Token guard = {0};
+    isize line = tokens[d].loc.line;
+    i = d+1;
+    if (cstring_cmp(tokens[d].str, "ifndef") == 0)
+    {
+        guard = tokens[i++];
+    }
+    else if (tokens[d].kind == Token_if)
+    {
+        if (i+1 >= count || tokens[i].kind != Token_Not || cstring_cmp(tokens[i+1].str, "defined") != 0)
+            return none;
+        i += 2;
+        b32 paren = i < count && tokens[i].kind == Token_OpenParen;
+        if (paren) i++;
+        if (i >= count) return none;
+        guard = tokens[i++];
+        if (paren)
+        {
+            if (i >= count || tokens[i].kind != Token_CloseParen)
+                return none;
+            i++;
+        }
+    }
+    else
+    {
+        return none;
+    }
+    if (guard.kind != Token_Ident || guard.loc.line != line)
+        return none;
+    if (i < count && tokens[i].loc.line == line && tokens[i].kind != Token_Comment)
+        return none;
+
+    int depth = 1;
+    isize end_line = 0;
+    for (; i < count && depth > 0; i++)
+    {
+        d = directive_at(tokens, i);
+        if (d < 0)
+            continue;
+
+        String name = tokens[d].str;
+        if (cstring_cmp(name, "if") == 0 ||
+            cstring_cmp(name, "ifdef") == 0 ||
+            cstring_cmp(name, "ifndef") == 0)
+        {
+            depth++;
+        }
+        else if (cstring_cmp(name, "endif") == 0)
+        {
+            depth--;
+            end_line = tokens[d].loc.line;
+        }
+        else if (depth == 1 &&
+                 (cstring_cmp(name, "else") == 0 ||
+                  cstring_cmp(name, "elif") == 0))
+        {
+            return none;
+        }
+        i = d;
+    }
+    if (depth != 0)
+        return none;
+
+    // Only comments may follow the closing #endif
+    for (; i < count; i++)
+    {
+        if (tokens[i].kind != Token_Comment && tokens[i].loc.line != end_line)
+            return none;
+    }
+
+    return guard.ident;
+}
+
+u64 include_file_hash(Include_File *file)
+{
+    init_include_cache();
+
+    // Tasks may hash the same file at once
+    gb_mutex_lock(&include_cache.mutex);
+    if (!file->hashed)
+    {
+        file->hash = hashmap_hash((String){(char *)file->contents.data, file->contents.size});
+        file->hashed = true;
+    }
+    u64 hash = file->hash;
+    gb_mutex_unlock(&include_cache.mutex);
+    return hash;
+}
+
+Include_File *get_include_file(char *path)
+{
+    init_include_cache();
+
+    String key = make_string(path);
+    Include_File *file = 0;
+
+    gb_mutex_lock(&include_cache.mutex);
+    hashmap_get(include_cache.files, key, (void **)&file);
+    b32 missing = hashmap_exists(include_cache.missing, key);
+    gb_mutex_unlock(&include_cache.mutex);
+    if (file || missing)
+        return file;
+
+    gbAllocator a = include_cache.allocator;
+    gbFileContents fc = map_file_contents(a, path);
+    if (!fc.data)
+    {
+        gb_mutex_lock(&include_cache.mutex);
+        if (!hashmap_exists(include_cache.missing, key))
+            hashmap_put(include_cache.missing, make_string_alloc(a, path), 0);
+        gb_mutex_unlock(&include_cache.mutex);
+        return 0;
+    }
+
+    // Tokenize outside the lock, so other tasks aren't held up by big headers
+    Include_File *new_file = gb_alloc_item(a, Include_File);
+    new_file->path = make_string_alloc(a, path);
+    new_file->contents = fc;
+    gb_array_init(new_file->tokens, a);
+
+    Tokenizer tokenizer = make_tokenizer(fc, new_file->path);
+    new_file->file = tokenizer.file;
+    Token token;
+    while ((token = get_token(&tokenizer)).kind != Token_EOF)
+        gb_array_append(new_file->tokens, token);
+    new_file->guard = find_include_guard(new_file->tokens);
+    new_file->directives = index_directives(new_file->tokens, a);
+    new_file->hash = 0;
+    new_file->hashed = false;
+
+    gb_mutex_lock(&include_cache.mutex);
+    file = 0;
+    hashmap_get(include_cache.files, key, (void **)&file);
+    if (!file)
+    {
+        hashmap_put(include_cache.files, new_file->path, new_file);
+        file = new_file;
+    }
+    gb_mutex_unlock(&include_cache.mutex);
+
+    if (file != new_file)
+    {
+        // Another task got there first
+        gb_array_free(new_file->tokens);
+        gb_array_free(new_file->directives.conds);
+        unmap_file_contents(&new_file->contents);
+        gb_free(a, new_file->path.start);
+        gb_free(a, new_file);
+    }
+
+    return file;
+}
+
+// The include search only depends on the including directory for quoted
+// includes and #include_next, so angled includes share one entry per name.
+// Allocated with `a`, sized to fit the whole path.
+String make_include_key(gbAllocator a, String filename, String from_dir, b32 local_first, b32 next)
+{
+    String dir = (local_first || next) ? from_dir : (String){0};
+    isize len = 3 + dir.len + filename.len;
+    char *buf = gb_alloc(a, len+1);
+    gb_snprintf(buf, len+1, "%c%c%.*s|%.*s", local_first?'"':'<', next?'n':'-', LIT(dir), LIT(filename));
+    return (String){buf, len};
+}
+
+Resolved_Include *get_resolved_include(String key)
+{
+    init_include_cache();
+
+    Resolved_Include *resolved = 0;
+    gb_mutex_lock(&include_cache.mutex);
+    hashmap_get(include_cache.resolved, key, (void **)&resolved);
+    gb_mutex_unlock(&include_cache.mutex);
+    return resolved;
+}
+
+void put_resolved_include(String key, Include_File *file, gbArray(String) missing)
+{
+    init_include_cache();
+    gbAllocator a = include_cache.allocator;
+
+    gb_mutex_lock(&include_cache.mutex);
+    if (!hashmap_exists(include_cache.resolved, key))
+    {
+        Resolved_Include *resolved = gb_alloc_item(a, Resolved_Include);
+        resolved->file = file;
+        resolved->missing = 0;
+        if (missing && gb_array_count(missing))
+        {
+            gb_array_init_reserve(resolved->missing, a, gb_array_count(missing));
+            for (int i = 0; i < gb_array_count(missing); i++)
+                gb_array_append(resolved->missing, make_string_allocn(a, missing[i].start, missing[i].len));
+        }
+        hashmap_put(include_cache.resolved, make_string_allocn(a, key.start, key.len), resolved);
+    }
+    gb_mutex_unlock(&include_cache.mutex);
+}
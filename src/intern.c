@@ -0,0 +1,116 @@
+#include "intern.h"
+#include "hashmap.h"
+
+#define INTERN_INITIAL_SLOTS 1024
+
+// An id is the index of the entry in its shard, starting at 1, followed by
+// the shard number
+Intern_Shard intern_shards[INTERN_SHARDS] = {0};
+
+void init_interner(void)
+{
+    if (intern_shards[0].slots)
+        return;
+    gbAllocator a = gb_heap_allocator();
+    for (int i = 0; i < INTERN_SHARDS; i++)
+    {
+        Intern_Shard *shard = &intern_shards[i];
+        gb_mutex_init(&shard->mutex);
+        arena_init(&shard->strings, a, gb_kilobytes(16));
+        shard->slots = gb_alloc_array(a, u32, INTERN_INITIAL_SLOTS);
+        gb_zero_size(shard->slots, INTERN_INITIAL_SLOTS*gb_size_of(u32));
+        shard->mask = INTERN_INITIAL_SLOTS-1;
+        shard->count = 0;
+    }
+}
+
+gb_inline Interned *intern_entry(Intern_Shard *shard, u32 index)
+{
+    return &shard->entries[index / INTERN_CHUNK_SIZE][index % INTERN_CHUNK_SIZE];
+}
+
+void intern_grow(Intern_Shard *shard)
+{
+    gbAllocator a = gb_heap_allocator();
+    u32 size = (shard->mask+1) * 2;
+    u32 *slots = gb_alloc_array(a, u32, size);
+    gb_zero_size(slots, size*gb_size_of(u32));
+
+    for (u32 i = 0; i <= shard->mask; i++)
+    {
+        u32 id = shard->slots[i];
+        if (!id)
+            continue;
+        u32 pos = (u32)intern_entry(shard, id >> INTERN_SHARD_BITS)->hash & (size-1);
+        while (slots[pos])
+            pos = (pos+1) & (size-1);
+        slots[pos] = id;
+    }
+
+    gb_free(a, shard->slots);
+    shard->slots = slots;
+    shard->mask = size-1;
+}
+
+u32 intern(String str)
+{
+    return intern_hashed(str, hashmap_hash(str));
+}
+
+u32 intern_hashed(String str, u64 hash)
+{
+    init_interner();
+    u32 shard_index = (u32)(hash >> (64-INTERN_SHARD_BITS));
+    Intern_Shard *shard = &intern_shards[shard_index];
+
+    gb_mutex_lock(&shard->mutex);
+    u32 pos = (u32)hash & shard->mask;
+    for (;;)
+    {
+        u32 id = shard->slots[pos];
+        if (!id)
+            break;
+        Interned *e = intern_entry(shard, id >> INTERN_SHARD_BITS);
+        if (e->hash == hash && e->str.len == str.len
+            && gb_memcompare(e->str.start, str.start, str.len) == 0)
+        {
+            gb_mutex_unlock(&shard->mutex);
+            return id;
+        }
+        pos = (pos+1) & shard->mask;
+    }
+
+    u32 index = ++shard->count;
+    GB_ASSERT_MSG(index < INTERN_CHUNK_SIZE*INTERN_MAX_CHUNKS, "Too many identifiers");
+    Interned **chunk = &shard->entries[index / INTERN_CHUNK_SIZE];
+    if (!*chunk)
+        *chunk = gb_alloc_array(gb_heap_allocator(), Interned, INTERN_CHUNK_SIZE);
+
+    // NUL terminated, so spellings can be passed on as C strings
+    char *start = gb_alloc_align(arena_allocator(&shard->strings), str.len+1, 1);
+    gb_memcopy(start, str.start, str.len);
+    start[str.len] = 0;
+    (*chunk)[index % INTERN_CHUNK_SIZE] = (Interned){{start, str.len}, hash};
+
+    u32 id = (index << INTERN_SHARD_BITS) | shard_index;
+    shard->slots[pos] = id;
+    if (shard->count*2 > shard->mask)
+        intern_grow(shard);
+    gb_mutex_unlock(&shard->mutex);
+
+    return id;
+}
+
+String interned_string(u32 id)
+{
+    if (!id)
+        return (String){0};
+    return intern_entry(&intern_shards[id & (INTERN_SHARDS-1)], id >> INTERN_SHARD_BITS)->str;
+}
+
+u64 interned_hash(u32 id)
+{
+    if (!id)
+        return 0;
+    return intern_entry(&intern_shards[id & (INTERN_SHARDS-1)], id >> INTERN_SHARD_BITS)->hash;
+}
@@ -28,7 +28,15 @@ const char *HELP_TEXT =
 "  -I, --include <dir>               Add <dir> to the include path\n"
 "  -w, --whitelist <substring>       Create bindings for all included files whose paths contain <substring>\n"
 "  -l, --link <lib>                  Link bindings to <lib>\n"
-"  -P, --package <package>           Use <package> as the package name for the bindings\n";
+"  -P, --package <package>           Use <package> as the package name for the bindings\n"
+"  -j, --jobs <n>                    Preprocess and parse up to <n> files at once\n"
+"      --dump-pp <dir>               Write the preprocessed source of each file to <dir>\n"
+"      --cache-dir <dir>             Skip the run if no input has changed since the last run cached in <dir>,\n"
+"                                    and keep preprocessed pre-includes there for later runs\n"
+"      --ast-cache                   With --cache-dir, also keep the parse of each file there, so unchanged\n"
+"                                    files are loaded instead of preprocessed and parsed again\n"
+"      --depfile <path>              Write the headers each output depends on to <path>, in Makefile syntax\n"
+"      --depfiles                    Write the headers each output depends on next to it, as <output>.d\n";
 
 Config *init_options(int argc, char **argv, gbArray(Bind_Task) *out_tasks);
 void enable_console_colors();
@@ -150,6 +158,41 @@ Config *init_options(int argc, char **argv, gbArray(Bind_Task) *out_tasks)
 //             conf->bind_conf.lib_name = make_string(argv[i+1]);
             i++;
         }
+        else if ((gb_strcmp(argv[i], "-j") == 0 || gb_strcmp(argv[i], "--jobs") == 0) && i+1 < argc)
+        {
+            conf->jobs = str_to_int(make_string(argv[i+1]));
+            if (conf->jobs < 1)
+            {
+                gb_printf_err(
+                              "\x1b[31mERROR:\x1b[0m %s %s: Number of jobs must be at least 1\n",
+                              argv[i], argv[i+1]);
+                gb_exit(1);
+            }
+            i++;
+        }
+        else if (gb_strcmp(argv[i], "--dump-pp") == 0 && i+1 < argc)
+        {
+            conf->dump_pp_directory = make_string(argv[i+1]);
+            i++;
+        }
+        else if (gb_strcmp(argv[i], "--cache-dir") == 0 && i+1 < argc)
+        {
+            conf->cache_directory = make_string(argv[i+1]);
+            i++;
+        }
+        else if (gb_strcmp(argv[i], "--ast-cache") == 0)
+        {
+            conf->ast_cache = true;
+        }
+        else if (gb_strcmp(argv[i], "--depfile") == 0 && i+1 < argc)
+        {
+            conf->depfile = make_string(argv[i+1]);
+            i++;
+        }
+        else if (gb_strcmp(argv[i], "--depfiles") == 0)
+        {
+            conf->depfile_per_output = true;
+        }
         else if ((gb_strcmp(argv[i], "-w") == 0 || gb_strcmp(argv[i], "--whitelist") == 0) && i+1 < argc)
         {
             conf->pp_conf.whitelist = make_string(argv[i+1]);
@@ -279,6 +322,11 @@ Config *init_options(int argc, char **argv, gbArray(Bind_Task) *out_tasks)
         gb_printf_err("Output location must be a directory when supplying multiple inputs\n");
         gb_exit(1);
     }
+    else if (conf->ast_cache && !conf->cache_directory.len)
+    {
+        gb_printf_err("--ast-cache needs a cache directory, set with --cache-dir\n");
+        gb_exit(1);
+    }
 
     gbArray(Bind_Task) tasks;
     gb_array_init(tasks, a);
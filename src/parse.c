@@ -5,12 +5,13 @@
 
 #include <signal.h>
 
-Parser make_parser()
+Parser make_parser(gbAllocator alloc)
 {
     Parser p;
 
     p.node_index = 0;
-    p.alloc = gb_heap_allocator();
+    p.node_count = 0;
+    p.alloc = alloc;
 
     gb_array_init(p.file.all_nodes, p.alloc);
     gb_array_init(p.file.tpdefs,    p.alloc);
@@ -20,6 +21,11 @@ Parser make_parser()
 
     gb_array_init(p.file.defines,   p.alloc);
 
+    p.file.lib_decls = 0;
+
+    p.logged = 0;
+    p.log = (Type_Log){0};
+
     return p;
 }
 
@@ -34,10 +40,79 @@ void destroy_parser(Parser p)
     gb_array_free(p.file.variables);
 }
 
+#define LOGGED_DECLARED  ((void *)1)
+#define LOGGED_LOOKED_UP ((void *)2)
+
+void parser_log_types(Parser *p, gbAllocator a)
+{
+    p->logged = hashmap_new(a);
+    gb_array_init(p->log.new_types, a);
+    gb_array_init(p->log.new_opaque_types, a);
+    gb_array_init(p->log.used, a);
+    gb_array_init(p->log.missed, a);
+}
+
+b32 type_log_holds(Type_Log log, map_t type_table)
+{
+    for (int i = 0; log.used && i < gb_array_count(log.used); i++)
+    {
+        Token name = log.used[i]->Ident.token;
+        if (!hashmap_exists_hashed(type_table, ident_string(name), ident_hash(name)))
+            return false;
+    }
+    for (int i = 0; log.missed && i < gb_array_count(log.missed); i++)
+    {
+        Token name = log.missed[i]->Ident.token;
+        if (hashmap_exists_hashed(type_table, ident_string(name), ident_hash(name)))
+            return false;
+    }
+    return true;
+}
+
+void add_type(Parser *p, Node *name)
+{
+    Token tok = name->Ident.token;
+    if (p->logged)
+    {
+        void *logged = 0;
+        hashmap_get_hashed(p->logged, ident_string(tok), ident_hash(tok), &logged);
+        if (logged != LOGGED_DECLARED)
+        {
+            gb_array_append(p->log.new_types, name);
+            hashmap_put_hashed(p->logged, ident_string(tok), ident_hash(tok), LOGGED_DECLARED);
+        }
+    }
+    hashmap_put_hashed(p->type_table, ident_string(tok), ident_hash(tok), 0);
+}
+
+void add_opaque_type(Parser *p, Node *type)
+{
+    Token name = type->StructType.name->Ident.token;
+    hashmap_put_hashed(p->opaque_types, ident_string(name), ident_hash(name), type);
+    if (p->logged)
+        gb_array_append(p->log.new_opaque_types, type);
+}
+
+b32 is_type_name(Parser *p, Node *name)
+{
+    Token tok = name->Ident.token;
+    b32 is_type = hashmap_exists_hashed(p->type_table, ident_string(tok), ident_hash(tok));
+    if (p->logged && !hashmap_exists_hashed(p->logged, ident_string(tok), ident_hash(tok)))
+    {
+        if (is_type)
+            gb_array_append(p->log.used, name);
+        else
+            gb_array_append(p->log.missed, name);
+        hashmap_put_hashed(p->logged, ident_string(tok), ident_hash(tok), LOGGED_LOOKED_UP);
+    }
+    return is_type;
+}
+
 Node *_make_node(Parser *p, NodeKind k)
 {
     Node *n = gb_alloc_item(p->alloc, Node);
     n->kind = k;
+    p->node_count++;
 
     return n;
 }
@@ -239,7 +314,7 @@ Node *node_var_decl(Parser *p, Node *type, Node *name, VarDeclKind kind)
             || ti.base_type->kind == NodeKind_UnionType
             || ti.base_type->kind == NodeKind_EnumType)
         && ti.base_type->StructType.name)
-            hashmap_put(p->opaque_types, ti.base_type->StructType.name->Ident.token.str, ti.base_type);
+            add_opaque_type(p, ti.base_type);
 
     Node *node = make_node(p, VarDecl);
     node->VarDecl.type = type;
@@ -281,7 +356,7 @@ Node *node_function_decl(Parser *p, Node *type, Node *name, Node *body)
                 || ti.base_type->kind == NodeKind_UnionType
                 || ti.base_type->kind == NodeKind_EnumType)
             && ti.base_type->StructType.name)
-                hashmap_put(p->opaque_types, ti.base_type->StructType.name->Ident.token.str, ti.base_type);
+                add_opaque_type(p, ti.base_type);
     }
 
     Node *node = make_node(p, FunctionDecl);
@@ -787,7 +862,7 @@ Node *try_type_expr(Parser *p)
 
         case Token_Ident: {
             type = parse_ident(p);
-            if (!hashmap_exists(p->type_table, type->Ident.token.str))
+            if (!is_type_name(p, type))
             {
                 p->curr = reset;
                 return 0;
@@ -1235,7 +1310,7 @@ Node *parse_typedef(Parser *p)
     // Add to type table
     if (vars->kind == NodeKind_VarDecl)
     {
-        hashmap_put(p->type_table, vars->VarDecl.name->Ident.token.str, 0);
+        add_type(p, vars->VarDecl.name);
         gbArray(Node *) list;
         gb_array_init(list, p->alloc);
         gb_array_append(list, vars);
@@ -1244,7 +1319,7 @@ Node *parse_typedef(Parser *p)
     else
     {
         for (int i = 0; i < gb_array_count(vars->VarDeclList.list); i++)
-            hashmap_put(p->type_table, vars->VarDeclList.list[i]->VarDecl.name->Ident.token.str, 0);
+            add_type(p, vars->VarDeclList.list[i]->VarDecl.name);
     }
 
     while (p->curr->kind == Token_attribute)
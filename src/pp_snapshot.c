@@ -0,0 +1,444 @@
+#include "pp_snapshot.h"
+#include "file_map.h"
+#include "util.h"
+#include "writer.h"
+#include "config.h"
+#include "token_encoding.h"
+
+// Encoding, in native byte order. Everything is referred to by index or
+// offset, so loading is one read plus fixups:
+//     Snap_Header
+//     token tables                 see `token_encoding.h`
+//     Snap_Include   includes[]    the files the snapshot was made from
+//     Encoded_String missing[]     paths tried for them that didn't exist
+//     Token          tokens[]      output and macro tokens
+//     Snap_Define    defines[]
+//     Snap_Run       params[]
+//     Encoded_String pragma_onces[]
+// Runs are copied with an EOF token on each side, since the preprocessor
+// peeks one token past the ends of a run.
+#define SNAP_MAGIC "bindpps"
+
+typedef struct Snap_Header
+{
+    char magic[8];
+    u32 version;
+    u32 token_size;
+    u64 key;
+    // `hashmap_hash` of everything after it. Indices are range-checked on
+    // load, but a damaged token or define would still be used as is.
+    u64 check;
+    Token_Tables tables;
+
+    u32 include_count;
+    u32 missing_count;
+    u32 token_count;
+    u32 define_count;
+    u32 param_count;
+    u32 pragma_count;
+
+    u32 output_start;
+    u32 output_count;
+    i32 write_line;
+    i32 write_column;
+} Snap_Header;
+
+// See `Snap_Header.check`
+u64 snap_check(void const *data, isize size)
+{
+    isize start = gb_offset_of(Snap_Header, check) + gb_size_of(u64);
+    return hashmap_hash((String){(char *)data + start, size - start});
+}
+
+typedef struct Snap_Include
+{
+    Encoded_String path;
+    u64 hash;
+} Snap_Include;
+
+typedef struct Snap_Run
+{
+    i32 start; // -1 for a null run
+    i32 curr;
+    i32 end;
+} Snap_Run;
+
+typedef struct Snap_Define
+{
+    i64 line;
+    Encoded_String file;
+    u32 ident;
+    u32 in_use;
+    Snap_Run value;
+    i32 param_start;
+    i32 param_count; // -1 for an object-like macro
+    u32 pad;
+} Snap_Define;
+
+typedef struct Snap_Encoder
+{
+    Token_Encoder table;
+    gbArray(Token) tokens;
+    gbArray(Snap_Define) defines;
+    gbArray(Snap_Run) params;
+} Snap_Encoder;
+
+u64 pp_snapshot_key(PreprocessorConfig *conf, gbArray(String) system_includes, String root_dir, gbArray(String) pre_includes)
+{
+    u64 key = hash_combine(hash_pp_config(conf), PP_SNAPSHOT_VERSION);
+    for (int i = 0; system_includes && i < gb_array_count(system_includes); i++)
+        key = hash_combine(key, hashmap_hash(system_includes[i]));
+    key = hash_combine(key, hashmap_hash(root_dir));
+    for (int i = 0; i < gb_array_count(pre_includes); i++)
+        key = hash_combine(key, hashmap_hash(pre_includes[i]));
+    return key;
+}
+
+void snap_encode_token(Snap_Encoder *e, Token tok)
+{
+    gb_array_append(e->tokens, encode_token(&e->table, tok));
+}
+
+Snap_Run encode_run(Snap_Encoder *e, Token_Run run)
+{
+    if (!run.start)
+        return (Snap_Run){-1, -1, -1};
+
+    Token eof = {.kind=Token_EOF};
+    snap_encode_token(e, eof);
+    i32 start = gb_array_count(e->tokens);
+    for (Token *tok = run.start; tok <= run.end; tok++)
+        snap_encode_token(e, *tok);
+    snap_encode_token(e, eof);
+    return (Snap_Run){start, start + (i32)(run.curr - run.start), start + (i32)(run.end - run.start)};
+}
+
+// Encodes everything the pre-includes left in `pp`
+gbFileContents encode_pp_snapshot(Preprocessor *pp, u64 key, gbAllocator a)
+{
+    Snap_Encoder e = {0};
+    token_encoder_init(&e.table, a);
+    gb_array_init(e.tokens, a);
+    gb_array_init(e.defines, a);
+    gb_array_init(e.params, a);
+
+    gbArray(Snap_Include) includes;
+    gb_array_init(includes, a);
+    for (int i = 0; i < gb_array_count(pp->includes); i++)
+    {
+        Snap_Include include = {encode_string(&e.table, pp->includes[i]->path), include_file_hash(pp->includes[i])};
+        gb_array_append(includes, include);
+    }
+    gbArray(Encoded_String) missing;
+    gb_array_init(missing, a);
+    for (int i = 0; i < gb_array_count(pp->missing); i++)
+        gb_array_append(missing, encode_string(&e.table, pp->missing[i]));
+
+    Define_Map *defines = pp->defines;
+    for (int i = 0; defines->entries && i < gb_array_count(defines->entries); i++)
+    {
+        Define def = defines->entries[i];
+        Snap_Define d = {0};
+        d.line = def.line;
+        d.file = encode_string(&e.table, def.file);
+        d.ident = encode_ident(&e.table, def.ident);
+        d.in_use = def.in_use;
+        d.value = encode_run(&e, def.value);
+        d.param_count = -1;
+        if (def.params)
+        {
+            gbArray(Snap_Run) params;
+            gb_array_init(params, a);
+            for (int p = 0; p < gb_array_count(def.params); p++)
+                gb_array_append(params, encode_run(&e, def.params[p]));
+            d.param_start = gb_array_count(e.params);
+            d.param_count = gb_array_count(params);
+            encoded_appendv(e.params, params, gb_array_count(params));
+        }
+        gb_array_append(e.defines, d);
+    }
+
+    u32 output_start = gb_array_count(e.tokens);
+    for (int i = 0; i < gb_array_count(pp->output); i++)
+        snap_encode_token(&e, pp->output[i]);
+    u32 output_count = gb_array_count(e.tokens) - output_start;
+    snap_encode_token(&e, (Token){.kind=Token_EOF});
+
+    gbArray(Encoded_String) pragma_onces;
+    gb_array_init(pragma_onces, a);
+    // Every `#pragma once` file was included
+    for (int i = 0; i < gb_array_count(pp->includes); i++)
+    {
+        if (hashmap_exists(pp->pragma_onces, pp->includes[i]->path))
+            gb_array_append(pragma_onces, encode_string(&e.table, pp->includes[i]->path));
+    }
+
+    Snap_Header header = {0};
+    gb_memcopy(header.magic, SNAP_MAGIC, gb_size_of(header.magic));
+    header.version = PP_SNAPSHOT_VERSION;
+    header.token_size = gb_size_of(Token);
+    header.key = key;
+    header.include_count = gb_array_count(includes);
+    header.missing_count = gb_array_count(missing);
+    header.token_count = gb_array_count(e.tokens);
+    header.define_count = gb_array_count(e.defines);
+    header.param_count = gb_array_count(e.params);
+    header.pragma_count = gb_array_count(pragma_onces);
+    header.output_start = output_start;
+    header.output_count = output_count;
+    header.write_line = pp->write_line;
+    header.write_column = pp->write_column;
+
+    // The header goes first, but the table sizes are only known once written
+    Writer tables = {0};
+    writer_init(&tables, 0, a);
+    write_token_tables(&e.table, &tables, &header.tables);
+
+    Writer out = {0};
+    writer_init(&out, 0, gb_heap_allocator());
+    write_section(&out, &header, gb_size_of(header));
+    write_section(&out, tables.buffer, tables.len);
+    write_section(&out, includes, gb_array_count(includes)*gb_size_of(Snap_Include));
+    write_section(&out, missing, gb_array_count(missing)*gb_size_of(Encoded_String));
+    write_section(&out, e.tokens, gb_array_count(e.tokens)*gb_size_of(Token));
+    write_section(&out, e.defines, gb_array_count(e.defines)*gb_size_of(Snap_Define));
+    write_section(&out, e.params, gb_array_count(e.params)*gb_size_of(Snap_Run));
+    write_section(&out, pragma_onces, gb_array_count(pragma_onces)*gb_size_of(Encoded_String));
+    header.check = snap_check(out.buffer, out.len);
+    gb_memcopy(out.buffer, &header, gb_size_of(header));
+
+    gbFileContents data = {gb_heap_allocator(), out.buffer, out.len};
+    return data;
+}
+
+// False if `run` isn't one `encode_run` could have written, with its EOF
+// tokens inside the `token_count` tokens
+b32 decode_run(Token *tokens, u32 token_count, Snap_Run run, Token_Run *decoded)
+{
+    *decoded = (Token_Run){0};
+    if (run.start == -1 && run.curr == -1 && run.end == -1)
+        return true;
+    if (run.start < 1 || run.end < run.start-1 || (i64)run.end+1 >= token_count
+        || run.curr < run.start || run.curr > run.end+1)
+        return false;
+    *decoded = (Token_Run){tokens + run.start, tokens + run.curr, tokens + run.end};
+    return true;
+}
+
+// Decodes `data`, which the snapshot keeps. Unless `trusted`, the files it
+// was made from are checked first.
+PP_Snapshot *decode_pp_snapshot(gbFileContents data, u64 key, b32 trusted)
+{
+    if (data.size < gb_size_of(Snap_Header))
+        return 0;
+    Snap_Header header;
+    gb_memcopy(&header, data.data, gb_size_of(header));
+    if (gb_memcompare(header.magic, SNAP_MAGIC, gb_size_of(header.magic)) != 0
+        || header.version != PP_SNAPSHOT_VERSION
+        || header.token_size != gb_size_of(Token)
+        || header.key != key
+        || (!trusted && header.check != snap_check(data.data, data.size)))
+        return 0;
+
+    Arena *arena = make_arena();
+    gbAllocator a = arena_allocator(arena);
+    Token_Decoder d;
+    isize offset = 0;
+    read_section(data, &offset, 1, gb_size_of(Snap_Header));
+    b32 ok = token_decoder_init(&d, data, &offset, header.tables, a);
+    Snap_Include *includes = read_section(data, &offset, header.include_count, gb_size_of(Snap_Include));
+    Encoded_String *missing = read_section(data, &offset, header.missing_count, gb_size_of(Encoded_String));
+    Token *tokens          = read_section(data, &offset, header.token_count, gb_size_of(Token));
+    Snap_Define *defines   = read_section(data, &offset, header.define_count, gb_size_of(Snap_Define));
+    Snap_Run *params       = read_section(data, &offset, header.param_count, gb_size_of(Snap_Run));
+    Encoded_String *pragmas = read_section(data, &offset, header.pragma_count, gb_size_of(Encoded_String));
+    if (!ok || !includes || !missing || !tokens || !defines || !params || !pragmas
+        || (u64)header.output_start + header.output_count >= header.token_count)
+    {
+        destroy_arena(arena);
+        return 0;
+    }
+
+    for (u32 i = 0; !trusted && i < header.include_count; i++)
+    {
+        char *path = make_cstring(a, decode_string(&d, includes[i].path));
+        gbFileContents fc = map_file_contents(gb_heap_allocator(), path);
+        b32 same = fc.data && hashmap_hash((String){(char *)fc.data, fc.size}) == includes[i].hash;
+        unmap_file_contents(&fc);
+        if (!same)
+        {
+            destroy_arena(arena);
+            return 0;
+        }
+    }
+    for (u32 i = 0; !trusted && i < header.missing_count; i++)
+    {
+        if (gb_file_exists(make_cstring(a, decode_string(&d, missing[i]))))
+        {
+            destroy_arena(arena);
+            return 0;
+        }
+    }
+
+    PP_Snapshot *snapshot = gb_alloc_item(a, PP_Snapshot);
+    gb_zero_item(snapshot);
+    snapshot->key = key;
+    snapshot->arena = arena;
+    snapshot->data = data;
+    snapshot->write_line = header.write_line;
+    snapshot->write_column = header.write_column;
+
+    gb_array_init_reserve(snapshot->includes, a, header.include_count);
+    for (u32 i = 0; i < header.include_count; i++)
+    {
+        Include_File file = {0};
+        file.path = decode_string(&d, includes[i].path);
+        file.file = intern_file(file.path);
+        file.hash = includes[i].hash;
+        file.hashed = true;
+        gb_array_append(snapshot->includes, file);
+    }
+    gb_array_init_reserve(snapshot->missing, a, header.missing_count);
+    for (u32 i = 0; i < header.missing_count; i++)
+        gb_array_append(snapshot->missing, decode_string(&d, missing[i]));
+
+    Token *decoded = gb_alloc_array(a, Token, header.token_count);
+    for (u32 i = 0; i < header.token_count; i++)
+    {
+        decoded[i] = tokens[i];
+        if (!decode_token(&d, &decoded[i]))
+        {
+            destroy_arena(arena);
+            return 0;
+        }
+    }
+
+    gb_array_init_reserve(snapshot->defines, a, header.define_count);
+    for (u32 i = 0; i < header.define_count; i++)
+    {
+        Snap_Define sd = defines[i];
+        Define def = {0};
+        b32 valid = sd.ident < header.tables.ident_count
+                 && decode_run(decoded, header.token_count, sd.value, &def.value)
+                 && sd.param_count >= -1
+                 && (sd.param_count == -1
+                     || (sd.param_start >= 0 && (i64)sd.param_start + sd.param_count <= header.param_count));
+        if (valid && sd.param_count >= 0)
+        {
+            gb_array_init_reserve(def.params, a, sd.param_count);
+            for (i32 p = 0; valid && p < sd.param_count; p++)
+            {
+                Token_Run param;
+                valid = decode_run(decoded, header.token_count, params[sd.param_start+p], &param);
+                gb_array_append(def.params, param);
+            }
+        }
+        if (!valid)
+        {
+            destroy_arena(arena);
+            return 0;
+        }
+        def.in_use = sd.in_use;
+        def.ident = d.idents[sd.ident];
+        def.key = interned_string(def.ident);
+        def.file = decode_string(&d, sd.file);
+        def.line = sd.line;
+        gb_array_append(snapshot->defines, def);
+    }
+
+    snapshot->output = decoded + header.output_start;
+    snapshot->output_count = header.output_count;
+
+    gb_array_init_reserve(snapshot->pragma_onces, a, header.pragma_count);
+    for (u32 i = 0; i < header.pragma_count; i++)
+        gb_array_append(snapshot->pragma_onces, decode_string(&d, pragmas[i]));
+
+    return snapshot;
+}
+
+PP_Snapshot *make_pp_snapshot(u64 key, String root_dir, String filename, PreprocessorConfig *conf, gbArray(String) system_includes)
+{
+    // An empty file, so only the pre-includes are preprocessed
+    gbArray(Token) tokens;
+    gb_array_init(tokens, gb_heap_allocator());
+    gb_array_append(tokens, ((Token){.kind=Token_EOF}));
+
+    Preprocessor *pp = make_preprocessor(tokens, root_dir, filename, conf, 0);
+    pp->system_includes = system_includes;
+    run_pp(pp);
+
+    PP_Snapshot *snapshot = 0;
+    if (!pp->conditionals)
+    {
+        Arena *arena = make_arena();
+        gbFileContents data = encode_pp_snapshot(pp, key, arena_allocator(arena));
+        destroy_arena(arena);
+        snapshot = decode_pp_snapshot(data, key, true);
+    }
+    destroy_preprocessor(pp);
+    return snapshot;
+}
+
+PP_Snapshot *load_pp_snapshot(char const *path, u64 key)
+{
+    gbFileContents data = map_file_contents(gb_heap_allocator(), path);
+    if (!data.data)
+        return 0;
+    PP_Snapshot *snapshot = decode_pp_snapshot(data, key, false);
+    if (!snapshot)
+        unmap_file_contents(&data);
+    return snapshot;
+}
+
+void save_pp_snapshot(PP_Snapshot *snapshot, char const *path)
+{
+    write_file_if_changed(path, snapshot->data.data, snapshot->data.size);
+}
+
+void destroy_pp_snapshot(PP_Snapshot *snapshot)
+{
+    gbFileContents data = snapshot->data;
+    destroy_arena(snapshot->arena);
+    if (data.allocator.proc)
+        gb_free(data.allocator, data.data);
+    else
+        unmap_file_contents(&data);
+}
+
+void pp_restore_snapshot(Preprocessor *pp, PP_Snapshot *snapshot)
+{
+    for (int i = 0; i < gb_array_count(snapshot->defines); i++)
+    {
+        Define def = snapshot->defines[i];
+
+        // Keep this run's own builtins, like __DATE__
+        Define *builtin = defines_get(pp->defines, def.ident);
+        if (builtin && builtin->in_use && cstring_cmp(builtin->file, "GLOBAL") == 0
+            && def.in_use && cstring_cmp(def.file, "GLOBAL") == 0)
+            continue;
+
+        if (!def.in_use)
+        {
+            remove_define(&pp->defines, def.ident);
+            continue;
+        }
+        gbArray(Token_Run) params = 0;
+        if (def.params)
+        {
+            gb_array_init_reserve(params, pp->allocator, gb_array_count(def.params));
+            gb_array_appendv(params, def.params, gb_array_count(def.params));
+        }
+        add_define(&pp->defines, def.ident, def.value, params, def.line, def.file);
+    }
+
+    encoded_appendv(pp->output, snapshot->output, snapshot->output_count);
+    for (int i = 0; i < gb_array_count(snapshot->pragma_onces); i++)
+        hashmap_put(pp->pragma_onces, snapshot->pragma_onces[i], 0);
+    for (int i = 0; i < gb_array_count(snapshot->includes); i++)
+        pp_add_include(pp, &snapshot->includes[i]);
+    for (int i = 0; i < gb_array_count(snapshot->missing); i++)
+        pp_add_missing(pp, snapshot->missing[i]);
+
+    pp->write_line = snapshot->write_line;
+    pp->write_column = snapshot->write_column;
+}
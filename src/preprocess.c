@@ -2,6 +2,9 @@
 #include "util.h"
 #include "expression.h"
 #include "error.h"
+#include "include_cache.h"
+#include "pp_snapshot.h"
+#include "writer.h"
 
 #define peek_at(pp, n) (pp)->context->tokens.curr[n]
 #define peek(pp) peek_at(pp, 0)
@@ -60,15 +63,56 @@ void pp_retreat_n(Preprocessor *pp, int n)
 }
 void pp_retreat(Preprocessor *pp) { pp_retreat_n(pp, 1); }
 
+void pp_add_include(Preprocessor *pp, Include_File *file)
+{
+    if (hashmap_exists(pp->included, file->path))
+        return;
+    hashmap_put(pp->included, file->path, 0);
+    gb_array_append(pp->includes, file);
+}
+
+void pp_add_missing(Preprocessor *pp, String path)
+{
+    if (hashmap_exists(pp->missed, path))
+        return;
+    hashmap_put(pp->missed, path, 0);
+    gb_array_append(pp->missing, path);
+}
+
+// Looks for an include at `path`, adding it to `missing` and the
+// preprocessor's misses if it doesn't exist
+Include_File *pp_try_include(Preprocessor *pp, char *path, gbArray(String) *missing)
+{
+    Include_File *file = get_include_file(path);
+    if (!file)
+    {
+        String name = make_string_alloc(pp->allocator, path);
+        pp_add_missing(pp, name);
+        gb_array_append(*missing, name);
+    }
+    return file;
+}
+
 void pp_push_context(Preprocessor *pp, Token_Run run, PP_Context context, char *file_contents)
 {
-    PP_Context *new_head = gb_alloc_item(pp->allocator, PP_Context);
+    PP_Context *new_head = pp->free_contexts;
+    if (new_head)
+        pp->free_contexts = new_head->next;
+    else
+    {
+        new_head = gb_alloc_item(pp->allocator, PP_Context);
+        new_head->arg_storage = 0;
+    }
 
+    // Keep the node's own argument storage, `context` may be a copy of another one
+    gbArray(Macro_Arg) arg_storage = new_head->arg_storage;
     *new_head = context;
+    new_head->arg_storage = arg_storage;
     new_head->next = pp->context;
     new_head->tokens = run;
 
-    if (context.in_include && !context.in_macro)
+    // Cached include files are owned by the include cache
+    if (context.in_include && !context.in_macro && file_contents)
     {
         gb_array_append(pp->file_contents, file_contents);
         gb_array_append(pp->file_tokens, run.start);
@@ -82,24 +126,107 @@ void pp_pop_context(Preprocessor *pp)
     PP_Context *old = pp->context;
     pp->context = old->next;
 
-    if (old->in_macro)
-        defines_destroy(old->local_defines);
-
     pp->end_of_prev = old->tokens.end;
     pp->paste_next = false;
-    gb_free(pp->allocator, old);
+    old->next = pp->free_contexts;
+    pp->free_contexts = old;
+}
+
+// Names the preprocessor handles itself, see `init_preprocessor`
+u32 ident_LINE = 0;
+u32 ident_FILE = 0;
+u32 ident_VA_ARGS = 0;
+u32 ident_VA_OPT = 0;
+u32 ident_defined = 0;
+
+// `__VA_OPT__(x)` expands to x if the variadic arguments aren't empty
+Token_Run va_opt_set = {0};
+Token_Run va_opt_unset = {0};
+gbArray(Token_Run) va_opt_params = 0;
+
+void init_preprocessor(void)
+{
+    if (ident_LINE)
+        return;
+    ident_FILE = intern(make_string("__FILE__"));
+    ident_VA_ARGS = intern(make_string("__VA_ARGS__"));
+    ident_VA_OPT = intern(make_string("__VA_OPT__"));
+    ident_defined = intern(make_string("defined"));
+
+    va_opt_set = make_token_run("x", Token_Ident);
+    va_opt_unset = make_token_run("", Token_Ident);
+    gb_array_init(va_opt_params, gb_heap_allocator());
+    gb_array_append(va_opt_params, make_token_run("x", Token_Ident));
+
+    ident_LINE = intern(make_string("__LINE__"));
+}
+
+// Parameters are single identifiers, anything else never matches
+gb_inline u32 param_ident(Token_Run param)
+{
+    return param.start == param.end ? param.start->ident : 0;
+}
+
+gbArray(String) pp_pre_includes(PreprocessorConfig *conf, String root_dir, String filename)
+{
+    gbArray(String) include_files = 0;
+    if (conf->pre_includes)
+        hashmap_get(conf->pre_includes, string_slice(filename, root_dir.len+1, -1), (void **)&include_files);
+    return include_files;
+}
+
+void pp_push_pre_includes(Preprocessor *pp, String filename)
+{
+    gbArray(String) include_files = pp_pre_includes(pp->conf, pp->root_dir, filename);
+    if (!include_files)
+        return;
+    char path[512];
+    for (int i = 0; i < gb_array_count(include_files); i++)
+    {
+        gb_snprintf(path, 512, "%.*s%c%.*s", LIT(pp->root_dir), GB_PATH_SEPARATOR, LIT(include_files[i]));
+        Include_File *file = get_include_file(path);
+        if (!file)
+        {
+            gb_printf_err("%.*s: \x1b[31mERROR:\x1b[0m Could not pre-include file '%s'\n",
+                          LIT(filename), path);
+            pp_add_missing(pp, make_string_alloc(pp->allocator, path));
+            continue;
+        }
+        pp_add_include(pp, file);
+
+        PP_Context context = {0};
+        context.filename = file->path;
+        context.file = file->file;
+        context.line = 1;
+        context.in_include = true;
+        context.from_filename = filename;
+        context.from_line = 0;
+        context.in_sandbox = false;
+        context.directives = &file->directives;
+
+        gbArray(Token) include_tokens = file->tokens;
+        Token_Run run = {include_tokens, include_tokens, include_tokens+gb_array_count(include_tokens)-1};
+        pp_push_context(pp, run, context, 0);
+    }
 }
 
-Preprocessor *make_preprocessor(gbArray(Token) tokens, String root_dir, String filename, PreprocessorConfig *conf)
+Preprocessor *make_preprocessor(gbArray(Token) tokens, String root_dir, String filename, PreprocessorConfig *conf, PP_Snapshot *prefix)
 {
-    gbAllocator alloc = gb_heap_allocator();
+    init_preprocessor();
+    Arena *arena = make_arena();
+    gbAllocator alloc = arena_allocator(arena);
     Preprocessor *pp = gb_alloc_item(alloc, Preprocessor);
+    pp->arena = arena;
 
     Token_Run tokens_head = {tokens, tokens, tokens + gb_array_count(tokens)};
     PP_Context base_context = {0};
     base_context.filename = filename;
+    base_context.file = intern_file(filename);
     base_context.line = 1;
 
+    pp->root_directives = index_directives(tokens, alloc);
+    base_context.directives = &pp->root_directives;
+
     pp->context = gb_alloc_item(alloc, PP_Context);
     *pp->context = base_context;
     pp->context->tokens = tokens_head;
@@ -118,77 +245,60 @@ Preprocessor *make_preprocessor(gbArray(Token) tokens, String root_dir, String f
     pp->root_dir = root_dir;
     pp->conf = conf;
 
-    gb_array_init(pp->output, alloc);
+    // The output grows to the size of the whole translation unit, so it is
+    // kept on the heap instead of leaving every outgrown copy in the arena
+    gb_array_init(pp->output, gb_heap_allocator());
+    gb_array_init(pp->arg_stack, gb_heap_allocator());
 
     init_std_defines(&pp->defines);
 
     pp->pragma_onces = hashmap_new(alloc);
 
-    gbArray(String) include_files;
-    if (conf->pre_includes && hashmap_get(conf->pre_includes, string_slice(filename, root_dir.len+1, -1), (void **)&include_files) == MAP_OK)
-    {
-        char path[512];
-        for (int i = 0; i < gb_array_count(include_files); i++)
-        {
-            gbFileContents fc = {0};
-            gb_snprintf(path, 512, "%.*s%c%.*s", LIT(root_dir), GB_PATH_SEPARATOR, LIT(include_files[i]));
-            fc = gb_file_read_contents(pp->allocator, true, path);
-            if (!fc.data)
-                gb_printf_err("%.*s: \x1b[31mERROR:\x1b[0m Could not pre-include file '%s'\n",
-                              LIT(filename), path);
-            PP_Context context = {0};
-            context.filename = make_string(gb_alloc_str(pp->allocator, path));
-            context.line = 1;
-            context.in_include = true;
-            context.from_filename = filename;
-            context.from_line = 0;
-            context.in_sandbox = false;
-
-            gbArray(Token) include_tokens;
-            gb_array_init(include_tokens, pp->allocator);
-
-            Tokenizer tokenizer = make_tokenizer(fc, make_string(context.filename.start));
-            Token token;
-            while ((token = get_token(&tokenizer)).kind != Token_EOF)
-                gb_array_append(include_tokens, token);
-
-            Token_Run run = {include_tokens, include_tokens, include_tokens+gb_array_count(include_tokens)-1};
-            pp_push_context(pp, run, context, fc.data);
-        }
-    }
+    gb_array_init(pp->includes, alloc);
+    pp->included = hashmap_new(alloc);
+    gb_array_init(pp->missing, alloc);
+    pp->missed = hashmap_new(alloc);
+
+    if (prefix)
+        pp_restore_snapshot(pp, prefix);
+    else
+        pp_push_pre_includes(pp, filename);
     return pp;
 }
 
 void destroy_preprocessor(Preprocessor *pp)
 {
-    if (pp->defines)
+    // Define files are allocated by `add_define`, on the heap, names are interned
+    if (pp->defines && pp->defines->entries)
     {
-        if (pp->defines->entries)
-        {
-            for (int i = 0; i < gb_array_count(pp->defines->entries); i++)
-            {
-                gb_free(pp->allocator, pp->defines->entries[i].value.file.start);
-                if (pp->defines->entries[i].value.params)
-                {
-                    gb_array_free(pp->defines->entries[i].value.params);
-                }
-            }
-        }
-        defines_destroy(pp->defines);
-        gb_free(pp->allocator, pp->defines);
+        for (int i = 0; i < gb_array_count(pp->defines->entries); i++)
+            gb_free(gb_heap_allocator(), pp->defines->entries[i].file.start);
     }
 
     for (int i = 0; i < gb_array_count(pp->file_contents); i++)
-        gb_free(pp->allocator, pp->file_contents[i]);
-    gb_array_free(pp->file_contents);
+        gb_free(gb_heap_allocator(), pp->file_contents[i]);
 
+    // Token arrays may come from the caller, so free them through their own allocator
     for (int i = 0; i < gb_array_count(pp->file_tokens); i++)
         gb_array_free(pp->file_tokens[i]);
-    gb_array_free(pp->file_tokens);
 
     if (pp->output)
         gb_array_free(pp->output);
-    gb_free(pp->allocator, pp);
+
+    // Argument storage is reused with its context node, so it is on the heap
+    gb_array_free(pp->arg_stack);
+    PP_Context *lists[2] = {pp->context, pp->free_contexts};
+    for (int i = 0; i < 2; i++)
+    {
+        for (PP_Context *context = lists[i]; context; context = context->next)
+        {
+            if (context->arg_storage)
+                gb_array_free(context->arg_storage);
+        }
+    }
+
+    // Contexts, conditionals, pasted strings and sandbox outputs all go at once
+    destroy_arena(pp->arena);
 }
 
 
@@ -242,6 +352,7 @@ void pp_parse_macro_args(Preprocessor *pp, gbArray(Token_Run) *args, b32 is_para
 }
 
 gbArray(Token) run_pp_sandboxed(Preprocessor *pp, Token_Run *run);
+gbArray(Token) run_pp_sandboxed_in(Preprocessor *pp, PP_Context *context, Token_Run *run);
 
 void pp_write_token_run(Preprocessor *pp, Token_Run to_write)
 {
@@ -296,8 +407,9 @@ void pp_write_token_run(Preprocessor *pp, Token_Run to_write)
             gb_snprintf(new.start, new.len, "%.*s%.*s", LIT(last->str), LIT(tok.str));
 
             last->str = new;
+            last->ident = intern(new);
 
-            Define def = pp_get_define(pp, new);
+            Define def = pp_get_define(pp, last->ident);
             if (def.in_use)
             {
                 gb_array_resize(pp->output, gb_array_count(pp->output)-1);
@@ -337,9 +449,12 @@ void pp_write_token_run(Preprocessor *pp, Token_Run to_write)
 
         if (pp->context->in_macro || pp->context->in_include)
         {
-            tok.from_loc.line   = pp->context->from_line;
-            tok.from_loc.column = pp->context->from_column;
-            tok.from_loc.file   = pp->context->filename;
+            if (!pp->context->origin)
+            {
+                File_Location from = {pp->context->file, pp->context->from_line, pp->context->from_column};
+                pp->context->origin = add_token_origin(from);
+            }
+            tok.origin = pp->context->origin;
         }
 
         gb_array_append(pp->output, tok);
@@ -417,42 +532,105 @@ int pp_next_ident_or_directive(Preprocessor *pp, b32 should_write)
 
 void pp_push_cond(Preprocessor *pp, b32 skip_else)
 {
-    Cond_Stack *cond = gb_alloc_item(pp->allocator, Cond_Stack);
+    Cond_Stack *cond = pp->free_conditionals;
+    if (cond)
+        pp->free_conditionals = cond->next;
+    else
+        cond = gb_alloc_item(pp->allocator, Cond_Stack);
     cond->skip_else = skip_else;
     cond->next = pp->conditionals;
     pp->conditionals = cond;
 }
 
-Define pp_unique_defines(Preprocessor *pp, String name)
+Define pp_unique_defines(Preprocessor *pp, u32 name)
 {
-    if (cstring_cmp(name, "__LINE__") == 0)
+    if (name == ident_LINE)
     {
         char *line_str = gb_alloc(pp->allocator, 24);
         gb_snprintf(line_str, 64, "%ld", pp->line);
-        return (Define){1, name, make_token_run(line_str, Token_Integer), 0, pp->context->filename, pp->line};
+        return (Define){1, interned_string(name), name, make_token_run(line_str, Token_Integer), 0, pp->context->filename, pp->line};
     }
-    else if (cstring_cmp(name, "__FILE__") == 0)
+    else if (name == ident_FILE)
     {
         char *file_str = gb_alloc_str_len(pp->allocator, pp->context->filename.start, pp->context->filename.len);
-        return (Define){1, name, make_token_run(file_str, Token_String), 0, pp->context->filename, pp->line};
+        return (Define){1, interned_string(name), name, make_token_run(file_str, Token_String), 0, pp->context->filename, pp->line};
     }
     return (Define){0};
 }
 
-Define pp_custom_symbol(Preprocessor *pp, String name)
+Define pp_custom_symbol(Preprocessor *pp, u32 name)
 {
     String *val;
+    String key = interned_string(name);
     if (pp->conf->custom_symbols
-        && hashmap_get(pp->conf->custom_symbols, name, (void **)&val) == MAP_OK)
+        && hashmap_get_hashed(pp->conf->custom_symbols, key, interned_hash(name), (void **)&val) == MAP_OK)
     {
         Token_Run run = str_make_token_run(*val, Token_String);
-        run.start->loc.file = pp->context->filename;
-        return (Define){1, name, str_make_token_run(*val, Token_Ident), 0, pp->context->filename, pp->line};
+        run.start->loc.file = pp->context->file;
+        return (Define){1, key, name, str_make_token_run(*val, Token_Ident), 0, pp->context->filename, pp->line};
     }
     return (Define){0};
 }
 
-Define pp_get_define(Preprocessor *pp, String name)
+Define pp_get_define_in(Preprocessor *pp, PP_Context *context, u32 name);
+
+// Expands an argument the way the context it was written in would. Runs
+// with nothing to expand, which is most of them, are used as they are.
+Token_Run pp_expand_arg(Preprocessor *pp, PP_Context *context, Token_Run arg)
+{
+    if (arg.end < arg.start)
+        return (Token_Run){0};
+
+    b32 plain = true;
+    for (Token *token = arg.start; plain && token <= arg.end; token++)
+    {
+        switch (token->kind)
+        {
+        case Token_Ident:
+            plain = !pp_get_define_in(pp, context, token->ident).in_use;
+            break;
+        case Token_Comment:
+        case Token_BackSlash:
+        case Token_Hash:
+        case Token_Paste:
+        case Token_pragma:
+        case Token_EOF:
+            plain = false;
+            break;
+        default:
+            break;
+        }
+    }
+    if (plain)
+        return (Token_Run){arg.start, arg.start, arg.end};
+
+    gbArray(Token) tokens = run_pp_sandboxed_in(pp, context, &arg);
+    Token_Run processed_run = (Token_Run){tokens, tokens, tokens+gb_array_count(tokens)-1};
+    if (processed_run.end < processed_run.start)
+        processed_run = (Token_Run){0};
+    return processed_run;
+}
+
+// Arguments of a macro invoked inside another one are expanded the first
+// time they're used, and that expansion is kept for the other uses
+Token_Run pp_macro_arg(Preprocessor *pp, PP_Context *context, isize index)
+{
+    Macro_Arg *arg = &context->args[index];
+    if (!arg->expanded)
+    {
+        arg->expanded = true;
+        if (arg->run.start && context->arg_context)
+            arg->run = pp_expand_arg(pp, context->arg_context, arg->run);
+    }
+    return arg->run;
+}
+
+Define pp_get_define(Preprocessor *pp, u32 name)
+{
+    return pp_get_define_in(pp, pp->context, name);
+}
+
+Define pp_get_define_in(Preprocessor *pp, PP_Context *context, u32 name)
 {
     Define *define = 0;
 
@@ -462,8 +640,23 @@ Define pp_get_define(Preprocessor *pp, String name)
     if (temp_define.in_use)
         define = &temp_define;
 
-    if (!define && pp->context && pp->context->local_defines)
-        define = get_define(pp->context->local_defines, name);
+    // Inside a macro its own name isn't expanded again, and its parameters
+    // expand to their arguments
+    if (!define && context && context->in_macro)
+    {
+        if (name == context->macro.ident)
+            return (Define){0};
+        for (isize i = context->arg_count-1; i >= 0; i--)
+        {
+            if (param_ident(context->macro.params[i]) == name)
+                return (Define){1, interned_string(name), name, pp_macro_arg(pp, context, i), 0, context->filename, pp->line};
+        }
+        if (context->has_va_args && name == ident_VA_OPT)
+        {
+            Token_Run value = context->va_args_empty ? va_opt_unset : va_opt_set;
+            return (Define){1, interned_string(name), name, value, va_opt_params, context->filename, pp->line};
+        }
+    }
     if (!define)
         define = get_define(pp->defines, name);
     if (define)
@@ -478,12 +671,16 @@ void pp_do_macro(Preprocessor *pp, Define define, Token name, Token *preceding_t
     b32 has_va_args = false;
     Token_Run va_args = {0};
 
-
-    gbArray(Token_Run) args = 0;
+    // Arguments are parsed on top of `arg_stack` and moved into the new
+    // context once it is pushed. Expanding them may parse other macros'
+    // arguments above these and can grow the stack, so they are indexed
+    // from `base` instead of kept by pointer.
+    isize base = gb_array_count(pp->arg_stack);
+    isize arg_count = 0;
     if (define.params)
     {
-        gb_array_init(args, pp->allocator);
-        if (cstring_cmp(name.str, "__VA_OPT__") == 0)
+        isize param_count = gb_array_count(define.params);
+        if (name.ident == ident_VA_OPT)
         {
             Token_Run arg = {&peek_at(pp, 1), &peek_at(pp, 1), 0};
 
@@ -494,39 +691,41 @@ void pp_do_macro(Preprocessor *pp, Define define, Token name, Token *preceding_t
                 pp_advance(pp);
             } while (skip_parens > 0);
             arg.end = &peek_at(pp, -2);
-            gb_array_append(args, arg);
+            gb_array_append(pp->arg_stack, arg);
         }
         else
         {
-            pp_parse_macro_args(pp, &args, false);
-            if (gb_array_count(args) == 1
-                && gb_array_count(define.params) == 0
+            pp_parse_macro_args(pp, &pp->arg_stack, false);
+            Token_Run *args = pp->arg_stack + base;
+            isize count = gb_array_count(pp->arg_stack) - base;
+            if (count == 1
+                && param_count == 0
                 && args[0].end < args[0].start)
             {
-                gb_array_free(args);
-                gb_array_init(args, pp->allocator);
+                gb_array_resize(pp->arg_stack, base);
             }
-            else if (cstring_cmp(token_run_string(define.params[gb_array_count(define.params)-1]), "__VA_ARGS__") == 0)
+            else if (param_ident(define.params[param_count-1]) == ident_VA_ARGS)
             {
                 has_va_args = true;
-                if (gb_array_count(args) >= gb_array_count(define.params))
+                if (count >= param_count)
                 {
-                    va_args.start = args[gb_array_count(define.params)-1].start;
+                    va_args.start = args[param_count-1].start;
                     va_args.curr = va_args.start;
-                    va_args.end = args[gb_array_count(args)-1].end;
+                    va_args.end = args[count-1].end;
                 }
-                gb_array_resize(args, gb_array_count(define.params)-1);
-                gb_array_append(args, va_args);
+                gb_array_resize(pp->arg_stack, base + param_count-1);
+                gb_array_append(pp->arg_stack, va_args);
             }
         }
+        arg_count = gb_array_count(pp->arg_stack) - base;
 
         invocation.len = (peek_at(pp, -1).str.start - invocation.start) + 1;
-        if (gb_array_count(args) != gb_array_count(define.params))
+        if (arg_count != param_count)
             gb_printf_err("(%.*s:%ld): \x1b[31mERROR:\x1b[0m Expected %ld arguments, but got %ld in macro '%.*s'\n",
                           LIT(pp->context->filename), pp->line,
-                          gb_array_count(define.params), gb_array_count(args),
+                          param_count, arg_count,
                           LIT(invocation));
-        GB_ASSERT(gb_array_count(args) == gb_array_count(define.params));
+        GB_ASSERT(arg_count == param_count);
     }
     pp->context->prev_token = &peek_at(pp, -1);
 
@@ -544,71 +743,80 @@ void pp_do_macro(Preprocessor *pp, Define define, Token name, Token *preceding_t
     new_context.macro = define;
     new_context.macro_invocation = invocation;
     new_context.filename = pp->context->filename;
+    new_context.file = pp->context->file;
     new_context.from_line = from_line;
     new_context.from_column = from_column;
     new_context.preceding_token = preceding_token;
     new_context.in_sandbox = pp->context->in_sandbox;
+    new_context.has_va_args = has_va_args;
+    new_context.va_args_empty = !va_args.start;
     if (pp->stringify_next || pp->context->stringify)
     {
         new_context.stringify = true;
         pp->stringify_next = false;
     }
 
+    // Arguments of a macro expanded inside another one are expanded in the
+    // invoking context, on first use, see `pp_macro_arg`
+    if (pp->context->in_macro)
+        new_context.arg_context = pp->context;
 
-    Define_Map *local_defines;
-    local_defines = gb_alloc_item(pp->allocator, Define_Map);
-    defines_init(local_defines, pp->allocator);
+    pp_push_context(pp, define.value, new_context, 0);
 
-    if (define.params)
+    if (arg_count)
     {
-        for (int i = 0; i < gb_array_count(define.params); i++)
+        PP_Context *context = pp->context;
+        if (!context->arg_storage)
+            gb_array_init_reserve(context->arg_storage, gb_heap_allocator(), arg_count);
+        gb_array_resize(context->arg_storage, arg_count);
+        for (isize i = 0; i < arg_count; i++)
         {
-            Token_Run processed_run = args[i];
-            if (pp->context->in_macro && args[i].start)
-            {
-                gbArray(Token) tokens = run_pp_sandboxed(pp, &args[i]);
-                processed_run = (Token_Run){tokens, tokens, tokens+gb_array_count(tokens)-1};
-                if (processed_run.end < processed_run.start)
-                    processed_run = (Token_Run){0};
-            }
-
-            add_define(&local_defines, token_run_string(define.params[i]), processed_run, 0, pp->line, pp->context->filename);
+            context->arg_storage[i].run = pp->arg_stack[base+i];
+            context->arg_storage[i].expanded = false;
         }
+        context->args = context->arg_storage;
+        context->arg_count = arg_count;
     }
+    gb_array_resize(pp->arg_stack, base);
+}
 
-    if (has_va_args)
+// Hands what the sandbox reused or grew back to `pp`, contexts left on the
+// sandbox's stack included, so their argument storage is reused too
+void pp_end_sandbox(Preprocessor *pp, Preprocessor *temp_pp)
+{
+    while (temp_pp->context)
     {
-        Token_Run va_opt_value;
-        if (va_args.start)
-            va_opt_value = make_token_run("x", Token_Ident);
-        else
-            va_opt_value = make_token_run("", Token_Ident);
-
-        gbArray(Token_Run) va_opt_params;
-        gb_array_init(va_opt_params, pp->allocator);
-        gb_array_append(va_opt_params, make_token_run("x", Token_Ident));
-        add_define(&local_defines, make_string("__VA_OPT__"), va_opt_value, va_opt_params, pp->line, pp->context->filename);
+        PP_Context *context = temp_pp->context;
+        temp_pp->context = context->next;
+        context->next = temp_pp->free_contexts;
+        temp_pp->free_contexts = context;
     }
-
-    add_fake_define(&local_defines, define.key);
-    new_context.local_defines = local_defines;
-
-    pp_push_context(pp, define.value, new_context, 0);
+    pp->free_contexts = temp_pp->free_contexts;
+    pp->free_conditionals = temp_pp->free_conditionals;
+    pp->arg_stack = temp_pp->arg_stack;
 }
 
 gbArray(Token) run_pp_sandboxed(Preprocessor *pp, Token_Run *run)
+{
+    return run_pp_sandboxed_in(pp, pp->context, run);
+}
+
+// Runs `run` on its own, as if it was found in `context`
+gbArray(Token) run_pp_sandboxed_in(Preprocessor *pp, PP_Context *context, Token_Run *run)
 {
     gbArray(Token) new_output = 0;
     gb_array_init(new_output, pp->allocator);
 
-    Preprocessor *temp_pp = gb_alloc_copy(pp->allocator, pp, sizeof(Preprocessor));
+    Preprocessor temp = *pp;
+    Preprocessor *temp_pp = &temp;
     temp_pp->context = 0;
     temp_pp->output = new_output;
     temp_pp->conditionals = 0;
     temp_pp->stringify_next = false;
     temp_pp->paste_next = false;
 
-    PP_Context new_context = *pp->context;
+    PP_Context new_context = *context;
+    new_context.directives = 0;
     new_context.in_sandbox = true;
     new_context.stringify = false;
     new_context.no_paste = true;
@@ -616,11 +824,14 @@ gbArray(Token) run_pp_sandboxed(Preprocessor *pp, Token_Run *run)
     gb_array_init(temp_pp->file_contents, pp->allocator);
     gb_array_init(temp_pp->file_tokens, pp->allocator);
 
+    // Whatever the sandbox defines doesn't leak into the caller
+    Define_Snapshot snapshot = defines_snapshot(pp->defines);
     pp_push_context(temp_pp, *run, new_context, 0);
     run_pp(temp_pp);
+    defines_restore(pp->defines, snapshot);
 
     gbArray(Token) output_ret = temp_pp->output;
-    gb_free(pp->allocator, temp_pp);
+    pp_end_sandbox(pp, temp_pp);
 
     return output_ret;
 }
@@ -630,7 +841,8 @@ gbArray(Token) pp_do_sandboxed_macro(Preprocessor *pp, Token_Run *run, Define de
     gbArray(Token) new_output = 0;
     gb_array_init(new_output, pp->allocator);
 
-    Preprocessor *temp_pp = gb_alloc_copy(pp->allocator, pp, sizeof(Preprocessor));
+    Preprocessor temp = *pp;
+    Preprocessor *temp_pp = &temp;
     temp_pp->context = 0;
     temp_pp->output = new_output;
     temp_pp->conditionals = 0;
@@ -642,15 +854,18 @@ gbArray(Token) pp_do_sandboxed_macro(Preprocessor *pp, Token_Run *run, Define de
 
     PP_Context context = {0};
     context.filename = pp->context->filename;
+    context.file = pp->context->file;
     context.in_sandbox = true;
 
+    Define_Snapshot snapshot = defines_snapshot(pp->defines);
     if (run)
         pp_push_context(temp_pp, *run, context, 0);
     pp_do_macro(temp_pp, define, name, 0);
     run_pp(temp_pp);
+    defines_restore(pp->defines, snapshot);
 
     gbArray(Token) output_ret = temp_pp->output;
-    gb_free(pp->allocator, temp_pp);
+    pp_end_sandbox(pp, temp_pp);
 
     return output_ret;
 }
@@ -686,8 +901,36 @@ Token_Run pp_get_line(Preprocessor *pp)
     return line;
 }
 
+// Jumps straight to the directive ending the block, if the file's index
+// knows where it is
+b32 _directive_skip_indexed(Preprocessor *pp, b32 skip_all)
+{
+    Directive_Index *index = pp->context->directives;
+    if (!index || !pp->directive)
+        return false;
+    isize i = find_cond_directive(index, pp->directive);
+    if (i < 0)
+        return false;
+
+    i32 next = index->conds[i].next;
+    while (skip_all && next >= 0 && index->conds[next].kind != Directive_endif)
+        next = index->conds[next].next;
+    if (next < 0)
+        return false;
+
+    Token *target = index->tokens + index->conds[next].hash;
+    if (target < &peek(pp) || target > pp->context->tokens.end)
+        return false;
+    pp->context->tokens.curr = target;
+    pp->line = target->loc.line;
+    return true;
+}
+
 void _directive_skip_conditional_block(Preprocessor *pp, b32 skip_all)
 {
+    if (_directive_skip_indexed(pp, skip_all))
+        return;
+
     int skip_endifs = 0;
     for (;;)
     {
@@ -741,17 +984,15 @@ void _directive_conditional(Preprocessor *pp, b32 test_res, b32 is_else)
 
 void directive_define(Preprocessor *pp)
 {
+    // Keywords can be redefined too
     Token def_token = {0};
-    for (int k = Token__KeywordBegin+1; k < Token__KeywordEnd; k++)
-    {
-        def_token = accept_token(&pp->context->tokens, k);
-        if (def_token.str.start)
-            break;
-    }
+    TokenKind kind = peek(pp).kind;
+    if (kind > Token__KeywordBegin && kind < Token__KeywordEnd)
+        def_token = accept_token(&pp->context->tokens, kind);
 
     if (!def_token.str.start)
         def_token = expect_token(&pp->context->tokens, Token_Ident);
-    String def_name = def_token.str;
+    u32 def_name = def_token.ident;
 	isize def_line = def_token.loc.line;
 
     gbArray(Token_Run) params = 0;
@@ -773,17 +1014,15 @@ void directive_define(Preprocessor *pp)
 
 void directive_undef(Preprocessor *pp)
 {
+    // Keywords can be redefined too
     Token def_token = {0};
-    for (int k = Token__KeywordBegin+1; k < Token__KeywordEnd; k++)
-    {
-        def_token = accept_token(&pp->context->tokens, k);
-        if (def_token.str.start)
-            break;
-    }
+    TokenKind kind = peek(pp).kind;
+    if (kind > Token__KeywordBegin && kind < Token__KeywordEnd)
+        def_token = accept_token(&pp->context->tokens, kind);
 
     if (!def_token.str.start)
         def_token = expect_token(&pp->context->tokens, Token_Ident);
-    String def_name = def_token.str;
+    u32 def_name = def_token.ident;
 
     // String name = expect_token(&pp->context->tokens, Token_Ident).str;
     remove_define(&pp->defines, def_name);
@@ -816,7 +1055,7 @@ void _directive_include(Preprocessor *pp, b32 next)
     else
     {
         Token tok = expect_token(&pp->context->tokens, Token_Ident);
-        Define def = pp_get_define(pp, tok.str);
+        Define def = pp_get_define(pp, tok.ident);
         if (!def.in_use)
         {
             error(tok, "Undefined identifier '%.*s' in \x1b[35m#include\x1b[0m directive", LIT(tok.str));
@@ -866,58 +1105,69 @@ void _directive_include(Preprocessor *pp, b32 next)
     normalize_path(filename);
     String root_dir = dir_from_path(pp->context->filename);
 
-    char path[512];
-    gbFileContents fc = {0};
-    if (local_first && !next)
+    String key = make_include_key(gb_heap_allocator(), filename, root_dir, local_first, next);
+
+    char path[512] = {0};
+    Include_File *file = 0;
+    Resolved_Include *resolved = get_resolved_include(key);
+    if (resolved)
     {
-        gb_snprintf(path, 512, "%.*s%.*s", LIT(root_dir), LIT(filename));
-        fc = gb_file_read_contents(pp->allocator, true, path);
+        file = resolved->file;
+        for (int i = 0; resolved->missing && i < gb_array_count(resolved->missing); i++)
+            pp_add_missing(pp, resolved->missing[i]);
     }
-    if (pp->conf->include_dirs)
+    else
     {
-        for (int i = 0; i < gb_array_count(pp->conf->include_dirs) && !fc.data; i++)
+        gbArray(String) missing;
+        gb_array_init(missing, gb_heap_allocator());
+        if (local_first && !next)
+        {
+            gb_snprintf(path, 512, "%.*s%.*s", LIT(root_dir), LIT(filename));
+            file = pp_try_include(pp, path, &missing);
+        }
+        for (int i = 0; pp->conf->include_dirs && i < gb_array_count(pp->conf->include_dirs) && !file; i++)
         {
             gb_snprintf(path, 512, "%.*s%c%.*s", LIT(pp->conf->include_dirs[i]), GB_PATH_SEPARATOR, LIT(filename));
             if (!next || !has_prefix(make_string(path), root_dir))
-                fc = gb_file_read_contents(pp->allocator, true, path);
+                file = pp_try_include(pp, path, &missing);
         }
+        for (int i = 0; i < gb_array_count(pp->system_includes) && !file; i++)
+        {
+            gb_snprintf(path, 512, "%.*s%c%.*s", LIT(pp->system_includes[i]), GB_PATH_SEPARATOR, LIT(filename));
+            if (!next || !has_prefix(make_string(path), root_dir))
+                file = pp_try_include(pp, path, &missing);
+        }
+
+        if (!file)
+        {
+            Token tok = {.loc={.file=pp->context->file, .line=from_line}};
+            error(tok, "Could not \x1b[35m#include\x1b[0m file '%.*s'(%s)", LIT(filename), path);
+            gb_exit(1);
+        }
+        put_resolved_include(key, file, missing);
+        gb_array_free(missing);
     }
-    for (int i = 0; i < gb_array_count(pp->system_includes) && !fc.data; i++)
-    {
-        gb_snprintf(path, 512, "%.*s%c%.*s", LIT(pp->system_includes[i]), GB_PATH_SEPARATOR, LIT(filename));
-        if (!next || !has_prefix(make_string(path), root_dir))
-            fc = gb_file_read_contents(pp->allocator, true, path);
-    }
+    gb_free(gb_heap_allocator(), key.start);
+    pp_add_include(pp, file);
+
+    if (hashmap_exists(pp->pragma_onces, file->path))
+        return;
+    if (file->guard && pp_get_define(pp, file->guard).in_use)
+        return;
 
     PP_Context context = {0};
-    context.filename = make_string(gb_alloc_str(pp->allocator, path));
+    context.filename = file->path;
+    context.file = file->file;
     context.line = 1;
     context.in_include = true;
     context.from_filename = pp->context->filename;
     context.from_line = from_line;
     context.in_sandbox = pp->context->in_sandbox;
+    context.directives = &file->directives;
 
-    gbArray(Token) tokens = 0;
-
-    if (fc.data)
-    {
-        if (hashmap_exists(pp->pragma_onces, context.filename))
-            return;
-        Tokenizer tokenizer = make_tokenizer(fc, make_string(context.filename.start));
-        gb_array_init(tokens, pp->allocator);
-        Token token;
-        while ((token = get_token(&tokenizer)).kind != Token_EOF)
-            gb_array_append(tokens, token);
-    }
-    else
-    {
-        Token tok = {.loc={.file=pp->context->filename, .line=from_line}};
-        error(tok, "Could not \x1b[35m#include\x1b[0m file '%.*s'(%s)", LIT(filename), path);
-        gb_exit(1);
-    }
-
+    gbArray(Token) tokens = file->tokens;
     Token_Run run = {tokens, tokens, tokens+gb_array_count(tokens)-1};
-    pp_push_context(pp, run, context, fc.data);
+    pp_push_context(pp, run, context, 0);
 }
 
 void directive_include(Preprocessor *pp)
@@ -932,7 +1182,7 @@ void directive_include_next(Preprocessor *pp)
 
 void directive_ifdef(Preprocessor *pp, b32 invert)
 {
-    String def_name = expect_token(&pp->context->tokens, Token_Ident).str;
+    u32 def_name = expect_token(&pp->context->tokens, Token_Ident).ident;
     Define define = pp_get_define(pp, def_name);
 
     _directive_conditional(pp, define.in_use ^ invert, false);
@@ -941,13 +1191,9 @@ void directive_ifdef(Preprocessor *pp, b32 invert)
 void directive_if(Preprocessor *pp)
 {
     Token_Run expr = pp_get_line(pp);
-
-    Expr *parsed = pp_parse_expression(expr, pp->allocator, pp, true);
-    u64 res = pp_eval_expression(pp, parsed);
+    u64 res = pp_eval_directive(pp, expr);
 
     _directive_conditional(pp, res, false);
-
-    free_expr(pp->allocator, parsed);
 }
 
 void directive_elif(Preprocessor *pp)
@@ -960,9 +1206,7 @@ void directive_elif(Preprocessor *pp)
     else
     {
         Token_Run expr = pp_get_line(pp);
-
-        Expr *parsed = pp_parse_expression(expr, pp->allocator, pp, true);
-        u64 res = pp_eval_expression(pp, parsed);
+        u64 res = pp_eval_directive(pp, expr);
 
         _directive_conditional(pp, res, true);
     }
@@ -978,7 +1222,8 @@ void directive_endif(Preprocessor *pp)
 {
     Cond_Stack *old_cond = pp->conditionals;
     pp->conditionals = pp->conditionals->next;
-    gb_free(pp->allocator, old_cond);
+    old_cond->next = pp->free_conditionals;
+    pp->free_conditionals = old_cond;
 }
 
 void directive_error(Preprocessor *pp)
@@ -1048,79 +1293,40 @@ void run_pp(Preprocessor *pp)
         if (type == 1) // directive
         {
             Token *reset = &peek(pp);
-            String directive = expect_tokens(&pp->context->tokens, 4,
-                                             Token_Ident,
-                                             Token_if,
-                                             Token_else,
-                                             Token_pragma).str;
-            if (cstring_cmp(directive, "define") == 0)
+            pp->directive = reset-1;
+            Token name = expect_tokens(&pp->context->tokens, 4,
+                                       Token_Ident,
+                                       Token_if,
+                                       Token_else,
+                                       Token_pragma);
+            switch (directive_kind(name.ident))
             {
-                directive_define(pp);
-            }
-            else if (cstring_cmp(directive, "undef") == 0)
-            {
-                directive_undef(pp);
-            }
-            else if (cstring_cmp(directive, "include") == 0)
-            {
-                directive_include(pp);
-            }
-            else if (cstring_cmp(directive, "include_next") == 0)
-            {
-                directive_include_next(pp);
-            }
-            else if (cstring_cmp(directive, "ifdef") == 0)
-            {
-                directive_ifdef(pp, false);
-            }
-            else if (cstring_cmp(directive, "ifndef") == 0)
-            {
-                directive_ifdef(pp, true);
-            }
-            else if (cstring_cmp(directive, "if") == 0)
-            {
-                directive_if(pp);
-            }
-            else if (cstring_cmp(directive, "elif") == 0)
-            {
-                directive_elif(pp);
-            }
-            else if (cstring_cmp(directive, "else") == 0)
-            {
-                directive_else(pp);
-            }
-            else if (cstring_cmp(directive, "endif") == 0)
-            {
-                directive_endif(pp);
-            }
-            else if (cstring_cmp(directive, "error") == 0)
-            {
-                directive_error(pp);
-            }
-            else if (cstring_cmp(directive, "warning") == 0)
-            {
-                directive_warning(pp);
-            }
-            else if (cstring_cmp(directive, "line") == 0)
-            {
-                directive_line(pp);
-            }
-            else if (cstring_cmp(directive, "pragma") == 0)
-            {
-                directive_pragma(pp);
-            }
-            else if (cstring_cmp(directive, "__pragma") == 0)
-            {
-                keyword_pragma(pp);
-            }
-            else if (pp->context->in_macro)
-            {
-                pp->context->tokens.curr = reset;
-                pp->stringify_next = true;
-            }
-            else
-            {
-                gb_printf_err("%.*s:%ld: \x1b[33mWarning:\x1b[0m Unhandled directive (%.*s)\n", LIT(pp->context->filename), pp->line, LIT(directive));
+            case Directive_define:       directive_define(pp);          break;
+            case Directive_undef:        directive_undef(pp);           break;
+            case Directive_include:      directive_include(pp);         break;
+            case Directive_include_next: directive_include_next(pp);    break;
+            case Directive_ifdef:        directive_ifdef(pp, false);    break;
+            case Directive_ifndef:       directive_ifdef(pp, true);     break;
+            case Directive_if:           directive_if(pp);              break;
+            case Directive_elif:         directive_elif(pp);            break;
+            case Directive_else:         directive_else(pp);            break;
+            case Directive_endif:        directive_endif(pp);           break;
+            case Directive_error:        directive_error(pp);           break;
+            case Directive_warning:      directive_warning(pp);         break;
+            case Directive_line:         directive_line(pp);            break;
+            case Directive_pragma:       directive_pragma(pp);          break;
+            case Directive___pragma:     keyword_pragma(pp);            break;
+            default:
+                if (pp->context->in_macro)
+                {
+                    pp->context->tokens.curr = reset;
+                    pp->stringify_next = true;
+                }
+                else
+                {
+                    gb_printf_err("%.*s:%ld: \x1b[33mWarning:\x1b[0m Unhandled directive (%.*s)\n", LIT(pp->context->filename), pp->line, LIT(name.str));
+                }
+                break;
             }
         }
         else if (type == 2) // Identifier
@@ -1128,7 +1334,7 @@ void run_pp(Preprocessor *pp)
             Token *reset = &peek(pp);
             Token ident = expect_token(&pp->context->tokens, Token_Ident);
 
-            Define define = pp_get_define(pp, ident.str);
+            Define define = pp_get_define(pp, ident.ident);
 
             if (define.in_use && !(define.params && peek(pp).kind != Token_OpenParen))
             {
@@ -1136,10 +1342,9 @@ void run_pp(Preprocessor *pp)
                 {
                     if (define.params)
                     {
-                        gbArray(Token_Run) args_temp;
-                        gb_array_init(args_temp, pp->allocator);
-                        pp_parse_macro_args(pp, &args_temp, false);
-                        gb_array_free(args_temp);
+                        isize base = gb_array_count(pp->arg_stack);
+                        pp_parse_macro_args(pp, &pp->arg_stack, false);
+                        gb_array_resize(pp->arg_stack, base);
                     }
                     else if (pp->paste_next
                              && cstring_cmp(define.key, "__VA_ARGS__") == 0
@@ -1186,22 +1391,18 @@ gbArray(Define) pp_dump_defines(Preprocessor *pp, String whitelist_dir)
 
 void pp_print(Preprocessor *pp, char *filename)
 {
-    gbAllocator a = pp->allocator;
-
-    gbFile *pp_out_file = gb_alloc_item(a, gbFile);
+    gbFile pp_out_file = {0};
     create_path_to_file(filename);
-    gb_file_create(pp_out_file, filename);
+    gb_file_create(&pp_out_file, filename);
 
-    Token prev_token = {0};
-    String prev_token_string = {0};
-    i32 prev_token_length = 0;
+    Writer out = {0};
+    writer_init(&out, &pp_out_file, pp->allocator);
 
+    Token prev_token = {0};
     for (int i = 0; i < gb_array_count(pp->output); i++)
     {
         Token token = pp->output[i];
 
-        String token_string = token.str;
-
         i32 newline = 0;
         i32 num_spaces = 0;
         if (i > 0)
@@ -1211,42 +1412,23 @@ void pp_print(Preprocessor *pp, char *filename)
                 num_spaces = token.pp_loc.column - (prev_token.pp_loc.column+prev_token.str.len);
         }
 
-        // char *newlines = gb_alloc(a, newline+1);
-        // gb_memset(newlines, '\n', newline);
-
-        char *spaces = gb_alloc(a, num_spaces+1);
-        gb_memset(spaces, ' ', num_spaces);
-
-        char *indentation = 0;
+        // Blank lines are collapsed to one
+        if (newline)
+            writer_write(&out, "\n\n", newline > 1 ? 2 : 1);
         if (newline && token.pp_loc.column > 0)
-        {
-            indentation = gb_alloc(a, token.pp_loc.column+1);
-            gb_memset(indentation, ' ', token.pp_loc.column);
-        }
+            writer_spaces(&out, token.pp_loc.column);
+        writer_spaces(&out, num_spaces);
+
+        char quote = token.kind == Token_String ? '"' : token.kind == Token_Char ? '\'' : 0;
+        if (quote)
+            writer_write(&out, &quote, 1);
+        writer_string(&out, token.str);
+        if (quote)
+            writer_write(&out, &quote, 1);
 
-        b32 is_string = token.kind == Token_String;
-        b32 is_char = token.kind == Token_Char;
-
-        /* gb_fprintf(pp_out_file, "%s%s%s%c%.*s%c", */
-        /*            newlines, */
-        /*            indentation, */
-        /*            spaces, */
-        /*            is_string?'"':is_char?'\'':0, */
-        /*            LIT(token_string), */
-        /*            is_string?'"':is_char?'\'':0); */
-
-        gb_fprintf(pp_out_file, "%c%c%s%s%c%.*s%c",
-                   newline?'\n':0,
-                   newline > 1?'\n':0,
-                   indentation,
-                   spaces,
-                   is_string?'"':is_char?'\'':0,
-                   LIT(token_string),
-                   is_string?'"':is_char?'\'':0);
-
-        // gb_free(a, newlines);
-        gb_free(a, spaces);
         prev_token = token;
     }
-    gb_file_close(pp_out_file);
+    writer_flush(&out);
+    gb_free(pp->allocator, out.buffer);
+    gb_file_close(&pp_out_file);
 }
@@ -36,16 +36,14 @@ void print_file(Printer p);
 
 void print_indent(Printer p, int indent)
 {
-    if (!indent) return;
-    char *spaces = repeat_char(' ', indent*4, p.allocator);
-    gb_fprintf(p.out_file, "%s", spaces);
-    gb_free(p.allocator, spaces);
+    writer_spaces(p.out, indent*4);
 }
 
-Printer make_printer(Resolver resolver)
+Printer make_printer(Resolver resolver, Arena *arena)
 {
     Printer printer = {0};
-    printer.allocator = gb_heap_allocator();
+    printer.arena = arena;
+    printer.allocator = arena_allocator(arena);
     printer.package = resolver.package;
 
     printer.rename_map = resolver.rename_map;
@@ -53,10 +51,16 @@ Printer make_printer(Resolver resolver)
     printer.conf = resolver.conf;
 
     init_rename_map(printer.rename_map, printer.allocator);
+    printer.renames = make_rename_cache(printer.rename_map, printer.conf);
 
     return printer;
 }
 
+void destroy_printer(Printer p)
+{
+    destroy_rename_cache(p.renames);
+}
+
 void print_ident(Printer p, Node *node, int indent)
 {
     print_string(p, node->Ident.ident, indent);
@@ -109,50 +113,50 @@ void print_basic_lit(Printer p, Node *node, int indent)
     switch (node->BasicLit.token.kind)
     {
         case Token_String:
-        gb_fprintf(p.out_file, "\"%.*s\"", LIT(node->BasicLit.token.str));
+        writer_printf(p.out, "\"%.*s\"", LIT(node->BasicLit.token.str));
         break;
 
         case Token_Char:
         case Token_Wchar:
-        gb_fprintf(p.out_file, "'%.*s'", LIT(node->BasicLit.token.str));
+        writer_printf(p.out, "'%.*s'", LIT(node->BasicLit.token.str));
         break;
 
         case Token_Float:
         case Token_Integer: {
             char *odinized = odinize_number(node->BasicLit.token.str, p.allocator);
-            gb_fprintf(p.out_file, "%s", odinized);
+            writer_printf(p.out, "%s", odinized);
             gb_free(p.allocator, odinized);
         } break;
 
         default:
-        gb_fprintf(p.out_file, "%.*s", LIT(node->BasicLit.token.str));
+        writer_printf(p.out, "%.*s", LIT(node->BasicLit.token.str));
         break;
     }
 }
 void print_inc_dec_expr(Printer p, Node *node, int indent)
 {
     print_expr(p, node->IncDecExpr.expr, indent);
-    gb_fprintf(p.out_file, "%.*s", LIT(node->IncDecExpr.op.str));
+    writer_printf(p.out, "%.*s", LIT(node->IncDecExpr.op.str));
 }
 void print_call_expr(Printer p, Node *node, int indent)
 {
     print_expr(p, node->CallExpr.func, indent);
-    gb_fprintf(p.out_file, "(");
+    writer_printf(p.out, "(");
     print_expr_list(p, node->CallExpr.args, 0);
-    gb_fprintf(p.out_file, ")");
+    writer_printf(p.out, ")");
 }
 void print_index_expr(Printer p, Node *node, int indent)
 {
     print_expr(p, node->IndexExpr.expr, indent);
-    gb_fprintf(p.out_file, "[");
+    writer_printf(p.out, "[");
     print_expr(p, node->IndexExpr.index, 0);
-    gb_fprintf(p.out_file, "]");
+    writer_printf(p.out, "]");
 }
 void print_paren_expr(Printer p, Node *node, int indent)
 {
-    gb_fprintf(p.out_file, "(");
+    writer_printf(p.out, "(");
     print_expr(p, node->ParenExpr.expr, 0);
-    gb_fprintf(p.out_file, ")");
+    writer_printf(p.out, ")");
 }
 
 void print_unary_expr(Printer p, Node *node, int indent)
@@ -160,16 +164,16 @@ void print_unary_expr(Printer p, Node *node, int indent)
     if (node->UnaryExpr.op.kind == Token_Mul)
     {
         print_expr(p, node->UnaryExpr.operand, indent);
-        gb_fprintf(p.out_file, "^");
+        writer_printf(p.out, "^");
     }
     else if (node->UnaryExpr.op.kind == Token_sizeof)
     {
-        gb_fprintf(p.out_file, "size_of");
+        writer_printf(p.out, "size_of");
         print_expr(p, node->UnaryExpr.operand, indent);
     }
     else
     {
-        gb_fprintf(p.out_file, "%.*s", LIT(node->UnaryExpr.op.str));
+        writer_printf(p.out, "%.*s", LIT(node->UnaryExpr.op.str));
         print_expr(p, node->UnaryExpr.operand, 0);
     }
 }
@@ -177,28 +181,28 @@ void print_binary_expr(Printer p, Node *node, int indent)
 {
     print_expr(p, node->BinaryExpr.left, indent);
     if (node->BinaryExpr.op.kind != Token_Xor)
-        gb_fprintf(p.out_file, " %.*s ", LIT(node->BinaryExpr.op.str));
+        writer_printf(p.out, " %.*s ", LIT(node->BinaryExpr.op.str));
     else
-        gb_fprintf(p.out_file, " ~ ");
+        writer_printf(p.out, " ~ ");
     print_expr(p, node->BinaryExpr.right, 0);
 }
 void print_ternary_expr(Printer p, Node *node, int indent)
 {
     print_expr(p, node->TernaryExpr.cond, indent);
-    gb_fprintf(p.out_file, " ? ");
+    writer_printf(p.out, " ? ");
     print_expr(p, node->TernaryExpr.then, indent);
-    gb_fprintf(p.out_file, " : ");
+    writer_printf(p.out, " : ");
     print_expr(p, node->TernaryExpr.els_, indent);
 }
 void print_cast_expr(Printer p, Node *node, int indent)
 {
     b32 add_parens = node->TypeCast.expr->kind != NodeKind_ParenExpr;
-    gb_fprintf(p.out_file, "(");
+    writer_printf(p.out, "(");
     print_type(p, node->TypeCast.type, 0);
-    gb_fprintf(p.out_file, ")");
-    if (add_parens) gb_fprintf(p.out_file, "(");
+    writer_printf(p.out, ")");
+    if (add_parens) writer_printf(p.out, "(");
     print_expr(p, node->TypeCast.expr, 0);
-    if (add_parens) gb_fprintf(p.out_file, ")");
+    if (add_parens) writer_printf(p.out, ")");
 }
 void print_expr(Printer p, Node *node, int indent)
 {
@@ -230,16 +234,16 @@ void print_expr_list(Printer p, Node *node, int indent)
     {
         print_expr(p, node->ExprList.list[i], indent);
         if (gb_array_count(node->ExprList.list) > i+1)
-            gb_fprintf(p.out_file, ", ");
+            writer_printf(p.out, ", ");
         indent = 0;
     }
 }
 
 void print_array_type(Printer p, Node *node, int indent)
 {
-    gb_fprintf(p.out_file, "[");
+    writer_printf(p.out, "[");
     print_expr(p, node->ArrayType.count, 0);
-    gb_fprintf(p.out_file, "]");
+    writer_printf(p.out, "]");
     print_indent(p, indent);
     print_type(p, node->ArrayType.type, 0);
 }
@@ -249,10 +253,10 @@ void print_calling_convention(Printer p, Token token)
     switch (token.kind)
     {
     case Token_stdcall:
-        gb_fprintf(p.out_file, " \"stdcall\" ");
+        writer_printf(p.out, " \"stdcall\" ");
         break;
     case Token_fastcall:
-        gb_fprintf(p.out_file, " \"fastcall\" ");
+        writer_printf(p.out, " \"fastcall\" ");
         break;
     }
 }
@@ -265,25 +269,25 @@ void print_function_type(Printer p, Node *node, int indent)
         node->FunctionType.ret_type->kind == NodeKind_Ident
         && cstring_cmp(node->FunctionType.ret_type->Ident.token.str, "void") == 0;
 
-    gb_fprintf(p.out_file, "%cproc", ret_void ? 0 : '(');
+    writer_printf(p.out, "%cproc", ret_void ? 0 : '(');
     print_calling_convention(p, node->FunctionType.calling_convention);
-    gb_fprintf(p.out_file, "(");
+    writer_printf(p.out, "(");
     if (node->FunctionType.params)
         print_function_parameters(p, node->FunctionType.params, 0);
-    gb_fprintf(p.out_file, ")");
+    writer_printf(p.out, ")");
 
     if (!ret_void)
     {
-        gb_fprintf(p.out_file, " -> ");
+        writer_printf(p.out, " -> ");
         print_type(p, node->FunctionType.ret_type, 0);
-        gb_fprintf(p.out_file, ")");
+        writer_printf(p.out, ")");
     }
 }
 
 b32 top_level_type = false;
 void print_base_type(Printer p, Node *node, int indent)
 {
-    String name = convert_type(node, p.rename_map, p.conf, p.allocator);
+    String name = convert_type(node, p.renames, p.allocator);
 
     switch (node->kind)
     {
@@ -322,7 +326,7 @@ void print_type(Printer p, Node *node, int indent)
                     String name = child->Ident.token.str;
                     if (cstring_cmp(name, "void") == 0)
                     {
-                        gb_fprintf(p.out_file, "rawptr");
+                        writer_printf(p.out, "rawptr");
                         return;
                     }
                 } break;
@@ -332,12 +336,12 @@ void print_type(Printer p, Node *node, int indent)
                     String str = integer_type_str(child);
                     if (cstring_cmp(str, "u8") == 0)
                     {
-                        gb_fprintf(p.out_file, "cstring");
+                        writer_printf(p.out, "cstring");
                         return;
                     }
                 } break;
             }
-            gb_fprintf(p.out_file, "^");
+            writer_printf(p.out, "^");
             print_type(p, child, 0);
         } break;
 
@@ -353,7 +357,7 @@ void print_type(Printer p, Node *node, int indent)
         break;
 
         case NodeKind_VaArgs:
-        gb_fprintf(p.out_file, "..any");
+        writer_printf(p.out, "..any");
         break;
         default:
         gb_printf_err("Invalid node as type: '%.*s'\n", LIT(node_strings[node->kind]));
@@ -363,7 +367,7 @@ void print_type(Printer p, Node *node, int indent)
 
 void print_va_args(Printer p, Node *node, int indent)
 {
-    gb_fprintf(p.out_file, "..any");
+    writer_printf(p.out, "..any");
 }
 
 void print_variable(Printer p, Node *node, int indent, b32 top_level, int name_padding)
@@ -376,29 +380,26 @@ void print_variable(Printer p, Node *node, int indent, b32 top_level, int name_p
         case VarDecl_Variable: {
             if (!top_level) break;
             String name    = node->VarDecl.name->Ident.token.str;
-            String renamed = rename_ident(name, RENAME_VAR, true, p.rename_map, p.conf, p.allocator);
+            String renamed = rename_cached(p.renames, node->VarDecl.name->Ident.token, RENAME_VAR, true);
 
             int name_padding = p.var_name_padding;
             if (p.conf->var_case || (p.conf->var_prefix.len && !has_prefix(name, p.conf->var_prefix)))
             {
                 if (!p.conf->var_case)
                     name_padding -= 16 + p.var_link_padding;
-                char *link_name_padding = repeat_char(' ', p.var_link_padding - name.len, p.allocator);
-                gb_fprintf(p.out_file, "@(link_name=\"%.*s\")%s ",
-                           LIT(name), link_name_padding);
-                gb_free(p.allocator, link_name_padding);
+                writer_printf(p.out, "@(link_name=\"%.*s\")", LIT(name));
+                writer_spaces(p.out, p.var_link_padding - name.len);
+                writer_printf(p.out, " ");
             }
 
-            char *var_name_padding  = repeat_char(' ', name_padding - renamed.len, p.allocator);
-            gb_fprintf(p.out_file, "%.*s%s : ",
-                       LIT(renamed), var_name_padding);
-            gb_free(p.allocator, var_name_padding);
+            writer_string(p.out, renamed);
+            writer_spaces(p.out, name_padding - renamed.len);
+            writer_printf(p.out, " : ");
         } break;
 
         case VarDecl_Field: {
-            String name    = node->VarDecl.name->Ident.token.str;
-            String renamed = rename_ident(name, RENAME_VAR, false, p.rename_map, p.conf, p.allocator);
-            char *var_name_padding = 0;
+            String renamed = rename_cached(p.renames, node->VarDecl.name->Ident.token, RENAME_VAR, false);
+            writer_string(p.out, renamed);
             switch (type.base_type->kind)
             {
                 // NOTE: This works because all these kinds have the same layout
@@ -408,29 +409,27 @@ void print_variable(Printer p, Node *node, int indent, b32 top_level, int name_p
                 if (type.base_type->StructType.fields) break; // Don't add padding for record definitions
 
                 default:
-                var_name_padding = repeat_char(' ', name_padding - renamed.len, p.allocator);
+                writer_spaces(p.out, name_padding - renamed.len);
                 break;
             }
-            gb_fprintf(p.out_file, "%.*s%s : ", LIT(renamed), var_name_padding);
-            if (var_name_padding) gb_free(p.allocator, var_name_padding);
+            writer_printf(p.out, " : ");
         } break;
 
 
         case VarDecl_Parameter: {
-            String name    = node->VarDecl.name->Ident.token.str;
-            String renamed = rename_ident(name, RENAME_VAR, false, p.rename_map, p.conf, p.allocator);
-            gb_fprintf(p.out_file, "%.*s : ", LIT(renamed));
+            String renamed = rename_cached(p.renames, node->VarDecl.name->Ident.token, RENAME_VAR, false);
+            writer_printf(p.out, "%.*s : ", LIT(renamed));
         } break;
 
         case VarDecl_VaArgs:
         case VarDecl_NamelessParameter:
         case VarDecl_AnonBitfield:
         if (node->VarDecl.type->kind == NodeKind_BitfieldType)
-                gb_fprintf(p.out_file, "_ : ");
+                writer_printf(p.out, "_ : ");
         break;
 
         case VarDecl_AnonRecord:
-        gb_fprintf(p.out_file, "using _ : ");
+        writer_printf(p.out, "using _ : ");
         break;
     }
 
@@ -450,11 +449,11 @@ void print_enum_field(Printer p, Node *node, int indent)
 {
     print_indent(p, indent);
 
-    String renamed = rename_ident(node->EnumField.name->Ident.token.str, RENAME_TYPE, false, p.rename_map, p.conf, p.allocator);
-    gb_fprintf(p.out_file, "%.*s", LIT(renamed));
+    String renamed = rename_cached(p.renames, node->EnumField.name->Ident.token, RENAME_TYPE, false);
+    writer_printf(p.out, "%.*s", LIT(renamed));
     if (node->EnumField.value)
     {
-        gb_fprintf(p.out_file, " = ");
+        writer_printf(p.out, " = ");
         print_expr(p, node->EnumField.value, indent);
     }
 }
@@ -463,21 +462,21 @@ void _print_enum_field(Printer p, Node *node, Node *prev, int indent)
 {
     print_indent(p, indent);
 
-    String renamed = rename_ident(node->EnumField.name->Ident.token.str, RENAME_TYPE, false, p.rename_map, p.conf, p.allocator);
-    gb_fprintf(p.out_file, "%.*s :: ", LIT(renamed));
+    String renamed = rename_cached(p.renames, node->EnumField.name->Ident.token, RENAME_TYPE, false);
+    writer_printf(p.out, "%.*s :: ", LIT(renamed));
     if (node->EnumField.value)
     {
         print_expr(p, node->EnumField.value, indent);
     }
     else if (prev)
     {
-        String prev_renamed = rename_ident(prev->EnumField.name->Ident.token.str, RENAME_TYPE, false, p.rename_map, p.conf, p.allocator);
-        gb_fprintf(p.out_file, "%.*s", LIT(prev_renamed));
-        gb_fprintf(p.out_file, " + 1");
+        String prev_renamed = rename_cached(p.renames, prev->EnumField.name->Ident.token, RENAME_TYPE, false);
+        writer_printf(p.out, "%.*s", LIT(prev_renamed));
+        writer_printf(p.out, " + 1");
     }
     else
     {
-        gb_fprintf(p.out_file, "0");
+        writer_printf(p.out, "0");
     }
 }
 
@@ -488,20 +487,20 @@ void print_enum(Printer p, Node *node, int indent, b32 top_level, b32 indent_fir
 
     if (node->EnumType.name)
     {
-        String renamed = rename_ident(node->EnumType.name->Ident.token.str, RENAME_TYPE, true, p.rename_map, p.conf, p.allocator);
+        String renamed = rename_cached(p.renames, node->EnumType.name->Ident.token, RENAME_TYPE, true);
         if (top_level && node->EnumType.fields)
         {
-            gb_fprintf(p.out_file, "/* %.*s :: enum { */\n%.*s :: _c.int;\n", LIT(renamed), LIT(renamed));
+            writer_printf(p.out, "/* %.*s :: enum { */\n%.*s :: _c.int;\n", LIT(renamed), LIT(renamed));
         }
         else if (!node->EnumType.fields)
         {
-            gb_fprintf(p.out_file, "%.*s", LIT(renamed));
+            writer_printf(p.out, "%.*s", LIT(renamed));
             return;
         }
     }
     else if (top_level)
     {
-        gb_fprintf(p.out_file, "/* using _ :: enum  { */\n");
+        writer_printf(p.out, "/* using _ :: enum  { */\n");
     }
 
     if (node->EnumType.fields)
@@ -511,11 +510,11 @@ void print_enum(Printer p, Node *node, int indent, b32 top_level, b32 indent_fir
         for (int i = 0; i < gb_array_count(fields); i++)
         {
             _print_enum_field(p, fields[i], i>0?fields[i-1]:0, indent+1);
-            gb_fprintf(p.out_file, ";\n");
+            writer_printf(p.out, ";\n");
         }
     }
 
-    gb_fprintf(p.out_file, "/* } */\n");
+    writer_printf(p.out, "/* } */\n");
 }
 /*
 void print_enum(Printer p, Node *node, int indent, b32 top_level, b32 indent_first)
@@ -525,37 +524,37 @@ void print_enum(Printer p, Node *node, int indent, b32 top_level, b32 indent_fir
 
     if (node->EnumType.name)
     {
-        String renamed = rename_ident(node->EnumType.name->Ident.token.str, RENAME_TYPE, true, p.rename_map, p.conf, p.allocator);
+        String renamed = rename_cached(p.renames, node->EnumType.name->Ident.token, RENAME_TYPE, true);
         if (top_level)
         {
-            gb_fprintf(p.out_file, "using %.*s :: ", LIT(renamed));
+            writer_printf(p.out, "using %.*s :: ", LIT(renamed));
         }
         else if (!node->EnumType.fields)
         {
-            gb_fprintf(p.out_file, "%.*s", LIT(renamed));
+            writer_printf(p.out, "%.*s", LIT(renamed));
             return;
         }
     }
     else if (top_level)
     {
-        gb_fprintf(p.out_file, "using _ ::");
+        writer_printf(p.out, "using _ ::");
     }
 
-    gb_fprintf(p.out_file, "enum {");
+    writer_printf(p.out, "enum {");
     if (node->EnumType.fields)
     {
         gbArray(Node *) fields = node->EnumType.fields->EnumFieldList.fields;
 
-        gb_fprintf(p.out_file, "\n");
+        writer_printf(p.out, "\n");
         for (int i = 0; i < gb_array_count(fields); i++)
         {
             print_enum_field(p, fields[i], indent+1);
-            gb_fprintf(p.out_file, ",\n");
+            writer_printf(p.out, ",\n");
         }
     }
 
     print_indent(p, indent);
-    gb_fprintf(p.out_file, "}");
+    writer_printf(p.out, "}");
 }
 */
 void print_record(Printer p, Node *node, int indent, b32 top_level, b32 indent_first)
@@ -565,14 +564,14 @@ void print_record(Printer p, Node *node, int indent, b32 top_level, b32 indent_f
 
     if (node->StructType.name)
     {
-        String renamed = rename_ident(node->StructType.name->Ident.token.str, RENAME_TYPE, true, p.rename_map, p.conf, p.allocator);
+        String renamed = rename_cached(p.renames, node->StructType.name->Ident.token, RENAME_TYPE, true);
         if (top_level)
         {
-            gb_fprintf(p.out_file, "%.*s :: ", LIT(renamed));
+            writer_printf(p.out, "%.*s :: ", LIT(renamed));
         }
         else if (!node->StructType.fields)
         {
-            gb_fprintf(p.out_file, "%.*s", LIT(renamed));
+            writer_printf(p.out, "%.*s", LIT(renamed));
             return;
         }
     }
@@ -586,27 +585,27 @@ void print_record(Printer p, Node *node, int indent, b32 top_level, b32 indent_f
     {
         case Token_struct:
             if (node->StructType.has_bitfield && node->StructType.only_bitfield)
-                gb_fprintf(p.out_file, "bit_field");
+                writer_printf(p.out, "bit_field");
             else
-                gb_fprintf(p.out_file, "struct");
+                writer_printf(p.out, "struct");
             break;
         case Token_union:
-            gb_fprintf(p.out_file, "struct #raw_union");
+            writer_printf(p.out, "struct #raw_union");
             break;
         default: break;
     }
 
-    gb_fprintf(p.out_file, " {");
+    writer_printf(p.out, " {");
     if (node->StructType.fields)
     {
-        gb_fprintf(p.out_file, "\n");
+        writer_printf(p.out, "\n");
 
         gbArray(Node *) fields = node->StructType.fields->VarDeclList.list;
         int field_padding = 0;
         for (int i = 0; i < gb_array_count(fields); i++)
         {
             if (!fields[i]->VarDecl.name) continue;
-            String rename_temp = rename_ident(fields[i]->VarDecl.name->Ident.token.str, RENAME_VAR, false, p.rename_map, p.conf, p.allocator);
+            String rename_temp = rename_cached(p.renames, fields[i]->VarDecl.name->Ident.token, RENAME_VAR, false);
             field_padding = gb_max(field_padding, rename_temp.len);
         }
 
@@ -618,7 +617,7 @@ void print_record(Printer p, Node *node, int indent, b32 top_level, b32 indent_f
               if (!in_bitfield && fields[i]->VarDecl.type->kind == NodeKind_BitfieldType)
               {
                 print_indent(p, indent+1);
-                gb_fprintf(p.out_file, "using _ : bit_field {\n");
+                writer_printf(p.out, "using _ : bit_field {\n");
                 in_bitfield = true;
                 indent += 1;
               }
@@ -626,23 +625,23 @@ void print_record(Printer p, Node *node, int indent, b32 top_level, b32 indent_f
               {
                 indent -= 1;
                 print_indent(p, indent+1);
-                gb_fprintf(p.out_file, "},\n");
+                writer_printf(p.out, "},\n");
                 in_bitfield = false;
               }
             }
             print_variable(p, fields[i], indent+1, false, field_padding);
-            gb_fprintf(p.out_file, ",\n");
+            writer_printf(p.out, ",\n");
         }
         if (in_bitfield)
         {
             indent -= 1;
             print_indent(p, indent+1);
-            gb_fprintf(p.out_file, "},\n");
+            writer_printf(p.out, "},\n");
         }
     }
 
     print_indent(p, indent);
-    gb_fprintf(p.out_file, "}");
+    writer_printf(p.out, "}");
 }
 
 void print_function_parameters(Printer p, Node *node, int indent)
@@ -676,12 +675,12 @@ void print_function_parameters(Printer p, Node *node, int indent)
                 print_type(p, params[i]->VarDecl.type, indent);
             break;
             case VarDecl_VaArgs:
-            gb_fprintf(p.out_file, "#c_vararg %s..any", use_param_names?"__args : ":0);
+            writer_printf(p.out, "#c_vararg %s..any", use_param_names?"__args : ":0);
             break;
             default: break;
         }
         if (i != gb_array_count(params) - 1)
-            gb_fprintf(p.out_file, ", ");
+            writer_printf(p.out, ", ");
     }
 }
 
@@ -689,43 +688,41 @@ void print_function(Printer p, Node *node, int indent)
 {
     print_indent(p, indent);
     String name    = node->FunctionDecl.name->Ident.token.str;
-    String renamed = rename_ident(name, RENAME_PROC, true, p.rename_map, p.conf, p.allocator);
+    String renamed = rename_cached(p.renames, node->FunctionDecl.name->Ident.token, RENAME_PROC, true);
 
     int name_padding = p.proc_name_padding;
     if (p.conf->proc_case || (p.conf->proc_prefix.len && !has_prefix(name, p.conf->proc_prefix)))
     {
         if (!p.conf->proc_case)
             name_padding -= 16 + p.proc_link_padding;
-        char *link_name_padding = repeat_char(' ', p.proc_link_padding - name.len,    p.allocator);
-        gb_fprintf(p.out_file, "@(link_name=\"%.*s\")%s ",
-                   LIT(name),    link_name_padding);
-        gb_free(p.allocator, link_name_padding);
+        writer_printf(p.out, "@(link_name=\"%.*s\")", LIT(name));
+        writer_spaces(p.out, p.proc_link_padding - name.len);
+        writer_printf(p.out, " ");
     }
 
-    char *proc_name_padding = repeat_char(' ', name_padding - renamed.len, p.allocator);
-    gb_fprintf(p.out_file, "%.*s%s :: ",
-               LIT(renamed), proc_name_padding);
-    gb_free(p.allocator, proc_name_padding);
+    writer_string(p.out, renamed);
+    writer_spaces(p.out, name_padding - renamed.len);
+    writer_printf(p.out, " :: ");
 
-    gb_fprintf(p.out_file, "proc");
+    writer_printf(p.out, "proc");
     print_calling_convention(p, node->FunctionDecl.type->FunctionType.calling_convention);
-    gb_fprintf(p.out_file, "(");
+    writer_printf(p.out, "(");
 
     if (node->FunctionDecl.type->FunctionType.params)
         print_function_parameters(p, node->FunctionDecl.type->FunctionType.params, 0);
 
-    gb_fprintf(p.out_file, ")");
+    writer_printf(p.out, ")");
 
     TypeInfo info = get_type_info(node->FunctionDecl.type->FunctionType.ret_type);
     b32 returns_void = info.stars == 0 && !info.is_array
         && info.base_type->kind == NodeKind_Ident && cstring_cmp(info.base_type->Ident.token.str, "void") == 0;
     if (!returns_void)
     {
-        gb_fprintf(p.out_file, " -> ");
+        writer_printf(p.out, " -> ");
         print_type(p, node->FunctionDecl.type->FunctionType.ret_type, 0);
     }
 
-    gb_fprintf(p.out_file, " --- ");
+    writer_printf(p.out, " --- ");
 }
 
 void print_typedef(Printer p, Node *node, int indent)
@@ -738,19 +735,19 @@ void print_typedef(Printer p, Node *node, int indent)
     {
         if (defs[i]->no_print) continue;
 
-        renamed = rename_ident(defs[i]->VarDecl.name->Ident.token.str, RENAME_TYPE, true, p.rename_map, p.conf, p.allocator);
+        renamed = rename_cached(p.renames, defs[i]->VarDecl.name->Ident.token, RENAME_TYPE, true);
         if ((defs[i]->VarDecl.type->kind == NodeKind_StructType
              || defs[i]->VarDecl.type->kind == NodeKind_UnionType
              || defs[i]->VarDecl.type->kind == NodeKind_EnumType)
             && defs[i]->VarDecl.type->StructType.name
             && !defs[i]->VarDecl.type->StructType.fields)
         {
-            String record_renamed = rename_ident(defs[i]->VarDecl.type->StructType.name->Ident.token.str, RENAME_TYPE, true, p.rename_map, p.conf, p.allocator);
+            String record_renamed = rename_cached(p.renames, defs[i]->VarDecl.type->StructType.name->Ident.token, RENAME_TYPE, true);
             if (string_cmp(record_renamed, renamed) == 0)
             {
                 print_record(p, defs[i]->VarDecl.type, 0, true, true);
                 if (i+1 < gb_array_count(defs))
-                    gb_fprintf(p.out_file, ";\n\n");
+                    writer_printf(p.out, ";\n\n");
                 continue;
             }
         }
@@ -758,35 +755,35 @@ void print_typedef(Printer p, Node *node, int indent)
         if (defs[i]->VarDecl.type->kind == NodeKind_EnumType)
         {
             if (!defs[i]->VarDecl.type->EnumType.fields)
-                gb_fprintf(p.out_file, "%.*s :: ", LIT(defs[i]->VarDecl.name->Ident.token.str));
+                writer_printf(p.out, "%.*s :: ", LIT(defs[i]->VarDecl.name->Ident.token.str));
             else if (!defs[i]->VarDecl.type->EnumType.name)
                 defs[i]->VarDecl.type->EnumType.name = defs[i]->VarDecl.name;
 
             print_enum(p, defs[i]->VarDecl.type, indent, true, false);
             if (!defs[i]->VarDecl.type->EnumType.fields && i+1 < gb_array_count(defs))
-                gb_fprintf(p.out_file, ";\n");
+                writer_printf(p.out, ";\n");
         }
         else
         {
-            gb_fprintf(p.out_file, "%.*s :: %s",
+            writer_printf(p.out, "%.*s :: %s",
                        LIT(renamed),
                        defs[i]->VarDecl.type->kind == NodeKind_FunctionType?"#type ":"");
 
             print_type(p, defs[i]->VarDecl.type, indent);
             if (i+1 < gb_array_count(defs))
-                gb_fprintf(p.out_file, ";\n");
+                writer_printf(p.out, ";\n");
         }
 
 
     }
-    gb_fprintf(p.out_file, ";\n\n");
+    writer_printf(p.out, ";\n\n");
 
 }
 
 void print_string(Printer p, String str, int indent)
 {
     print_indent(p, indent);
-    gb_fprintf(p.out_file, "%.*s", LIT(str));
+    writer_printf(p.out, "%.*s", LIT(str));
 }
 
 void print_node(Printer p, Node *node, int indent, b32 top_level, b32 indent_first)
@@ -801,12 +798,12 @@ void print_node(Printer p, Node *node, int indent, b32 top_level, b32 indent_fir
 
         case NodeKind_FunctionDecl:
         print_function(p, node, indent_first?indent:0);
-        gb_fprintf(p.out_file, ";\n%s", p.source_order?"\n":"");
+        writer_printf(p.out, ";\n%s", p.source_order?"\n":"");
         break;
 
         case NodeKind_VarDecl:
         print_variable(p, node, indent, top_level, 0);
-        if (top_level) gb_fprintf(p.out_file, ";\n%s", p.source_order?"\n":"");
+        if (top_level) writer_printf(p.out, ";\n%s", p.source_order?"\n":"");
         break;
 
         case NodeKind_StructType:
@@ -817,7 +814,7 @@ void print_node(Printer p, Node *node, int indent, b32 top_level, b32 indent_fir
             print_enum(p, node, indent, top_level, indent_first);
         else
             print_record(p, node, indent, top_level, indent_first);
-        if (top_level) gb_fprintf(p.out_file, ";\n\n");
+        if (top_level) writer_printf(p.out, ";\n\n");
         break;
 
         case NodeKind_Typedef: {
@@ -828,10 +825,10 @@ void print_node(Printer p, Node *node, int indent, b32 top_level, b32 indent_fir
                     print_enum(p, info.base_type, 0, true, true);
                 else
                     print_record(p, info.base_type, 0, true, true);
-                gb_fprintf(p.out_file, ";\n\n");
+                writer_printf(p.out, ";\n\n");
             }
             print_typedef(p, node, indent);
-            //gb_fprintf(p.out_file, ";\n\n");
+            //writer_printf(p.out, ";\n\n");
         } break;
 
         default:
@@ -844,9 +841,9 @@ void print_define(Printer p, Node *def)
 {
     // if (def->Define.value->kind == NodeKind_Invalid || def->Define.value->kind == NodeKind_SelectorExpr) return;
     String renamed = rename_ident(def->Define.name, RENAME_CONST, true, p.rename_map, p.conf, p.allocator);
-    gb_fprintf(p.out_file, "%.*s :: ", LIT(renamed));
+    writer_printf(p.out, "%.*s :: ", LIT(renamed));
     print_expr(p, def->Define.value, 0);
-    gb_fprintf(p.out_file, ";\n");
+    writer_printf(p.out, ";\n");
 }
 
 b32 _node_in_whitelist(Printer p, Node *node)
@@ -854,36 +851,34 @@ b32 _node_in_whitelist(Printer p, Node *node)
     // gb_printf("%.*s == %s?\n", LIT(node_token(node)->loc.file), p.file.filename);
 
     return has_substring(make_string(p.file.filename), p.conf->whitelist)
-        || cstring_cmp(node_token(node)->loc.file, p.file.filename) == 0;
+        || cstring_cmp(file_name(node_token(node)->loc.file), p.file.filename) == 0;
 }
 
-void print_lib_variables(Printer p, Lib lib)
+void print_lib_variables(Printer p, Lib lib, Lib_Decls decls)
 {
     String rename_temp;
     b32 found = false;
-    for (int i = 0; i < gb_array_count(p.file.variables); i++)
+    for (int i = 0; i < gb_array_count(decls.variables); i++)
     {
-        if (p.conf->shallow_bind && !_node_in_whitelist(p, p.file.variables[i])) continue;
-        if (!hashmap_exists(lib.symbols, p.file.variables[i]->VarDecl.name->Ident.token.str)) continue;
+        if (p.conf->shallow_bind && !_node_in_whitelist(p, decls.variables[i])) continue;
 
         found = true;
-        if (p.conf->var_case || (p.conf->var_prefix.len && !has_prefix(p.file.variables[i]->VarDecl.name->Ident.token.str, p.conf->var_prefix)))
-            p.var_link_padding = gb_max(p.var_link_padding, p.file.variables[i]->VarDecl.name->Ident.token.str.len);
-        rename_temp = rename_ident(p.file.variables[i]->VarDecl.name->Ident.token.str, RENAME_VAR, true, p.rename_map, p.conf, p.allocator);
+        if (p.conf->var_case || (p.conf->var_prefix.len && !has_prefix(decls.variables[i]->VarDecl.name->Ident.token.str, p.conf->var_prefix)))
+            p.var_link_padding = gb_max(p.var_link_padding, decls.variables[i]->VarDecl.name->Ident.token.str.len);
+        rename_temp = rename_cached(p.renames, decls.variables[i]->VarDecl.name->Ident.token, RENAME_VAR, true);
         p.var_name_padding = gb_max(p.var_name_padding, rename_temp.len);
     }
     if (!found) return;
 
     if (p.conf->var_prefix.start && !p.conf->var_case)
-        gb_fprintf(p.out_file, "@(link_prefix=\"%.*s\")\n", LIT(p.conf->var_prefix));
-    gb_fprintf(p.out_file, "foreign %.*s {\n", LIT(lib.name));
-    for (int i = 0; i < gb_array_count(p.file.variables); i++)
+        writer_printf(p.out, "@(link_prefix=\"%.*s\")\n", LIT(p.conf->var_prefix));
+    writer_printf(p.out, "foreign %.*s {\n", LIT(lib.name));
+    for (int i = 0; i < gb_array_count(decls.variables); i++)
     {
-        if (p.conf->shallow_bind && !_node_in_whitelist(p, p.file.variables[i])) continue;
-        if (!hashmap_exists(lib.symbols, p.file.variables[i]->VarDecl.name->Ident.token.str)) continue;
-        print_node(p, p.file.variables[i], 1, true, true);
+        if (p.conf->shallow_bind && !_node_in_whitelist(p, decls.variables[i])) continue;
+        print_node(p, decls.variables[i], 1, true, true);
     }
-    gb_fprintf(p.out_file, "}\n\n");
+    writer_printf(p.out, "}\n\n");
 }
 
 void print_all_variables(Printer p)
@@ -897,53 +892,51 @@ void print_all_variables(Printer p)
         found = true;
         if (p.conf->var_case || (p.conf->var_prefix.len && !has_prefix(p.file.variables[i]->VarDecl.name->Ident.token.str, p.conf->var_prefix)))
             p.var_link_padding = gb_max(p.var_link_padding, p.file.variables[i]->VarDecl.name->Ident.token.str.len);
-        rename_temp = rename_ident(p.file.variables[i]->VarDecl.name->Ident.token.str, RENAME_VAR, true, p.rename_map, p.conf, p.allocator);
+        rename_temp = rename_cached(p.renames, p.file.variables[i]->VarDecl.name->Ident.token, RENAME_VAR, true);
         p.var_name_padding = gb_max(p.var_name_padding, rename_temp.len);
     }
     if (!found) return;
 
     if (p.conf->var_prefix.start && !p.conf->var_case)
-        gb_fprintf(p.out_file, "@(link_prefix=\"%.*s\")\n", LIT(p.conf->var_prefix));
-    gb_fprintf(p.out_file, "foreign {\n");
+        writer_printf(p.out, "@(link_prefix=\"%.*s\")\n", LIT(p.conf->var_prefix));
+    writer_printf(p.out, "foreign {\n");
     for (int i = 0; i < gb_array_count(p.file.variables); i++)
     {
         if (p.conf->shallow_bind && !_node_in_whitelist(p, p.file.variables[i])) continue;
         print_node(p, p.file.variables[i], 1, true, true);
     }
-    gb_fprintf(p.out_file, "}\n\n");
+    writer_printf(p.out, "}\n\n");
 }
 
-void print_lib_procs(Printer p, Lib lib)
+void print_lib_procs(Printer p, Lib lib, Lib_Decls decls)
 {
     String rename_temp;
     b32 found = false;
-    for (int i = 0; i < gb_array_count(p.file.functions); i++)
+    for (int i = 0; i < gb_array_count(decls.functions); i++)
     {
-        if (p.conf->shallow_bind && !_node_in_whitelist(p, p.file.functions[i])) continue;
-        if (!hashmap_exists(lib.symbols, p.file.functions[i]->FunctionDecl.name->Ident.token.str)) continue;
+        if (p.conf->shallow_bind && !_node_in_whitelist(p, decls.functions[i])) continue;
         found = true;
 
-        rename_temp = rename_ident(p.file.functions[i]->FunctionDecl.name->Ident.token.str, RENAME_VAR, true, p.rename_map, p.conf, p.allocator);
+        rename_temp = rename_cached(p.renames, decls.functions[i]->FunctionDecl.name->Ident.token, RENAME_VAR, true);
         p.proc_name_padding = gb_max(p.proc_name_padding, rename_temp.len);
 
-        if (p.conf->proc_case || (p.conf->proc_prefix.len && !has_prefix(p.file.functions[i]->FunctionDecl.name->Ident.token.str, p.conf->proc_prefix)))
-            p.proc_link_padding = gb_max(p.proc_link_padding, p.file.functions[i]->FunctionDecl.name->Ident.token.str.len);
+        if (p.conf->proc_case || (p.conf->proc_prefix.len && !has_prefix(decls.functions[i]->FunctionDecl.name->Ident.token.str, p.conf->proc_prefix)))
+            p.proc_link_padding = gb_max(p.proc_link_padding, decls.functions[i]->FunctionDecl.name->Ident.token.str.len);
         else
             p.proc_name_padding = gb_max(p.proc_name_padding, rename_temp.len + p.proc_link_padding);
     }
     if (!found) return;
 
     if (p.conf->proc_prefix.start && !p.conf->proc_case)
-        gb_fprintf(p.out_file, "@(link_prefix=\"%.*s\")\n", LIT(p.conf->proc_prefix));
-    gb_fprintf(p.out_file, "foreign %.*s {\n", LIT(lib.name));
+        writer_printf(p.out, "@(link_prefix=\"%.*s\")\n", LIT(p.conf->proc_prefix));
+    writer_printf(p.out, "foreign %.*s {\n", LIT(lib.name));
 
-    for (int i = 0; i < gb_array_count(p.file.functions); i++)
+    for (int i = 0; i < gb_array_count(decls.functions); i++)
     {
-        if (p.conf->shallow_bind && _node_in_whitelist(p, p.file.functions[i])) continue;
-        if (!hashmap_exists(lib.symbols, p.file.functions[i]->FunctionDecl.name->Ident.token.str)) continue;
-        print_node(p, p.file.functions[i], 1, true, true);
+        if (p.conf->shallow_bind && _node_in_whitelist(p, decls.functions[i])) continue;
+        print_node(p, decls.functions[i], 1, true, true);
     }
-    gb_fprintf(p.out_file, "}\n\n");
+    writer_printf(p.out, "}\n\n");
 }
 
 void print_all_procs(Printer p)
@@ -955,7 +948,7 @@ void print_all_procs(Printer p)
         if (p.conf->shallow_bind && !_node_in_whitelist(p, p.file.functions[i])) continue;
         found = true;
 
-        rename_temp = rename_ident(p.file.functions[i]->FunctionDecl.name->Ident.token.str, RENAME_VAR, true, p.rename_map, p.conf, p.allocator);
+        rename_temp = rename_cached(p.renames, p.file.functions[i]->FunctionDecl.name->Ident.token, RENAME_VAR, true);
         p.proc_name_padding = gb_max(p.proc_name_padding, rename_temp.len);
 
         if (p.conf->proc_case || (p.conf->proc_prefix.len && !has_prefix(p.file.functions[i]->FunctionDecl.name->Ident.token.str, p.conf->proc_prefix)))
@@ -966,23 +959,23 @@ void print_all_procs(Printer p)
     if (!found) return;
 
     if (p.conf->proc_prefix.start && !p.conf->proc_case)
-        gb_fprintf(p.out_file, "@(link_prefix=\"%.*s\")\n", LIT(p.conf->proc_prefix));
-    gb_fprintf(p.out_file, "foreign {\n");
+        writer_printf(p.out, "@(link_prefix=\"%.*s\")\n", LIT(p.conf->proc_prefix));
+    writer_printf(p.out, "foreign {\n");
 
     for (int i = 0; i < gb_array_count(p.file.functions); i++)
     {
         if (p.conf->shallow_bind && _node_in_whitelist(p, p.file.functions[i])) continue;
         print_node(p, p.file.functions[i], 1, true, true);
     }
-    gb_fprintf(p.out_file, "}\n\n");
+    writer_printf(p.out, "}\n\n");
 }
 
 void print_file(Printer p)
 {
-    gb_fprintf(p.out_file, "package %.*s\n\n", LIT(p.package.name));
+    writer_printf(p.out, "package %.*s\n\n", LIT(p.package.name));
     for (int i = 0; i < gb_array_count(p.package.libs); i++)
-        gb_fprintf(p.out_file, "foreign import %.*s \"system:%.*s\";\n", LIT(p.package.libs[i].name), LIT(p.package.libs[i].file));
-    gb_fprintf(p.out_file, "\nimport _c \"core:c\"\n\n");
+        writer_printf(p.out, "foreign import %.*s \"system:%.*s\";\n", LIT(p.package.libs[i].name), LIT(p.package.libs[i].file));
+    writer_printf(p.out, "\nimport _c \"core:c\"\n\n");
 
     if (p.source_order)
     {
@@ -990,7 +983,7 @@ void print_file(Printer p)
 //             if (!p.conf->shallow_bind || _node_in_whitelist(p, p.file.defines[i]))
 //                 print_define(p, p.file.defines[i]);
 
-        gb_fprintf(p.out_file, "\n");
+        writer_printf(p.out, "\n");
         for (int i = 0; i < gb_array_count(p.file.all_nodes); i++)
             if (!p.conf->shallow_bind || _node_in_whitelist(p, p.file.all_nodes[i]))
                 print_node(p, p.file.all_nodes[i], 0, true, true);
@@ -999,7 +992,7 @@ void print_file(Printer p)
     {
         if (gb_array_count(p.needs_opaque_def) > 0)
         {
-            gb_fprintf(p.out_file, "/* Opaque Types */\n");
+            writer_printf(p.out, "/* Opaque Types */\n");
             for (int i = 0; i < gb_array_count(p.needs_opaque_def); i++)
             {
                 Node *type = p.needs_opaque_def[i];
@@ -1007,20 +1000,20 @@ void print_file(Printer p)
                     print_enum(p, type, 0, true, true);
                 else
                     print_record(p, type, 0, true, true);
-                gb_fprintf(p.out_file, "\n");
+                writer_printf(p.out, "\n");
             }
         }
 
         if (gb_array_count(p.file.defines) > 0)
         {
-            gb_fprintf(p.out_file, "/* Defines */\n");
+            writer_printf(p.out, "/* Defines */\n");
             for (int i = 0; i < gb_array_count(p.file.defines); i++)
             {
                 if ((!p.conf->shallow_bind || _node_in_whitelist(p, p.file.defines[i]))
                     && !p.file.defines[i]->no_print)
                     print_define(p, p.file.defines[i]);
             }
-            gb_fprintf(p.out_file, "\n");
+            writer_printf(p.out, "\n");
         }
 
         int record_count = gb_array_count(p.file.records);
@@ -1047,25 +1040,25 @@ void print_file(Printer p)
 
         if (gb_array_count(p.file.variables) > 0)
         {
-            gb_fprintf(p.out_file, "/* Variables */\n");
+            writer_printf(p.out, "/* Variables */\n");
             if (!p.package.libs)
                 print_all_variables(p);
             else
             {
                 for (int i = 0; i < gb_array_count(p.package.libs); i++)
-                    print_lib_variables(p, p.package.libs[i]);
+                    print_lib_variables(p, p.package.libs[i], p.file.lib_decls[i]);
             }
         }
 
         if (gb_array_count(p.file.functions) > 0)
         {
-            gb_fprintf(p.out_file, "/* Procedures */\n");
+            writer_printf(p.out, "/* Procedures */\n");
             if (!p.package.libs)
                 print_all_procs(p);
             else
             {
                 for (int i = 0; i < gb_array_count(p.package.libs); i++)
-                    print_lib_procs(p, p.package.libs[i]);
+                    print_lib_procs(p, p.package.libs[i], p.file.lib_decls[i]);
             }
         }
     }
@@ -1073,20 +1066,23 @@ void print_file(Printer p)
 
 void print_wrapper(Printer p);
 
-void print_package(Printer p)
+int print_package(Printer p)
 {
+    int unchanged = 0;
     for (int i = 0; i < gb_array_count(p.package.files); i++)
     {
         p.file = p.package.files[i];
-        gbFile *out_file = gb_alloc_item(p.allocator, gbFile);
-
-        create_path_to_file(p.file.output_filename);
-        gb_file_create(out_file, p.file.output_filename);
+        Arena_Temp temp = arena_temp_begin(p.arena);
 
-        p.out_file = out_file;
+        // Rendered in memory first, so unchanged files keep their timestamps
+        Writer out = {0};
+        writer_init(&out, 0, p.allocator);
+        p.out = &out;
 
         print_file(p);
-        gb_file_close(p.out_file);
+        if (!write_file_if_changed(p.file.output_filename, out.buffer, out.len))
+            unchanged++;
+        arena_temp_end(temp);
 
         /* if (p.wrap_conf->do_wrap) */
         /* { */
@@ -1099,6 +1095,7 @@ void print_package(Printer p)
         /*     gb_file_close(p.out_file); */
         /* } */
     }
+    return unchanged;
 }
 
 Node *child_type(Node *type)
@@ -1,13 +1,13 @@
 #include "resolve.h"
 #include "ast.h"
 
-Resolver make_resolver(Package p, BindConfig *conf)
+Resolver make_resolver(Package p, BindConfig *conf, gbAllocator allocator)
 {
    Resolver r = {0};
 
    r.package = p;
 
-   r.allocator = gb_heap_allocator();
+   r.allocator = allocator;
 
    r.conf = conf;
 
@@ -148,7 +148,7 @@ void register_possible_opaque_record(Resolver *r, Node *tpdef)
        }
    }
    if (found_possible_opaque && !found_non_pointer)
-       hashmap_put(r->opaque_types, info.base_type->StructType.name->Ident.token.str, tpdef);
+       hashmap_put_hashed(r->opaque_types, ident_string(info.base_type->StructType.name->Ident.token), ident_hash(info.base_type->StructType.name->Ident.token), tpdef);
 }
 
 void register_proc(Resolver *r, Node *proc)
@@ -243,6 +243,52 @@ int hashmap_add_opaque(void *a, void *b)
    return 0;
 }
 
+b32 _lib_has_symbol(Lib lib, Token token)
+{
+   return hashmap_exists_hashed(lib.symbols, ident_string(token), ident_hash(token));
+}
+
+void assign_lib_declarations(Resolver *r, Ast_File *file)
+{
+   int lib_count = gb_array_count(r->package.libs);
+   gb_array_init_reserve(file->lib_decls, r->allocator, lib_count);
+   for (int l = 0; l < lib_count; l++)
+   {
+       Lib_Decls decls = {0};
+       gb_array_init(decls.functions, r->allocator);
+       gb_array_init(decls.variables, r->allocator);
+       gb_array_append(file->lib_decls, decls);
+   }
+
+     // A symbol exported by several libraries is listed under each of them
+   int unmatched = 0;
+   for (int i = 0; i < gb_array_count(file->functions); i++)
+   {
+       b32 found = false;
+       for (int l = 0; l < lib_count; l++)
+       {
+           if (!_lib_has_symbol(r->package.libs[l], file->functions[i]->FunctionDecl.name->Ident.token)) continue;
+           gb_array_append(file->lib_decls[l].functions, file->functions[i]);
+           found = true;
+       }
+       if (!found) unmatched++;
+   }
+   for (int i = 0; i < gb_array_count(file->variables); i++)
+   {
+       b32 found = false;
+       for (int l = 0; l < lib_count; l++)
+       {
+           if (!_lib_has_symbol(r->package.libs[l], file->variables[i]->VarDecl.name->Ident.token)) continue;
+           gb_array_append(file->lib_decls[l].variables, file->variables[i]);
+           found = true;
+       }
+       if (!found) unmatched++;
+   }
+
+   if (unmatched)
+       gb_printf_err("%s: \x1b[33mWarning:\x1b[0m %d declaration%s not found in any library\n", file->filename, unmatched, unmatched == 1 ? "" : "s");
+}
+
 void resolve_package(Resolver *r)
 {
      // Register necessary types
@@ -289,7 +335,7 @@ void resolve_package(Resolver *r)
                    || type->kind == NodeKind_EnumType)
                {
                    if (/*type->StructType.fields
-                       && */type->StructType.name && hashmap_exists(r->opaque_types, type->StructType.name->Ident.token.str))
+                       && */type->StructType.name && hashmap_exists_hashed(r->opaque_types, ident_string(type->StructType.name->Ident.token), ident_hash(type->StructType.name->Ident.token)))
                    {
                        hashmap_remove(r->opaque_types, type->StructType.name->Ident.token.str);
                    }
@@ -314,11 +360,11 @@ void resolve_package(Resolver *r)
                                      break;
                                }
 
-                               if (!hashmap_exists(r->rename_map, record->StructType.name->Ident.token.str))
+                               if (!hashmap_exists_hashed(r->rename_map, ident_string(record->StructType.name->Ident.token), ident_hash(record->StructType.name->Ident.token)))
                                {
                                    String *renamed = gb_alloc_item(r->allocator, String);
                                    *renamed = rename_ident(defs[j]->VarDecl.name->Ident.token.str, RENAME_TYPE, true, r->rename_map, r->conf, r->allocator);
-                                   hashmap_put(r->rename_map, record->StructType.name->Ident.token.str, renamed);
+                                   hashmap_put_hashed(r->rename_map, ident_string(record->StructType.name->Ident.token), ident_hash(record->StructType.name->Ident.token), renamed);
                                }
                                forward_decs[k]->no_print = true;
                            }
@@ -326,7 +372,7 @@ void resolve_package(Resolver *r)
                    }
                    if (type->StructType.name)
                    {
-                       if (!hashmap_exists(r->rename_map, type->StructType.name->Ident.token.str))
+                       if (!hashmap_exists_hashed(r->rename_map, ident_string(type->StructType.name->Ident.token), ident_hash(type->StructType.name->Ident.token)))
                        {
                            if (!type->StructType.fields)
                            {
@@ -337,7 +383,7 @@ void resolve_package(Resolver *r)
                            {
                                String *renamed = gb_alloc_item(r->allocator, String);
                                *renamed = rename_ident(defs[j]->VarDecl.name->Ident.token.str, RENAME_TYPE, true, r->rename_map, r->conf, r->allocator);
-                               hashmap_put(r->rename_map, type->StructType.name->Ident.token.str, renamed);
+                               hashmap_put_hashed(r->rename_map, ident_string(type->StructType.name->Ident.token), ident_hash(type->StructType.name->Ident.token), renamed);
                            }
                        }
                    }
@@ -360,18 +406,18 @@ void resolve_package(Resolver *r)
                {
                    forward_decs[j]->no_print = true;
                    if (forward_decs[j]->kind != NodeKind_VarDecl) continue;
-                   if (!hashmap_exists(r->rename_map, record.name->Ident.token.str))
+                   if (!hashmap_exists_hashed(r->rename_map, ident_string(record.name->Ident.token), ident_hash(record.name->Ident.token)))
                    {
                        String *renamed = gb_alloc_item(r->allocator, String);
                        *renamed = rename_ident(forward_decs[j]->VarDecl.name->Ident.token.str, RENAME_TYPE, true, r->rename_map, r->conf, r->allocator);
-                       hashmap_put(r->rename_map, record.name->Ident.token.str, renamed);
+                       hashmap_put_hashed(r->rename_map, ident_string(record.name->Ident.token), ident_hash(record.name->Ident.token), renamed);
                    }
 
                }
            }
 
              // If matches a possible opaque type, that type is not opaque. Remove it from the map
-           if (record.name && hashmap_exists(r->opaque_types, record.name->Ident.token.str))
+           if (record.name && hashmap_exists_hashed(r->opaque_types, ident_string(record.name->Ident.token), ident_hash(record.name->Ident.token)))
            {
                hashmap_remove(r->opaque_types, record.name->Ident.token.str);
            }
@@ -386,12 +432,18 @@ void resolve_package(Resolver *r)
    for (int i = 0; i < gb_array_count(r->rename_queue); i++)
    {
        Pair p = r->rename_queue[i];
-       if (!hashmap_exists(r->rename_map, p.a->Ident.token.str))
+       if (!hashmap_exists_hashed(r->rename_map, ident_string(p.a->Ident.token), ident_hash(p.a->Ident.token)))
        {
            String *renamed = gb_alloc_item(r->allocator, String);
            *renamed = rename_ident(p.b->Ident.token.str, RENAME_TYPE, true, r->rename_map, r->conf, r->allocator);
-           hashmap_put(r->rename_map, p.a->Ident.token.str, renamed);
+           hashmap_put_hashed(r->rename_map, ident_string(p.a->Ident.token), ident_hash(p.a->Ident.token), renamed);
        }
    }
    hashmap_iterate(r->opaque_types, hashmap_add_opaque, r);
+
+   if (r->package.libs)
+   {
+       for (int fi = 0; fi < gb_array_count(r->package.files); fi++)
+           assign_lib_declarations(r, &r->package.files[fi]);
+   }
 }
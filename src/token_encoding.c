@@ -0,0 +1,231 @@
+#include "token_encoding.h"
+
+#define ID_TABLE_INITIAL_SIZE 1024
+
+void id_table_resize(Id_Table *table, u32 size)
+{
+    Id_Entry *entries = table->entries;
+    u32 old_size = table->entries ? table->mask+1 : 0;
+
+    table->entries = gb_alloc_array(table->allocator, Id_Entry, size);
+    gb_zero_array(table->entries, size);
+    table->mask = size-1;
+    table->count = 0;
+    for (u32 i = 0; i < old_size; i++)
+    {
+        if (entries[i].key)
+            *id_table_get(table, entries[i].key) = entries[i].value;
+    }
+    if (entries)
+        gb_free(table->allocator, entries);
+}
+
+void id_table_init(Id_Table *table, gbAllocator a)
+{
+    gb_zero_item(table);
+    table->allocator = a;
+    id_table_resize(table, ID_TABLE_INITIAL_SIZE);
+}
+
+void id_table_reserve(Id_Table *table, u32 count)
+{
+    u64 size = table->mask+1;
+    while ((u64)count*2 > size)
+        size *= 2;
+    if (size != table->mask+1)
+        id_table_resize(table, (u32)size);
+}
+
+u32 *id_table_get(Id_Table *table, u64 key)
+{
+    u32 pos = (u32)((key * 0x9e3779b97f4a7c15ull) >> 32) & table->mask;
+    for (;;)
+    {
+        Id_Entry *entry = &table->entries[pos];
+        if (entry->key == key)
+            return &entry->value;
+        if (!entry->key)
+            break;
+        pos = (pos+1) & table->mask;
+    }
+
+    // Kept at most half full
+    if ((table->count+1)*2 > table->mask+1)
+    {
+        id_table_resize(table, (table->mask+1)*2);
+        return id_table_get(table, key);
+    }
+    table->count++;
+    table->entries[pos] = (Id_Entry){key, 0};
+    return &table->entries[pos].value;
+}
+
+void token_encoder_init(Token_Encoder *e, gbAllocator a)
+{
+    gb_zero_item(e);
+    gb_array_init(e->strings, a);
+    e->string_offsets = hashmap_new(a);
+    gb_array_init(e->files, a);
+    id_table_init(&e->file_indices, a);
+    gb_array_init(e->origins, a);
+    gb_array_init(e->idents, a);
+    id_table_init(&e->ident_indices, a);
+
+    // Index 0 is reserved for "none" in every table
+    gb_array_append(e->files, ((Encoded_String){ENCODED_NULL, 0}));
+    gb_array_append(e->origins, ((Encoded_Origin){0}));
+    gb_array_append(e->idents, ((Encoded_String){ENCODED_NULL, 0}));
+}
+
+Encoded_String encode_string(Token_Encoder *e, String str)
+{
+    if (!str.start)
+        return (Encoded_String){ENCODED_NULL, 0};
+
+    void *offset;
+    if (hashmap_get(e->string_offsets, str, &offset) == MAP_OK)
+        return (Encoded_String){(u32)(uintptr)offset-1, str.len};
+
+    u32 start = gb_array_count(e->strings);
+    encoded_appendv(e->strings, str.start, str.len);
+    hashmap_put(e->string_offsets, str, (void *)(uintptr)(start+1));
+    return (Encoded_String){start, str.len};
+}
+
+u32 encode_file(Token_Encoder *e, u32 file)
+{
+    if (!file)
+        return 0;
+    // Tokens mostly follow others from the same file
+    if (file == e->last_file)
+        return e->last_file_index;
+    e->last_file = file;
+    u32 *index = id_table_get(&e->file_indices, file);
+    if (!*index)
+    {
+        *index = gb_array_count(e->files);
+        gb_array_append(e->files, encode_string(e, file_name(file)));
+    }
+    e->last_file_index = *index;
+    return *index;
+}
+
+u32 encode_ident(Token_Encoder *e, u32 ident)
+{
+    if (!ident)
+        return 0;
+    u32 *index = id_table_get(&e->ident_indices, ident);
+    if (!*index)
+    {
+        *index = gb_array_count(e->idents);
+        gb_array_append(e->idents, encode_string(e, interned_string(ident)));
+    }
+    return *index;
+}
+
+Token encode_token(Token_Encoder *e, Token tok)
+{
+    // Identifiers are spelled like their interned name, which is encoded once
+    tok.ident = encode_ident(e, tok.ident);
+    Encoded_String str = tok.ident && (isize)e->idents[tok.ident].len == tok.str.len
+                       ? e->idents[tok.ident] : encode_string(e, tok.str);
+    tok.str.start = str.offset == ENCODED_NULL ? 0 : (char *)(uintptr)(str.offset+1);
+    tok.loc.file = encode_file(e, tok.loc.file);
+
+    // Tokens written from the same context follow each other and share their origin
+    if (tok.origin)
+    {
+        if (tok.origin != e->last_origin)
+        {
+            File_Location from = token_origin(tok);
+            Encoded_Origin origin = {encode_file(e, from.file), from.line, from.column};
+            gb_array_append(e->origins, origin);
+            e->last_origin = tok.origin;
+        }
+        tok.origin = gb_array_count(e->origins)-1;
+    }
+    return tok;
+}
+
+void write_section(Writer *out, void const *data, isize size)
+{
+    writer_write(out, data, size);
+    isize pad = ((out->len + 7) & ~(isize)7) - out->len;
+    u64 zero = 0;
+    writer_write(out, &zero, pad);
+}
+
+void write_token_tables(Token_Encoder *e, Writer *out, Token_Tables *tables)
+{
+    tables->string_size = gb_array_count(e->strings);
+    tables->file_count = gb_array_count(e->files);
+    tables->origin_count = gb_array_count(e->origins);
+    tables->ident_count = gb_array_count(e->idents);
+
+    write_section(out, e->files, tables->file_count*gb_size_of(Encoded_String));
+    write_section(out, e->origins, tables->origin_count*gb_size_of(Encoded_Origin));
+    write_section(out, e->idents, tables->ident_count*gb_size_of(Encoded_String));
+    write_section(out, e->strings, tables->string_size);
+}
+
+void *read_section(gbFileContents data, isize *offset, isize count, isize record_size)
+{
+    isize start = *offset;
+    isize size = count*record_size;
+    if (count < 0 || start + size > data.size)
+        return 0;
+    *offset = (start + size + 7) & ~(isize)7;
+    return (u8 *)data.data + start;
+}
+
+String decode_string(Token_Decoder *d, Encoded_String str)
+{
+    if (str.offset == ENCODED_NULL || str.offset + str.len > d->string_size)
+        return (String){0};
+    return (String){d->strings + str.offset, str.len};
+}
+
+b32 token_decoder_init(Token_Decoder *d, gbFileContents data, isize *offset, Token_Tables tables, gbAllocator a)
+{
+    gb_zero_item(d);
+    Encoded_String *files   = read_section(data, offset, tables.file_count, gb_size_of(Encoded_String));
+    Encoded_Origin *origins = read_section(data, offset, tables.origin_count, gb_size_of(Encoded_Origin));
+    Encoded_String *idents  = read_section(data, offset, tables.ident_count, gb_size_of(Encoded_String));
+    d->strings = read_section(data, offset, tables.string_size, 1);
+    d->string_size = tables.string_size;
+    if (!files || !origins || !idents || !d->strings)
+        return false;
+
+    d->file_count = tables.file_count;
+    d->origin_count = tables.origin_count;
+    d->ident_count = tables.ident_count;
+    d->files = gb_alloc_array(a, u32, tables.file_count);
+    for (u32 i = 0; i < tables.file_count; i++)
+        d->files[i] = i ? intern_file(decode_string(d, files[i])) : 0;
+
+    d->origins = gb_alloc_array(a, u32, tables.origin_count);
+    for (u32 i = 0; i < tables.origin_count; i++)
+    {
+        File_Location from = {origins[i].file < tables.file_count ? d->files[origins[i].file] : 0,
+                              origins[i].line, origins[i].column};
+        d->origins[i] = i ? add_token_origin(from) : 0;
+    }
+
+    d->idents = gb_alloc_array(a, u32, tables.ident_count);
+    for (u32 i = 0; i < tables.ident_count; i++)
+        d->idents[i] = i ? intern(decode_string(d, idents[i])) : 0;
+    return true;
+}
+
+b32 decode_token(Token_Decoder *d, Token *tok)
+{
+    uintptr offset = (uintptr)tok->str.start;
+    if (tok->loc.file >= d->file_count || tok->origin >= d->origin_count || tok->ident >= d->ident_count
+        || tok->str.len < 0 || (offset && (u64)offset-1 + tok->str.len > d->string_size))
+        return false;
+    tok->str.start = offset ? d->strings + offset-1 : 0;
+    tok->loc.file = d->files[tok->loc.file];
+    tok->origin = d->origins[tok->origin];
+    tok->ident = d->idents[tok->ident];
+    return true;
+}
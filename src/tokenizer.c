@@ -2,6 +2,347 @@
 
 #include "error.h"
 
+// Bulk scanning of whitespace, identifiers, comments and strings.
+// The vector width is picked at build time, AVX2 if the compiler targets it,
+// otherwise SSE2, otherwise only the byte loops are used.
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define SCAN_WIDTH 32
+    typedef __m256i Scan_Vec;
+    #define scan_load(p)  _mm256_loadu_si256((__m256i const *)(p))
+    #define scan_set(c)   _mm256_set1_epi8(c)
+    #define scan_eq(a, b) _mm256_cmpeq_epi8(a, b)
+    #define scan_gt(a, b) _mm256_cmpgt_epi8(a, b)
+    #define scan_or(a, b) _mm256_or_si256(a, b)
+    #define scan_and(a, b) _mm256_and_si256(a, b)
+    #define scan_mask(v)  ((u32)_mm256_movemask_epi8(v))
+    #define SCAN_FULL_MASK 0xffffffffu
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define SCAN_WIDTH 16
+    typedef __m128i Scan_Vec;
+    #define scan_load(p)  _mm_loadu_si128((__m128i const *)(p))
+    #define scan_set(c)   _mm_set1_epi8(c)
+    #define scan_eq(a, b) _mm_cmpeq_epi8(a, b)
+    #define scan_gt(a, b) _mm_cmpgt_epi8(a, b)
+    #define scan_or(a, b) _mm_or_si128(a, b)
+    #define scan_and(a, b) _mm_and_si128(a, b)
+    #define scan_mask(v)  ((u32)_mm_movemask_epi8(v))
+    #define SCAN_FULL_MASK 0xffffu
+#endif
+
+#if defined(SCAN_WIDTH)
+#if defined(_MSC_VER)
+#include <intrin.h>
+gb_inline u32 scan_first(u32 mask) { unsigned long i; _BitScanForward(&i, mask); return (u32)i; }
+gb_inline u32 scan_last(u32 mask)  { unsigned long i; _BitScanReverse(&i, mask); return (u32)i; }
+gb_inline u32 scan_count(u32 mask)
+{
+    mask = mask - ((mask >> 1) & 0x55555555);
+    mask = (mask & 0x33333333) + ((mask >> 2) & 0x33333333);
+    return (((mask + (mask >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+}
+#else
+gb_inline u32 scan_first(u32 mask) { return (u32)__builtin_ctz(mask); }
+gb_inline u32 scan_last(u32 mask)  { return 31 - (u32)__builtin_clz(mask); }
+gb_inline u32 scan_count(u32 mask) { return (u32)__builtin_popcount(mask); }
+#endif
+
+// Signed compares, so bytes >= 0x80 never fall in an ASCII range
+gb_inline Scan_Vec scan_in_range(Scan_Vec v, char lo, char hi)
+{
+    return scan_and(scan_gt(v, scan_set(lo-1)), scan_gt(scan_set(hi+1), v));
+}
+
+// Same set as `gb_char_is_space`, newlines included
+gb_inline u32 scan_space_mask(Scan_Vec v)
+{
+    return scan_mask(scan_or(scan_in_range(v, '\t', '\r'), scan_eq(v, scan_set(' '))));
+}
+
+gb_inline u32 scan_ident_mask(Scan_Vec v)
+{
+    Scan_Vec lower = scan_or(v, scan_set(0x20));
+    Scan_Vec ident = scan_or(scan_in_range(lower, 'a', 'z'), scan_in_range(v, '0', '9'));
+    ident = scan_or(ident, scan_or(scan_eq(v, scan_set('_')), scan_eq(v, scan_set('$'))));
+    return scan_mask(ident);
+}
+#endif
+
+// First character in [curr, end) that can't continue an identifier
+char *scan_ident(char *curr, char *end)
+{
+#if defined(SCAN_WIDTH)
+    while (end - curr >= SCAN_WIDTH)
+    {
+        u32 stop = ~scan_ident_mask(scan_load(curr)) & SCAN_FULL_MASK;
+        if (stop)
+            return curr + scan_first(stop);
+        curr += SCAN_WIDTH;
+    }
+#endif
+    while (curr < end && (gb_char_is_alphanumeric(curr[0]) || curr[0] == '_' || curr[0] == '$'))
+        curr++;
+    return curr;
+}
+
+// First character in [curr, end) that is one of `a`, `b`, `c` or '\0'
+char *scan_to_any(char *curr, char *end, char a, char b, char c)
+{
+#if defined(SCAN_WIDTH)
+    Scan_Vec va = scan_set(a), vb = scan_set(b), vc = scan_set(c), zero = scan_set(0);
+    while (end - curr >= SCAN_WIDTH)
+    {
+        Scan_Vec v = scan_load(curr);
+        u32 stop = scan_mask(scan_or(scan_or(scan_eq(v, va), scan_eq(v, vb)),
+                                     scan_or(scan_eq(v, vc), scan_eq(v, zero))));
+        if (stop)
+            return curr + scan_first(stop);
+        curr += SCAN_WIDTH;
+    }
+#endif
+    while (curr < end && curr[0] && curr[0] != a && curr[0] != b && curr[0] != c)
+        curr++;
+    return curr;
+}
+
+u8 keyword_table[KEYWORD_TABLE_SIZE] = {0};
+GB_STATIC_ASSERT(Token__KeywordEnd <= 255);
+
+gb_inline u32 keyword_hash(char *str, isize len)
+{
+    return (u32)(len*31 + str[0]*7 + str[len/2]*3 + str[len-1]) & (KEYWORD_TABLE_SIZE-1);
+}
+
+u32 directive_idents[DIRECTIVE_TABLE_SIZE] = {0};
+u8 directive_kinds[DIRECTIVE_TABLE_SIZE] = {0};
+GB_STATIC_ASSERT(Directive_Count*2 <= DIRECTIVE_TABLE_SIZE);
+
+gb_inline u32 directive_hash(u32 ident)
+{
+    return (ident * 0x9E3779B1u) >> 26;
+}
+
+void init_keyword_table(void)
+{
+    if (keyword_table[keyword_hash("int", 3)])
+        return;
+    for (int i = Token__KeywordBegin+1; i < Token__KeywordEnd; i++)
+    {
+        String kw = TokenKind_Strings[i];
+        u32 h = keyword_hash(kw.start, kw.len);
+        while (keyword_table[h])
+            h = (h+1) & (KEYWORD_TABLE_SIZE-1);
+        keyword_table[h] = (u8)i;
+    }
+
+    for (int i = Directive_None+1; i < Directive_Count; i++)
+    {
+        u32 ident = intern(Directive_Kind_Strings[i]);
+        u32 h = directive_hash(ident);
+        while (directive_idents[h])
+            h = (h+1) & (DIRECTIVE_TABLE_SIZE-1);
+        directive_idents[h] = ident;
+        directive_kinds[h] = (u8)i;
+    }
+}
+
+Directive_Kind directive_kind(u32 ident)
+{
+    if (!ident)
+        return Directive_None;
+    u32 h = directive_hash(ident);
+    for (;;)
+    {
+        if (directive_idents[h] == ident)
+            return (Directive_Kind)directive_kinds[h];
+        if (!directive_idents[h])
+            return Directive_None;
+        h = (h+1) & (DIRECTIVE_TABLE_SIZE-1);
+    }
+}
+
+// A `#` followed by a name is a directive wherever it is, the same way
+// `run_pp` sees them
+Directive_Index index_directives(gbArray(Token) tokens, gbAllocator allocator)
+{
+    Directive_Index index = {tokens, gb_array_count(tokens), 0};
+    gb_array_init(index.conds, allocator);
+
+    // Last directive of each open block
+    i32 open[256];
+    isize depth = 0;
+
+    for (isize i = 0; i+1 < index.token_count; i++)
+    {
+        if (tokens[i].kind != Token_Hash)
+            continue;
+        Directive_Kind kind = directive_kind(tokens[i+1].ident);
+        if (kind < Directive_if || kind > Directive_endif)
+            continue;
+
+        i32 id = (i32)gb_array_count(index.conds);
+        Cond_Directive cond = {(u32)i, kind, -1};
+        gb_array_append(index.conds, cond);
+
+        if (kind == Directive_if || kind == Directive_ifdef || kind == Directive_ifndef)
+        {
+            // Blocks nested deeper than that are left to the slow path
+            if (depth < gb_count_of(open))
+                open[depth] = id;
+            depth++;
+        }
+        else if (depth > 0)
+        {
+            if (depth <= gb_count_of(open))
+                index.conds[open[depth-1]].next = id;
+            if (kind == Directive_endif)
+                depth--;
+            else if (depth <= gb_count_of(open))
+                open[depth-1] = id;
+        }
+    }
+
+    return index;
+}
+
+// Position of the conditional starting at `hash` in the index, -1 if it
+// isn't one of them
+isize find_cond_directive(Directive_Index *index, Token *hash)
+{
+    isize pos = hash - index->tokens;
+    if (!index->conds || pos < 0 || pos >= index->token_count)
+        return -1;
+
+    isize lo = 0, hi = gb_array_count(index->conds);
+    while (lo < hi)
+    {
+        isize mid = lo + (hi-lo)/2;
+        if (index->conds[mid].hash < pos)
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    if (lo < gb_array_count(index->conds) && index->conds[lo].hash == pos)
+        return lo;
+    return -1;
+}
+
+TokenKind keyword_kind(String str)
+{
+    u32 h = keyword_hash(str.start, str.len);
+    for (;;)
+    {
+        TokenKind kind = (TokenKind)keyword_table[h];
+        if (!kind)
+            return Token_Ident;
+        if (TokenKind_Strings[kind].len == str.len
+            && gb_memcompare(TokenKind_Strings[kind].start, str.start, str.len) == 0)
+            return kind;
+        h = (h+1) & (KEYWORD_TABLE_SIZE-1);
+    }
+}
+
+Location_Table location_table = {0};
+
+// The chunk holding `index`, added if it is missing. Called with the lock held.
+void *location_chunk(void ***lists, u32 index, isize item_size)
+{
+    gbAllocator a = gb_heap_allocator();
+    u32 list = index >> (LOCATION_LIST_BITS + LOCATION_CHUNK_BITS);
+    u32 chunk = (index >> LOCATION_CHUNK_BITS) & (LOCATION_LIST_SIZE-1);
+    if (!lists[list])
+    {
+        lists[list] = gb_alloc_array(a, void *, LOCATION_LIST_SIZE);
+        gb_zero_array(lists[list], LOCATION_LIST_SIZE);
+    }
+    if (!lists[list][chunk])
+        lists[list][chunk] = gb_alloc(a, item_size*LOCATION_CHUNK_SIZE);
+    return lists[list][chunk];
+}
+
+#define LOCATION_ENTRY(lists_, index_) \
+    (lists_)[(index_) >> (LOCATION_LIST_BITS + LOCATION_CHUNK_BITS)] \
+            [((index_) >> LOCATION_CHUNK_BITS) & (LOCATION_LIST_SIZE-1)] \
+            [(index_) & (LOCATION_CHUNK_SIZE-1)]
+
+void init_location_table(void)
+{
+    if (location_table.file_ids)
+        return;
+    gb_mutex_init(&location_table.mutex);
+    location_table.file_ids = hashmap_new(gb_heap_allocator());
+
+    // Entry 0 of both tables means "none"
+    location_chunk((void ***)location_table.files, 0, gb_size_of(String));
+    location_table.file_count = 1;
+    location_chunk((void ***)location_table.origins, 0, gb_size_of(File_Location));
+    location_table.origin_count = 1;
+}
+
+u32 intern_file(String filename)
+{
+    init_location_table();
+    gbAllocator a = gb_heap_allocator();
+
+    gb_mutex_lock(&location_table.mutex);
+    void *id = 0;
+    if (hashmap_get(location_table.file_ids, filename, &id) != MAP_OK)
+    {
+        u32 index = location_table.file_count;
+        GB_ASSERT_MSG(index < U32_MAX, "Too many files");
+        String *chunk = location_chunk((void ***)location_table.files, index, gb_size_of(String));
+
+        String name = make_string_allocn(a, filename.start, filename.len);
+        chunk[index % LOCATION_CHUNK_SIZE] = name;
+        hashmap_put(location_table.file_ids, name, (void *)(uintptr)index);
+        location_table.file_count++;
+        id = (void *)(uintptr)index;
+    }
+    gb_mutex_unlock(&location_table.mutex);
+
+    return (u32)(uintptr)id;
+}
+
+String file_name(u32 file)
+{
+    if (!file)
+        return (String){0};
+    return LOCATION_ENTRY(location_table.files, file);
+}
+
+u32 add_token_origin(File_Location loc)
+{
+    init_location_table();
+
+    gb_mutex_lock(&location_table.mutex);
+    u32 index = location_table.origin_count;
+    GB_ASSERT_MSG(index < U32_MAX, "Too many token origins");
+    File_Location *chunk = location_chunk((void ***)location_table.origins, index, gb_size_of(File_Location));
+    chunk[index % LOCATION_CHUNK_SIZE] = loc;
+    location_table.origin_count++;
+    gb_mutex_unlock(&location_table.mutex);
+
+    return index;
+}
+
+File_Location token_origin(Token tok)
+{
+    if (!tok.origin)
+        return (File_Location){0};
+    return LOCATION_ENTRY(location_table.origins, tok.origin);
+}
+
+String ident_string(Token tok)
+{
+    return tok.ident ? interned_string(tok.ident) : tok.str;
+}
+
+u64 ident_hash(Token tok)
+{
+    return tok.ident ? interned_hash(tok.ident) : hashmap_hash(tok.str);
+}
+
 Tokenizer make_tokenizer(gbFileContents fc, String filename)
 {
     Tokenizer t;
@@ -10,7 +351,8 @@ Tokenizer make_tokenizer(gbFileContents fc, String filename)
     t.end = t.start + fc.size;
     t.line_start = t.start;
     t.line = 1;
-    t.file = filename;
+    t.file = intern_file(filename);
+    init_keyword_table();
     return t;
 }
 
@@ -27,6 +369,26 @@ b32 try_increment_line(Tokenizer *t)
 
 b32 skip_space(Tokenizer *t)
 {
+#if defined(SCAN_WIDTH)
+    // Skip whole blocks of whitespace, counting their newlines in bulk
+    while (t->end - t->curr >= SCAN_WIDTH)
+    {
+        Scan_Vec v = scan_load(t->curr);
+        u32 other = ~scan_space_mask(v) & SCAN_FULL_MASK;
+        u32 len = other ? scan_first(other) : SCAN_WIDTH;
+        u32 newlines = scan_mask(scan_eq(v, scan_set('\n')));
+        if (len < 32)
+            newlines &= (1u << len) - 1;
+        if (newlines)
+        {
+            t->line += scan_count(newlines);
+            t->line_start = t->curr + scan_last(newlines) + 1;
+        }
+        t->curr += len;
+        if (other)
+            break;
+    }
+#endif
     for (;;)
     {
         if (gb_char_is_space(t->curr[0]) && t->curr[0] != '\n')
@@ -53,10 +415,12 @@ Token tokenize_number(Tokenizer *t)
     Token token = {0};
     token.str.start = t->curr;
     token.kind = Token_Integer;
+    token.loc.file = t->file;
     token.loc.line = t->line;
     token.loc.column = token.str.start - t->line_start;
 
-    token.pp_loc = token.loc;
+    token.pp_loc.line = token.loc.line;
+    token.pp_loc.column = token.loc.column;
 
     int base = 10;
     if (t->curr[1] == 'x' || t->curr[1] == 'X')
@@ -104,7 +468,7 @@ Token tokenize_number(Tokenizer *t)
             else if (gb_strncmp(t->curr, "128", 3) == 0)
                 t->curr+=3;
             else
-                gb_printf_err("%.*s(%ld:%ld): ERROR: illegal literal suffix\n", LIT(token.loc.file), token.loc.line, token.loc.column);
+                gb_printf_err("%.*s(%d:%d): ERROR: illegal literal suffix\n", LIT(file_name(token.loc.file)), token.loc.line, token.loc.column);
         }
         t->curr++;
     }
@@ -135,18 +499,9 @@ Token get_token(Tokenizer *t)
     if (gb_char_is_alpha(c) || c == '_' || c == '$')
     {
         token.kind = Token_Ident;
-        while (gb_char_is_alphanumeric(t->curr[0]) || t->curr[0] == '_' || t->curr[0] == '$')
-            t->curr++;
+        t->curr = scan_ident(t->curr, t->end);
         token.str.len = t->curr - token.str.start;
-
-        for (int i = Token__KeywordBegin+1; i < Token__KeywordEnd; i++)
-        {
-            if (token.str.len == TokenKind_Strings[i].len && gb_strncmp(token.str.start, TokenKind_Strings[i].start, token.str.len) == 0)
-            {
-                token.kind = (TokenKind)i;
-                break;
-            }
-        }
+        token.kind = keyword_kind(token.str);
 
         // Not a Keyword
         if (token.kind == Token_Ident && cstring_cmp(token.str, "L") == 0)
@@ -179,6 +534,9 @@ Token get_token(Tokenizer *t)
                     t->curr++;
             }
         }
+
+        if (token.kind == Token_Ident || (token.kind > Token__KeywordBegin && token.kind < Token__KeywordEnd))
+            token.ident = intern(token.str);
     }
     else if (gb_char_is_digit(c))
     {
@@ -312,9 +670,12 @@ Token get_token(Tokenizer *t)
             token.kind = Token_String;
             token.str.start = t->curr;
 
-            while (t->curr[0] && t->curr[0] != '"')
+            for (;;)
             {
-                if (t->curr[0] == '\\' && t->curr[1])
+                t->curr = scan_to_any(t->curr, t->end, '"', '\\', '"');
+                if (t->curr[0] != '\\')
+                    break;
+                if (t->curr[1])
                     t->curr++;
                 t->curr++;
             }
@@ -334,8 +695,7 @@ Token get_token(Tokenizer *t)
 
                 token.str.start = t->curr;
                 token.kind = Token_Comment;
-                while (t->curr[0] && t->curr[0] != '\n' && t->curr <= t->end)
-                    t->curr++;
+                t->curr = scan_to_any(t->curr, t->end, '\n', '\n', '\n');
 
                 token.str.len = t->curr - token.str.start;
                 trim_space_from_end_of_token(&token);
@@ -350,6 +710,11 @@ Token get_token(Tokenizer *t)
                 token.kind = Token_Comment;
                 while (t->curr[0] && comment_scope > 0 && t->curr < t->end)
                 {
+                    // Jump to the next character that can matter
+                    t->curr = scan_to_any(t->curr, t->end, '/', '*', '\n');
+                    if (!t->curr[0] || t->curr >= t->end)
+                        break;
+
                     if (t->curr[0] == '/' && t->curr[1] == '*')
                         comment_scope++;
                     else if (t->curr[0] == '*' && t->curr[1] == '/')
@@ -434,6 +799,8 @@ Token *make_token(char *str, TokenKind kind)
     token->kind = kind;
     token->str.start = gb_alloc_str(gb_heap_allocator(), str);
     token->str.len = gb_strlen(str);
+    if (kind == Token_Ident)
+        token->ident = intern(token->str);
 
     return token;
 }
@@ -449,5 +816,7 @@ Token_Run str_make_token_run(String str, TokenKind kind)
     Token *token = gb_alloc_item(gb_heap_allocator(), Token);
     token->kind = kind;
     token->str = str;
+    if (kind == Token_Ident)
+        token->ident = intern(str);
     return (Token_Run){token, token, token};
 }
@@ -1,10 +1,13 @@
 #include "util.h"
 
 #include "error.h"
+#include "file_map.h"
 
 #ifdef GB_SYSTEM_WINDOWS
 # include "vs_find.h"
 # include <stdlib.h>
+#else
+# include <stdio.h> // rename
 #endif
 
 Token_Run alloc_token_run(Token *tokens, int count)
@@ -70,6 +73,43 @@ void create_path_to_file(char const *filename)
     }
 }
 
+b32 replace_file(char const *from, char const *to)
+{
+#ifdef GB_SYSTEM_WINDOWS
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+b32 write_file_if_changed(char const *filename, void const *data, isize len)
+{
+    gbFileContents old = map_file_contents(gb_heap_allocator(), filename);
+    b32 same = old.data ? old.size == len && gb_memcompare(old.data, data, len) == 0 : len == 0 && gb_file_exists(filename);
+    unmap_file_contents(&old);
+    if (same)
+        return false;
+
+    char temp[1024];
+    gb_snprintf(temp, gb_size_of(temp), "%s.tmp", filename);
+    create_path_to_file(filename);
+    gbFile file;
+    if (gb_file_create(&file, temp) != gbFileError_None)
+    {
+        gb_printf_err("\x1b[31mERROR:\x1b[0m Could not create file '%s'\n", temp);
+        gb_exit(1);
+    }
+    b32 ok = gb_file_write(&file, data, len);
+    gb_file_close(&file);
+    if (!ok || !replace_file(temp, filename))
+    {
+        gb_printf_err("\x1b[31mERROR:\x1b[0m Could not write file '%s'\n", filename);
+        gb_file_remove(temp);
+        gb_exit(1);
+    }
+    return true;
+}
+
 char *date_string(u64 time)
 {
     int month_days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
@@ -384,7 +424,7 @@ String integer_type_str(Node *type)
     return ret;
 }
 
-String convert_type(Node *type, map_t rename_map, BindConfig *conf, gbAllocator allocator)
+String convert_type(Node *type, Rename_Cache *renames, gbAllocator allocator)
 {
     char *result = 0;
     if (type->kind == NodeKind_Ident)
@@ -419,8 +459,7 @@ String convert_type(Node *type, map_t rename_map, BindConfig *conf, gbAllocator
             result = "_c.bool";
         else
         {
-            String renamed = rename_ident(ident, RENAME_TYPE, true, rename_map, conf, allocator);
-            return renamed;
+            return rename_cached(renames, type->Ident.token, RENAME_TYPE, true);
         }
     }
     else if (type->kind == NodeKind_IntegerType)
@@ -437,7 +476,7 @@ String convert_type(Node *type, map_t rename_map, BindConfig *conf, gbAllocator
     {
         String renamed = {0};
         if (type->StructType.name)
-            renamed = rename_ident(type->StructType.name->Ident.token.str, RENAME_TYPE, true, rename_map, conf, allocator);
+            renamed = rename_cached(renames, type->StructType.name->Ident.token, RENAME_TYPE, true);
         return renamed;
     }
 
@@ -517,6 +556,92 @@ String rename_ident(String orig, Rename_Kind r, b32 do_remove_prefix, map_t rena
     return cased;
 }
 
+#define RENAME_CACHE_INITIAL_SLOTS 1024
+
+Rename_Cache *make_rename_cache(map_t rename_map, BindConfig *conf)
+{
+    gbAllocator a = gb_heap_allocator();
+    Rename_Cache *cache = gb_alloc_item(a, Rename_Cache);
+    cache->rename_map = rename_map;
+    cache->conf = conf;
+    cache->arena = make_arena();
+    cache->keys = gb_alloc_array(a, u64, RENAME_CACHE_INITIAL_SLOTS);
+    gb_zero_size(cache->keys, RENAME_CACHE_INITIAL_SLOTS*gb_size_of(u64));
+    cache->values = gb_alloc_array(a, String, RENAME_CACHE_INITIAL_SLOTS);
+    cache->mask = RENAME_CACHE_INITIAL_SLOTS-1;
+    cache->count = 0;
+    return cache;
+}
+
+void destroy_rename_cache(Rename_Cache *cache)
+{
+    gbAllocator a = gb_heap_allocator();
+    destroy_arena(cache->arena);
+    gb_free(a, cache->keys);
+    gb_free(a, cache->values);
+    gb_free(a, cache);
+}
+
+// Interned ids are never 0, so neither are keys
+gb_inline u64 rename_key(u32 ident, Rename_Kind r, b32 do_remove_prefix)
+{
+    return ((u64)ident << 3) | ((u64)r << 1) | (do_remove_prefix != 0);
+}
+
+gb_inline u32 rename_slot(u64 key, u32 mask)
+{
+    return (u32)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+void rename_cache_grow(Rename_Cache *cache)
+{
+    gbAllocator a = gb_heap_allocator();
+    u32 size = (cache->mask+1) * 2;
+    u64 *keys = gb_alloc_array(a, u64, size);
+    gb_zero_size(keys, size*gb_size_of(u64));
+    String *values = gb_alloc_array(a, String, size);
+
+    for (u32 i = 0; i <= cache->mask; i++)
+    {
+        if (!cache->keys[i])
+            continue;
+        u32 pos = rename_slot(cache->keys[i], size-1);
+        while (keys[pos])
+            pos = (pos+1) & (size-1);
+        keys[pos] = cache->keys[i];
+        values[pos] = cache->values[i];
+    }
+
+    gb_free(a, cache->keys);
+    gb_free(a, cache->values);
+    cache->keys = keys;
+    cache->values = values;
+    cache->mask = size-1;
+}
+
+String rename_cached(Rename_Cache *cache, Token name, Rename_Kind r, b32 do_remove_prefix)
+{
+    if (!name.ident)
+        return rename_ident(name.str, r, do_remove_prefix, cache->rename_map, cache->conf, arena_allocator(cache->arena));
+
+    u64 key = rename_key(name.ident, r, do_remove_prefix);
+    u32 pos = rename_slot(key, cache->mask);
+    while (cache->keys[pos])
+    {
+        if (cache->keys[pos] == key)
+            return cache->values[pos];
+        pos = (pos+1) & cache->mask;
+    }
+
+    String renamed = rename_ident(interned_string(name.ident), r, do_remove_prefix,
+                                  cache->rename_map, cache->conf, arena_allocator(cache->arena));
+    cache->keys[pos] = key;
+    cache->values[pos] = renamed;
+    if (++cache->count*2 > cache->mask)
+        rename_cache_grow(cache);
+    return renamed;
+}
+
 char *repeat_char(char c, int count, gbAllocator allocator)
 {
     if (count < 0)
@@ -693,7 +818,8 @@ System_Directories get_system_includes(gbAllocator a)
 }
 #endif
 
-char *find_lib_path(System_Directories system_dirs, String lib)
+// Paths tried that didn't exist are added to `missing`
+char *find_lib_path(System_Directories system_dirs, String lib, gbArray(String) *missing)
 {
 
     b32 found_sep = false;
@@ -714,6 +840,7 @@ char *find_lib_path(System_Directories system_dirs, String lib)
             return gb_alloc_str(gb_heap_allocator(), path);
 
         gb_printf_err("ERROR: Could not find local library \"%s\"\n", path);
+        gb_array_append(*missing, make_string_alloc(gb_heap_allocator(), path));
         return 0;
     }
 
@@ -722,19 +849,21 @@ char *find_lib_path(System_Directories system_dirs, String lib)
         gb_snprintf(path, 512, "%.*s%c%.*s", LIT(system_dirs.lib[i]), GB_PATH_SEPARATOR, LIT(lib));
         if (gb_file_exists(path))
             return gb_alloc_str(gb_heap_allocator(), path);
+        gb_array_append(*missing, make_string_alloc(gb_heap_allocator(), path));
     }
     return 0;
 }
 
-gbArray(Lib) get_library_info(System_Directories system_dirs, gbArray(String) libraries)
+gbArray(Lib) get_library_info(System_Directories system_dirs, gbArray(String) libraries, gbArray(String) *missing)
 {
+    gb_array_init(*missing, gb_heap_allocator());
     if (!libraries) return 0;
     
     gbArray(Lib) libs;
     gb_array_init(libs, gb_heap_allocator());
     for (int i = 0; i < gb_array_count(libraries); i++)
     {
-        char *path = find_lib_path(system_dirs, libraries[i]);
+        char *path = find_lib_path(system_dirs, libraries[i], missing);
         if(path)
         {
             gb_printf("GETTING SYMBOLS FROM \"%s\"\n", path);
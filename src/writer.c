@@ -0,0 +1,84 @@
+#include "writer.h"
+
+gb_global char const writer_spaces_buffer[] =
+    "                                                                "
+    "                                                                ";
+
+void writer_init(Writer *w, gbFile *file, gbAllocator allocator)
+{
+    w->file = file;
+    w->allocator = allocator;
+    w->cap = WRITER_BUFFER_SIZE;
+    w->buffer = gb_alloc(allocator, w->cap);
+    w->len = 0;
+}
+
+void writer_flush(Writer *w)
+{
+    if (!w->file)
+        return;
+    if (w->len)
+        gb_file_write(w->file, w->buffer, w->len);
+    w->len = 0;
+}
+
+void writer_reserve(Writer *w, isize len)
+{
+    if (w->len + len <= w->cap)
+        return;
+    if (w->file)
+    {
+        writer_flush(w);
+        if (len <= w->cap)
+            return;
+    }
+    isize cap = gb_max(w->cap*2, w->len + len);
+    w->buffer = gb_resize(w->allocator, w->buffer, w->cap, cap);
+    w->cap = cap;
+}
+
+void writer_write(Writer *w, void const *data, isize len)
+{
+    if (w->file && w->len + len > w->cap)
+    {
+        writer_flush(w);
+        if (len > w->cap)
+        {
+            gb_file_write(w->file, data, len);
+            return;
+        }
+    }
+    writer_reserve(w, len);
+    gb_memcopy(w->buffer + w->len, data, len);
+    w->len += len;
+}
+
+void writer_string(Writer *w, String str)
+{
+    writer_write(w, str.start, str.len);
+}
+
+void writer_spaces(Writer *w, isize count)
+{
+    isize chunk = gb_size_of(writer_spaces_buffer)-1;
+    while (count > 0)
+    {
+        isize n = gb_min(count, chunk);
+        writer_write(w, writer_spaces_buffer, n);
+        count -= n;
+    }
+}
+
+isize writer_printf(Writer *w, char const *fmt, ...)
+{
+    writer_reserve(w, WRITER_MAX_PRINTF);
+
+    va_list va;
+    va_start(va, fmt);
+    isize len = gb_snprintf_va(w->buffer + w->len, WRITER_MAX_PRINTF, fmt, va);
+    va_end(va);
+    // Like `gb_fprintf_va`, the terminating 0 isn't written
+    if (len > 0)
+        w->len += len-1;
+    return len;
+}
@@ -0,0 +1,429 @@
+// Round-trip check and load benchmark for the AST cache, see `ast_cache.h`.
+//
+//     ast_cache_test [-I dir]... [-n runs] [file...]
+//
+// Without files, the headers in `test/fixtures` are checked, from the root of
+// the repository where the target is built.
+//
+// Each file is preprocessed and parsed the way `bind_run_task` does it, then
+// encoded, saved, loaded back and compared node by node with the parse: the
+// kinds and headers, every field `visit_node_fields` lists, which nodes are
+// shared, the lists of `Ast_File`, the type logs and the defines. The best
+// of `runs` times of the parse, the encoding and the load are printed.
+// Exits with 1 if a file doesn't come back the same.
+//
+// Built from every source but `main.c`, see `premake5.lua`.
+
+#define GB_IMPLEMENTATION
+#include "gb/gb.h"
+#include "strings.h"
+#include "arena.h"
+#include "util.h"
+#include "tokenizer.h"
+#include "intern.h"
+#include "include_cache.h"
+#include "file_map.h"
+#include "preprocess.h"
+#include "parse.h"
+#include "token_encoding.h"
+#include "ast_cache.h"
+#include <stdlib.h>
+
+#define TEST_AST_KEY 0x62696e6474657374ull
+
+char *fixtures[] = {"test/fixtures/types.h", "test/fixtures/macros.h", "test/fixtures/functions.h"};
+
+// The encodings are saved to the temporary directory, not the working one
+char *test_ast_path(gbAllocator a)
+{
+    char const *dir = getenv("TMPDIR");
+    if (!dir)
+        dir = getenv("TEMP");
+#if defined(GB_SYSTEM_WINDOWS)
+    if (!dir)
+        dir = ".";
+#else
+    if (!dir)
+        dir = "/tmp";
+#endif
+    isize size = gb_strlen(dir) + 32;
+    char *path = gb_alloc(a, size);
+    gb_snprintf(path, size, "%s%cast_cache_test.ast", dir, GB_PATH_SEPARATOR);
+    return path;
+}
+
+typedef struct Parse_Result
+{
+    Preprocessor *pp;
+    Arena *arena;
+    Parser parser;
+} Parse_Result;
+
+Parse_Result test_parse(String filename, gbFileContents fc, PreprocessorConfig *conf, gbArray(String) system_includes)
+{
+    gbAllocator a = gb_heap_allocator();
+    Parse_Result result = {0};
+
+    Tokenizer tokenizer = make_tokenizer(fc, filename);
+    gbArray(Token) tokens;
+    gb_array_init(tokens, a);
+    Token token;
+    for (;;)
+    {
+        token = get_token(&tokenizer);
+        if (token.kind != Token_Invalid)
+            gb_array_append(tokens, token);
+        if (token.kind == Token_EOF)
+            break;
+    }
+
+    Preprocessor *pp = make_preprocessor(tokens, dir_from_path(filename), filename, conf, 0);
+    pp->system_includes = system_includes;
+    run_pp(pp);
+    gbArray(Define) defines = pp_dump_defines(pp, filename);
+    gb_array_append(pp->output, (Token){.kind=Token_EOF});
+
+    result.pp = pp;
+    result.arena = make_arena();
+    gbAllocator ast_alloc = arena_allocator(result.arena);
+    Parser parser = make_parser(ast_alloc);
+    parser.type_table = hashmap_new(ast_alloc);
+    hashmap_put(parser.type_table, make_string("void"), 0);
+    parser.opaque_types = hashmap_new(ast_alloc);
+    parser_log_types(&parser, ast_alloc);
+    parser.start = parser.curr = pp->output;
+    parser.end = parser.start + gb_array_count(pp->output)-1;
+    parse_file(&parser);
+    parser.file.raw_defines = defines;
+    result.parser = parser;
+    return result;
+}
+
+void destroy_parse(Parse_Result *result)
+{
+    // The tables are in the arena
+    destroy_arena(result->arena);
+    destroy_preprocessor(result->pp);
+}
+
+typedef enum Field_Kind
+{
+    Field_Node,
+    Field_Token,
+    Field_String,
+    Field_Nodes,
+    Field_Tokens,
+    Field_Scalar,
+} Field_Kind;
+
+typedef struct Field
+{
+    Field_Kind kind;
+    void *value;
+} Field;
+
+void collect_node(void *data, Node **node)               { Field f = {Field_Node, node};    gb_array_append(*(gbArray(Field) *)data, f); }
+void collect_token(void *data, Token *token)             { Field f = {Field_Token, token};  gb_array_append(*(gbArray(Field) *)data, f); }
+void collect_string(void *data, String *str)             { Field f = {Field_String, str};   gb_array_append(*(gbArray(Field) *)data, f); }
+void collect_nodes(void *data, gbArray(Node *) *list)    { Field f = {Field_Nodes, list};   gb_array_append(*(gbArray(Field) *)data, f); }
+void collect_tokens(void *data, gbArray(Token) *list)    { Field f = {Field_Tokens, list};  gb_array_append(*(gbArray(Field) *)data, f); }
+void collect_scalar(void *data, u32 *value)              { Field f = {Field_Scalar, value}; gb_array_append(*(gbArray(Field) *)data, f); }
+
+typedef struct Ast_Compare
+{
+    // Both sides number the nodes in the order they're reached, so a node
+    // shared by the parse has to be shared, and only, by the load as well
+    Id_Table parsed;
+    Id_Table loaded;
+    u32 node_count;
+    gbArray(Node *) pending; // Pairs reached but not compared yet
+    gbArray(Field) parsed_fields;
+    gbArray(Field) loaded_fields;
+
+    Node *node; // Being compared, for the error
+    char const *error;
+} Ast_Compare;
+
+b32 compare_fail(Ast_Compare *c, char const *error)
+{
+    if (!c->error)
+        c->error = error;
+    return false;
+}
+
+b32 strings_same(String a, String b)
+{
+    if (!a.start || !b.start)
+        return !a.start && !b.start;
+    return a.len == b.len && gb_memcompare(a.start, b.start, a.len) == 0;
+}
+
+b32 tokens_same(Ast_Compare *c, Token a, Token b)
+{
+    File_Location from_a = token_origin(a);
+    File_Location from_b = token_origin(b);
+    if (a.kind != b.kind
+        || a.loc.file != b.loc.file || a.loc.line != b.loc.line || a.loc.column != b.loc.column
+        || a.pp_loc.line != b.pp_loc.line || a.pp_loc.column != b.pp_loc.column
+        || !a.origin != !b.origin
+        || from_a.file != from_b.file || from_a.line != from_b.line || from_a.column != from_b.column
+        || a.ident != b.ident)
+        return compare_fail(c, "token differs");
+    if (!strings_same(a.str, b.str))
+        return compare_fail(c, "token spelling differs");
+    return true;
+}
+
+b32 nodes_same(Ast_Compare *c, Node *a, Node *b)
+{
+    if (!a || !b)
+        return (a == b) || compare_fail(c, "node is null on one side");
+    u32 *index_a = id_table_get(&c->parsed, (uintptr)a);
+    u32 *index_b = id_table_get(&c->loaded, (uintptr)b);
+    if (*index_a != *index_b)
+        return compare_fail(c, "node isn't shared the same way");
+    if (*index_a)
+        return true;
+    *index_a = *index_b = ++c->node_count;
+    gb_array_append(c->pending, a);
+    gb_array_append(c->pending, b);
+    return true;
+}
+
+b32 node_lists_same(Ast_Compare *c, gbArray(Node *) a, gbArray(Node *) b)
+{
+    isize count = a ? gb_array_count(a) : -1;
+    if (count != (b ? gb_array_count(b) : -1))
+        return compare_fail(c, "node list length differs");
+    for (isize i = 0; i < count; i++)
+    {
+        if (!nodes_same(c, a[i], b[i]))
+            return false;
+    }
+    return true;
+}
+
+b32 token_lists_same(Ast_Compare *c, gbArray(Token) a, gbArray(Token) b)
+{
+    isize count = a ? gb_array_count(a) : -1;
+    if (count != (b ? gb_array_count(b) : -1))
+        return compare_fail(c, "token list length differs");
+    for (isize i = 0; i < count; i++)
+    {
+        if (!tokens_same(c, a[i], b[i]))
+            return false;
+    }
+    return true;
+}
+
+b32 fields_same(Ast_Compare *c, Node *a, Node *b)
+{
+    c->node = a;
+    if (a->kind != b->kind || a->index != b->index
+        || !a->no_print != !b->no_print || !a->is_opaque != !b->is_opaque)
+        return compare_fail(c, "node header differs");
+
+    Node_Fields collect = {0, collect_node, collect_token, collect_string, collect_nodes, collect_tokens, collect_scalar};
+    gb_array_clear(c->parsed_fields);
+    gb_array_clear(c->loaded_fields);
+    collect.data = &c->parsed_fields;
+    visit_node_fields(a, &collect);
+    collect.data = &c->loaded_fields;
+    visit_node_fields(b, &collect);
+
+    for (int i = 0; i < gb_array_count(c->parsed_fields); i++)
+    {
+        void *fa = c->parsed_fields[i].value;
+        void *fb = c->loaded_fields[i].value;
+        b32 same = true;
+        switch (c->parsed_fields[i].kind)
+        {
+        case Field_Node:   same = nodes_same(c, *(Node **)fa, *(Node **)fb); break;
+        case Field_Token:  same = tokens_same(c, *(Token *)fa, *(Token *)fb); break;
+        case Field_String: same = strings_same(*(String *)fa, *(String *)fb) || compare_fail(c, "string differs"); break;
+        case Field_Nodes:  same = node_lists_same(c, *(gbArray(Node *) *)fa, *(gbArray(Node *) *)fb); break;
+        case Field_Tokens: same = token_lists_same(c, *(gbArray(Token) *)fa, *(gbArray(Token) *)fb); break;
+        case Field_Scalar: same = *(u32 *)fa == *(u32 *)fb || compare_fail(c, "scalar field differs"); break;
+        }
+        if (!same)
+            return false;
+    }
+    return true;
+}
+
+b32 defines_same(Ast_Compare *c, gbArray(Define) a, gbArray(Define) b)
+{
+    c->node = 0;
+    if (gb_array_count(a) != gb_array_count(b))
+        return compare_fail(c, "define count differs");
+    for (int i = 0; i < gb_array_count(a); i++)
+    {
+        if (!strings_same(a[i].key, b[i].key) || a[i].ident != b[i].ident)
+            return compare_fail(c, "define name differs");
+        Token_Run va = a[i].value;
+        Token_Run vb = b[i].value;
+        if (!va.start != !vb.start || va.end - va.start != vb.end - vb.start)
+            return compare_fail(c, "define value length differs");
+        for (Token *ta = va.start, *tb = vb.start; ta && ta <= va.end; ta++, tb++)
+        {
+            if (!tokens_same(c, *ta, *tb))
+                return false;
+        }
+    }
+    return true;
+}
+
+// The parse and the cache loaded from its encoding hold the same AST
+b32 ast_files_same(Ast_Compare *c, Parser *parsed, Ast_Cache *loaded)
+{
+    Ast_File a = parsed->file;
+    Ast_File b = loaded->file;
+    b32 same = node_lists_same(c, a.all_nodes, b.all_nodes)
+            && node_lists_same(c, a.tpdefs, b.tpdefs)
+            && node_lists_same(c, a.records, b.records)
+            && node_lists_same(c, a.functions, b.functions)
+            && node_lists_same(c, a.variables, b.variables)
+            && node_lists_same(c, a.defines, b.defines)
+            && node_lists_same(c, parsed->log.new_types, loaded->log.new_types)
+            && node_lists_same(c, parsed->log.new_opaque_types, loaded->log.new_opaque_types)
+            && node_lists_same(c, parsed->log.used, loaded->log.used)
+            && node_lists_same(c, parsed->log.missed, loaded->log.missed);
+    for (int i = 0; same && i < gb_array_count(c->pending); i += 2)
+        same = fields_same(c, c->pending[i], c->pending[i+1]);
+    return same && defines_same(c, a.raw_defines, b.raw_defines);
+}
+
+f64 min_time(f64 best, f64 start)
+{
+    f64 t = gb_time_now() - start;
+    return best < 0 || t < best ? t : best;
+}
+
+int main(int argc, char **argv)
+{
+    gbAllocator a = gb_heap_allocator();
+    PreprocessorConfig conf = {0};
+    gb_array_init(conf.include_dirs, a);
+    gbArray(String) inputs;
+    gb_array_init(inputs, a);
+    int runs = 5;
+    for (int i = 1; i < argc; i++)
+    {
+        if (gb_strcmp(argv[i], "-I") == 0 && i+1 < argc)
+            gb_array_append(conf.include_dirs, make_string(argv[++i]));
+        else if (gb_strcmp(argv[i], "-n") == 0 && i+1 < argc)
+        {
+            runs = (int)gb_str_to_i64(argv[++i], 0, 10);
+            runs = gb_max(runs, 1);
+        }
+        else
+            gb_array_append(inputs, make_string(argv[i]));
+    }
+    if (gb_array_count(inputs) == 0)
+    {
+        for (int i = 0; i < gb_count_of(fixtures); i++)
+            gb_array_append(inputs, make_string(fixtures[i]));
+    }
+    char *ast_path = test_ast_path(a);
+
+    System_Directories system_dirs = get_system_includes(a);
+    init_include_cache();
+    init_location_table();
+    init_keyword_table();
+    init_interner();
+    init_preprocessor();
+
+    int failed = 0;
+    for (int f = 0; f < gb_array_count(inputs); f++)
+    {
+        String filename = inputs[f];
+        char *path = make_cstring(a, filename);
+        gbFileContents fc = map_file_contents(a, path);
+        if (!fc.data)
+        {
+            gb_printf_err("\x1b[31mERROR:\x1b[0m Failed to open file \'%.*s\'\n", LIT(filename));
+            failed++;
+            continue;
+        }
+
+        f64 parse_time = -1, encode_time = -1, load_time = -1;
+        Parse_Result parse = {0};
+        gbFileContents encoded = {0};
+        for (int r = 0; r < runs; r++)
+        {
+            if (parse.pp)
+                destroy_parse(&parse);
+            f64 start = gb_time_now();
+            parse = test_parse(filename, fc, &conf, system_dirs.include);
+            parse_time = min_time(parse_time, start);
+
+            if (encoded.data)
+                gb_file_free_contents(&encoded);
+            start = gb_time_now();
+            encoded = encode_ast_file(parse.parser.file, parse.parser.log, parse.parser.node_count);
+            encode_time = min_time(encode_time, start);
+        }
+        if (!encoded.data)
+        {
+            gb_printf_err("\x1b[31mERROR:\x1b[0m '%.*s' has a node that points back to itself\n", LIT(filename));
+            destroy_parse(&parse);
+            failed++;
+            continue;
+        }
+        isize encoded_size = encoded.size;
+        save_ast_cache(encoded, TEST_AST_KEY, ast_path);
+        gb_file_free_contents(&encoded);
+
+        Ast_Cache *loaded = 0;
+        for (int r = 0; r < runs; r++)
+        {
+            if (loaded)
+                destroy_ast_cache(loaded);
+            f64 start = gb_time_now();
+            loaded = load_ast_cache(ast_path, TEST_AST_KEY);
+            load_time = min_time(load_time, start);
+        }
+
+        Ast_Compare c = {0};
+        id_table_init(&c.parsed, a);
+        id_table_init(&c.loaded, a);
+        gb_array_init(c.pending, a);
+        gb_array_init(c.parsed_fields, a);
+        gb_array_init(c.loaded_fields, a);
+        if (!loaded)
+            c.error = "cache didn't load";
+        else
+            ast_files_same(&c, &parse.parser, loaded);
+
+        if (c.error)
+        {
+            failed++;
+            Token *at = c.node ? node_token(c.node) : 0;
+            if (at)
+                gb_printf_err("%.*s(%d:%d): ", LIT(file_name(at->loc.file)), at->loc.line, at->loc.column);
+            gb_printf_err("\x1b[31mFAILED:\x1b[0m %.*s: %s\n", LIT(filename), c.error);
+        }
+        else
+        {
+            gb_printf("%.*s: %u nodes, %d bytes, parse %.2fms, encode %.2fms, load %.2fms (%.1fx)\n",
+                      LIT(filename), c.node_count, (int)encoded_size, parse_time*1000, encode_time*1000,
+                      load_time*1000, parse_time/load_time);
+        }
+
+        gb_free(a, c.parsed.entries);
+        gb_free(a, c.loaded.entries);
+        gb_array_free(c.pending);
+        gb_array_free(c.parsed_fields);
+        gb_array_free(c.loaded_fields);
+        if (loaded)
+            destroy_ast_cache(loaded);
+        destroy_parse(&parse);
+        unmap_file_contents(&fc);
+    }
+    gb_file_remove(ast_path);
+    gb_free(a, ast_path);
+
+    if (failed)
+        gb_printf_err("%d OF %d FILES FAILED\n", failed, (int)gb_array_count(inputs));
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,28 @@
+// Declarations for `ast_cache_test`: parameters, pointers, arrays and
+// casts to names declared in another header
+#include "types.h"
+#include "macros.h"
+
+extern int fx_global_count;
+extern const fx_vec2 fx_origin;
+extern fx_callback fx_callbacks[8];
+
+fx_handle fx_open(fx_cstr path, fx_flags flags);
+void fx_close(fx_handle handle);
+int fx_read(fx_handle handle, void *buffer, unsigned long size);
+fx_i64 fx_seek(fx_handle, fx_i64 offset, int whence);
+int fx_printf(fx_handle handle, fx_cstr format, ...);
+void fx_sort(void *base, unsigned long count, unsigned long size, fx_compare compare);
+void fx_set_callback(fx_handle handle, void (*callback)(void *user, int code, fx_cstr message), void *user);
+struct fx_node *fx_find(struct fx_node *list, fx_cstr name);
+fx_value fx_get(const struct fx_node *node);
+void fx_transform(fx_vec2 points[], int count, const float matrix[2][3]);
+fx_settings *fx_default_settings(void);
+fx_color fx_mix(fx_color a, fx_color b);
+
+enum fx_limits
+{
+    FX_MAX_HANDLES = (fx_u32)64,
+    FX_NODE_SIZE = sizeof(struct fx_node),
+    FX_MAX_NAME = FX_MIN(sizeof(fx_settings), 32),
+};
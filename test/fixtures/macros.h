@@ -0,0 +1,35 @@
+// Defines and conditionals for `ast_cache_test`, the raw defines are cached too
+#include "types.h"
+
+#define FX_VERSION_MAJOR 2
+#define FX_VERSION_MINOR 13
+#define FX_VERSION ((FX_VERSION_MAJOR << 16) | FX_VERSION_MINOR)
+#define FX_NAME "fixture"
+#define FX_PI 3.14159265f
+#define FX_MASK 0xFFFF0000u
+#define FX_BIG 1234567890123ull
+#define FX_NEGATIVE (-42)
+#define FX_CHAR 'x'
+#define FX_EMPTY
+#define FX_MIN(a, b) ((a) < (b) ? (a) : (b))
+#define FX_CONCAT(a, b) a##b
+#define FX_STRINGIFY(x) #x
+#define FX_FIELD(type, name) type FX_CONCAT(field_, name);
+
+#if defined(FX_VERSION_MAJOR) && (FX_VERSION >= 0x20000)
+typedef struct fx_settings
+{
+    FX_FIELD(fx_u32, width)
+    FX_FIELD(fx_u32, height)
+    FX_FIELD(fx_cstr, title)
+    int min_size[FX_MIN(4, 8)];
+} fx_settings;
+#elif FX_VERSION_MAJOR == 1
+typedef struct fx_settings fx_settings;
+#else
+#error "unsupported version"
+#endif
+
+#ifdef FX_UNDEFINED
+int fx_never_seen;
+#endif
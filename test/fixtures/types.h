@@ -0,0 +1,60 @@
+// Types for `ast_cache_test`: typedefs, records, enums and the casts that
+// make parsing depend on which names are types
+#ifndef FIXTURE_TYPES_H
+#define FIXTURE_TYPES_H
+
+typedef unsigned int fx_u32;
+typedef signed long long fx_i64;
+typedef fx_u32 fx_flags, *fx_flags_ptr;
+typedef const char *fx_cstr;
+
+typedef struct fx_opaque fx_opaque;
+typedef struct fx_handle_t *fx_handle;
+
+typedef enum fx_color
+{
+    FX_RED,
+    FX_GREEN = 4,
+    FX_BLUE = FX_GREEN << 1,
+    FX_ALL = (fx_u32)-1,
+    FX_SIZE = sizeof(fx_i64) * 2,
+} fx_color;
+
+enum { FX_ANON_A = 1, FX_ANON_B = FX_ANON_A | 2 };
+
+typedef struct fx_vec2
+{
+    float x, y;
+} fx_vec2;
+
+typedef union fx_value
+{
+    fx_i64 i;
+    double f;
+    fx_cstr s;
+    struct { fx_u32 lo, hi; } parts;
+} fx_value;
+
+struct fx_node
+{
+    struct fx_node *next, *prev;
+    fx_value value;
+    fx_color color;
+    unsigned kind : 4;
+    unsigned flags : 12;
+    int : 0;
+    signed depth : 8;
+    char name[32];
+    fx_vec2 points[FX_SIZE][2];
+    union
+    {
+        fx_handle handle;
+        void *data;
+    };
+};
+
+typedef void (*fx_callback)(void *user, int code, fx_cstr message);
+typedef int (*fx_compare)(const void *, const void *);
+typedef fx_callback (*fx_get_callback)(fx_handle, fx_callback fallback[4]);
+
+#endif